@@ -0,0 +1,138 @@
+/// Built-in LED animation tables.
+/**
+ ** Every animation here is a palette and a packed run of keyframes, which
+ ** stay in FRAM. See `leds_animation_t` in `leds.h` for the format; colors
+ ** are 15-bit per channel. Each animation's keyframes are written out once,
+ ** in an `ANIM_*_FRAMES()` list, from which both its frames and its frame
+ ** count are expanded (see `LEDS_FRAME_BYTES()`).
+ **
+ ** \file animations.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include "leds.h"
+
+#include "animations.h"
+
+/// Run bytes setting all 9 LEDs to `palette[index]`.
+#define ALL(index) LEDS_RUN(8, index), LEDS_RUN(1, index)
+
+/// Colors for `anim_pumpkin_pulse`.
+const rgbcolor16_t anim_pumpkin_pulse_palette[] = {
+    {0x0000, 0x0000, 0x0000},
+    {0x7fff, 0x1800, 0x0000},
+    {0x2000, 0x0600, 0x0000},
+};
+
+/// Slow orange breathing on every LED.
+#define ANIM_PUMPKIN_PULSE_FRAMES(FRAME) \
+    FRAME(20, ALL(0)) \
+    FRAME(60, ALL(1)) \
+    FRAME(60, ALL(2)) \
+    FRAME(60, ALL(1)) \
+    FRAME(80, ALL(0))
+
+const uint8_t anim_pumpkin_pulse_frames[] = {ANIM_PUMPKIN_PULSE_FRAMES(LEDS_FRAME_BYTES)};
+
+const leds_animation_t anim_pumpkin_pulse = {
+    .palette = anim_pumpkin_pulse_palette,
+    .frames = anim_pumpkin_pulse_frames,
+    .frame_count = 0 ANIM_PUMPKIN_PULSE_FRAMES(LEDS_FRAME_COUNT),
+    .loop = 0,
+};
+
+/// Colors for `anim_candle`.
+const rgbcolor16_t anim_candle_palette[] = {
+    {0x0000, 0x0000, 0x0000},
+    {0x7fff, 0x2000, 0x0200},
+    {0x3000, 0x0a00, 0x0000},
+    {0x5800, 0x1000, 0x0000},
+};
+
+/// A candle guttering: uneven orange flicker across the LEDs.
+#define ANIM_CANDLE_FRAMES(FRAME) \
+    FRAME(10, ALL(0)) \
+    FRAME(20, ALL(2)) \
+    FRAME(8, LEDS_RUN(3, 1), LEDS_RUN(3, 3), LEDS_RUN(3, 2)) \
+    FRAME(12, LEDS_RUN(3, 2), LEDS_RUN(3, 1), LEDS_RUN(3, 3)) \
+    FRAME(10, LEDS_RUN(3, 3), LEDS_RUN(3, 2), LEDS_RUN(3, 1)) \
+    FRAME(14, LEDS_SKIP(3), LEDS_RUN(3, 1), LEDS_SKIP(3)) \
+    FRAME(30, ALL(0))
+
+const uint8_t anim_candle_frames[] = {ANIM_CANDLE_FRAMES(LEDS_FRAME_BYTES)};
+
+const leds_animation_t anim_candle = {
+    .palette = anim_candle_palette,
+    .frames = anim_candle_frames,
+    .frame_count = 0 ANIM_CANDLE_FRAMES(LEDS_FRAME_COUNT),
+    .loop = 0,
+};
+
+/// Colors for `anim_ember`.
+const rgbcolor16_t anim_ember_palette[] = {
+    {0x0000, 0x0000, 0x0000},
+    {0x4000, 0x0000, 0x0000},
+    {0x7fff, 0x0c00, 0x0000},
+};
+
+/// A deep red glow with a hot spot in the middle. Unlocked by heat.
+#define ANIM_EMBER_FRAMES(FRAME) \
+    FRAME(20, ALL(0)) \
+    FRAME(80, ALL(1)) \
+    FRAME(40, LEDS_SKIP(4), LEDS_RUN(1, 2), LEDS_SKIP(4)) \
+    FRAME(40, ALL(2)) \
+    FRAME(80, ALL(0))
+
+const uint8_t anim_ember_frames[] = {ANIM_EMBER_FRAMES(LEDS_FRAME_BYTES)};
+
+const leds_animation_t anim_ember = {
+    .palette = anim_ember_palette,
+    .frames = anim_ember_frames,
+    .frame_count = 0 ANIM_EMBER_FRAMES(LEDS_FRAME_COUNT),
+    .loop = 0,
+};
+
+/// Colors for `anim_frost`.
+const rgbcolor16_t anim_frost_palette[] = {
+    {0x0000, 0x0000, 0x0000},
+    {0x0000, 0x1800, 0x7fff},
+    {0x5000, 0x6000, 0x7fff},
+};
+
+/// Icy blue creeping across the LEDs, with a white glint. Unlocked by cold.
+#define ANIM_FROST_FRAMES(FRAME) \
+    FRAME(15, ALL(0)) \
+    FRAME(30, LEDS_RUN(3, 1), LEDS_SKIP(6)) \
+    FRAME(30, LEDS_SKIP(3), LEDS_RUN(3, 1), LEDS_SKIP(3)) \
+    FRAME(30, LEDS_SKIP(6), LEDS_RUN(3, 1)) \
+    FRAME(10, LEDS_SKIP(4), LEDS_RUN(1, 2), LEDS_SKIP(4)) \
+    FRAME(20, LEDS_SKIP(4), LEDS_RUN(1, 1), LEDS_SKIP(4)) \
+    FRAME(60, ALL(0))
+
+const uint8_t anim_frost_frames[] = {ANIM_FROST_FRAMES(LEDS_FRAME_BYTES)};
+
+const leds_animation_t anim_frost = {
+    .palette = anim_frost_palette,
+    .frames = anim_frost_frames,
+    .frame_count = 0 ANIM_FROST_FRAMES(LEDS_FRAME_COUNT),
+    .loop = 0,
+};
+
+/// Colors for the lantern, which the LED controller breathes by itself.
+/**
+ ** This isn't keyframed; see `leds_breathe()`. The middle LEDs burn a
+ ** little hotter than the ones around them, like a candle inside.
+ */
+const rgbcolor16_t anim_lantern_colors[HT16D_LED_COUNT] = {
+    {0x3000, 0x0a00, 0x0000},
+    {0x3000, 0x0a00, 0x0000},
+    {0x3000, 0x0a00, 0x0000},
+    {0x5800, 0x1400, 0x0000},
+    {0x7fff, 0x2000, 0x0200},
+    {0x5800, 0x1400, 0x0000},
+    {0x3000, 0x0a00, 0x0000},
+    {0x3000, 0x0a00, 0x0000},
+    {0x3000, 0x0a00, 0x0000},
+};
@@ -0,0 +1,20 @@
+/// Header for the badge's built-in LED animations.
+/**
+ ** \file animations.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef ANIMATIONS_H_
+#define ANIMATIONS_H_
+
+#include "leds.h"
+
+extern const leds_animation_t anim_pumpkin_pulse;
+extern const leds_animation_t anim_candle;
+extern const leds_animation_t anim_ember;
+extern const leds_animation_t anim_frost;
+extern const rgbcolor16_t anim_lantern_colors[HT16D_LED_COUNT];
+
+#endif /* ANIMATIONS_H_ */
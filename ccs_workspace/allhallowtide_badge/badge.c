@@ -5,10 +5,374 @@
  *      Author: george
  */
 
-void badge_button_press_short() {
+#include <stdint.h>
 
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "fram.h"
+#include "leds.h"
+#include "animations.h"
+#include "input.h"
+#include "rtc.h"
+#include "selftest.h"
+#include "sync.h"
+
+/// Registry flag: something of higher priority may cut in, and resume it.
+#define BADGE_ANIM_INTERRUPTIBLE    0x01
+/// Registry flag: this is in the bling rotation, once it's unlocked.
+#define BADGE_ANIM_BLING            0x02
+
+/// One entry of the animation registry.
+typedef struct {
+    /// The animation itself, or 0 for the lantern, which isn't keyframed.
+    const leds_animation_t *animation;
+    /// One of `BADGE_PRIO_*`; higher ones go first.
+    uint8_t priority;
+    /// `BADGE_ANIM_*` flags.
+    uint8_t flags;
+} badge_anim_t;
+
+/// Every animation the badge has, indexed by its `BADGE_ANIM_*` ID.
+const badge_anim_t badge_anims[BADGE_ANIM_COUNT] = {
+    {&anim_pumpkin_pulse, BADGE_PRIO_BUTTON, 0},
+    {&anim_candle, BADGE_PRIO_BLING, BADGE_ANIM_INTERRUPTIBLE | BADGE_ANIM_BLING},
+    {&anim_ember, BADGE_PRIO_BLING, BADGE_ANIM_INTERRUPTIBLE | BADGE_ANIM_BLING},
+    {&anim_frost, BADGE_PRIO_BLING, BADGE_ANIM_INTERRUPTIBLE | BADGE_ANIM_BLING},
+    {0, BADGE_PRIO_BLING, BADGE_ANIM_INTERRUPTIBLE | BADGE_ANIM_BLING},
+};
+
+/// The ID of the animation on the display, or `BADGE_ANIM_NONE`.
+uint8_t badge_anim_current = BADGE_ANIM_NONE;
+/// The ID of the animation that was cut in on, or `BADGE_ANIM_NONE`.
+uint8_t badge_anim_suspended = BADGE_ANIM_NONE;
+/// Where `badge_anim_suspended` left off.
+leds_resume_t badge_anim_resume;
+/// IDs of the animations waiting for the display, in the order asked for.
+uint8_t badge_anim_queue[BADGE_ANIM_QUEUE_LEN];
+/// The number of IDs in `badge_anim_queue`.
+uint8_t badge_anim_queued = 0;
+/// The ID of the last bling we played.
+uint8_t badge_bling_last = BADGE_ANIM_NONE;
+
+/// The two FRAM copies of the persistent config; see `badge_conf_commit()`.
+#pragma PERSISTENT(badge_conf_slots)
+badge_conf_t badge_conf_slots[2] = {0};
+
+/// The working copy of the persistent config, which the whole badge uses.
+badge_conf_t badge_conf;
+/// True if `badge_conf` has changed since it was last committed.
+uint8_t badge_conf_dirty = 0;
+
+/// Compute the CRC-16 of everything in `conf` but its own `crc`.
+/**
+ ** This uses the CRC16 module, and must only be called from the main loop.
+ */
+static uint16_t badge_conf_crc(const badge_conf_t *conf) {
+    const uint8_t *bytes = (const uint8_t *) conf;
+
+    CRCINIRES = 0xFFFF;
+    for (uint8_t i=0; i<sizeof(badge_conf_t) - sizeof(conf->crc); i++) {
+        CRCDI_L = bytes[i];
+    }
+    return CRCINIRES;
 }
 
-void badge_init() {
+/// Returns true if `conf` is still all zeros, as it was programmed.
+/**
+ ** A slot that's ever been committed has a sequence number and a CRC in
+ ** it, so it's as good as never blank again, even once it's corrupted.
+ */
+static uint8_t badge_conf_blank(const badge_conf_t *conf) {
+    const uint8_t *bytes = (const uint8_t *) conf;
+
+    for (uint8_t i=0; i<sizeof(badge_conf_t); i++) {
+        if (bytes[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/// Load `badge_conf` from the newest good copy in FRAM, or the defaults.
+/**
+ ** This has to happen before `rtc_init()`, which starts the clock from it.
+ */
+void badge_conf_load() {
+    uint8_t good0 = badge_conf_crc(&badge_conf_slots[0]) == badge_conf_slots[0].crc;
+    uint8_t good1 = badge_conf_crc(&badge_conf_slots[1]) == badge_conf_slots[1].crc;
+
+    if (good0 && good1) {
+        // Sequence numbers wrap, so compare them by their difference.
+        if ((int16_t) (badge_conf_slots[1].seq - badge_conf_slots[0].seq) > 0) {
+            good0 = 0;
+        }
+    }
+
+    if (good0) {
+        badge_conf = badge_conf_slots[0];
+    } else if (good1) {
+        badge_conf = badge_conf_slots[1];
+    } else {
+        // A brand new badge, or one whose config layout has changed, or
+        //  that lost both copies. Only a brand new one, whose slots are
+        //  still blank, needs the factory self-test.
+        badge_conf.seq = 0;
+        badge_conf.clock = 0;
+        badge_conf.clock_authority = 0;
+        badge_conf.selftest_pending = badge_conf_blank(&badge_conf_slots[0])
+                && badge_conf_blank(&badge_conf_slots[1]);
+        badge_conf.unlocked = BADGE_UNLOCKED_DEFAULT;
+        badge_conf.rtc_trim_ppm = 0;
+        badge_conf.brightness = LEDS_BRIGHTNESS_DEFAULT;
+        for (uint8_t i=0; i<sizeof(badge_conf.seen); i++) {
+            badge_conf.seen[i] = 0;
+        }
+        badge_conf_dirty = 1;
+    }
+}
+
+/// Note that `badge_conf` has changed, so the next commit writes it.
+void badge_conf_changed() {
+    badge_conf_dirty = 1;
+}
+
+/// Write `badge_conf` to FRAM, if it's changed since the last time.
+/**
+ ** Each commit goes to the slot that the previous commit didn't, and its
+ ** CRC is computed over the new sequence number. So if we lose power in
+ ** the middle of writing one, it fails its CRC at the next boot, and the
+ ** other slot (the previous commit) is still whole and is used instead.
+ **
+ ** Callers should batch their changes with `badge_conf_changed()` and let
+ ** the main loop commit every `BADGE_CLOCK_WRITE_INTERVAL` seconds, rather
+ ** than committing every change.
+ */
+void badge_conf_commit() {
+    if (!badge_conf_dirty) {
+        return;
+    }
+
+    badge_conf.seq++;
+    badge_conf.crc = badge_conf_crc(&badge_conf);
+    fram_write(&badge_conf_slots[badge_conf.seq & 1], &badge_conf, sizeof(badge_conf));
+    badge_conf_dirty = 0;
+}
+
+/// Set the clock to `clock`, and record it in the config.
+void badge_set_time(uint32_t clock) {
+    rtc_set_seconds(clock);
+    badge_conf.clock = clock;
+    badge_conf_changed();
+}
+
+/// Step the clock by `seconds`, and record the new time in the config.
+void badge_step_time(int32_t seconds) {
+    badge_conf.clock = rtc_step(seconds);
+    badge_conf_changed();
+}
+
+/// Record the time, as the clock has it now, in the config.
+void badge_save_time() {
+    uint16_t gie = __get_SR_register() & GIE;
+
+    __bic_SR_register(GIE);
+    badge_conf.clock = rtc_seconds;
+    __bis_SR_register(gie);
+    badge_conf_changed();
+}
+
+/// Record how much we trust the clock in the config, and say so.
+void badge_set_authority(uint8_t authority) {
+    badge_conf.clock_authority = authority;
+    badge_conf_changed();
+    sync_refresh();
+}
+
+/// Put animation `id` on the display now.
+/**
+ ** The lantern is breathed by the LED controller, with no per-tick work for
+ ** us, so the MCU sleeps for up to a second at a time while it plays. If
+ ** it's cut in on, it's stopped, and not picked back up.
+ */
+static void badge_anim_start(uint8_t id) {
+    badge_anim_current = id;
+    if (!badge_anims[id].animation) {
+        leds_breathe(anim_lantern_colors, HT16D_HW_CYCLE_LONG, 1, BADGE_LANTERN_TICKS);
+        return;
+    }
+    leds_start(badge_anims[id].animation);
+}
+
+/// Ask for animation `id` (a `BADGE_ANIM_*`) to be played, once.
+/**
+ ** Everything in the badge that wants the display goes through here, so
+ ** that only one animation drives the LEDs at a time. If nothing's playing,
+ ** it starts right away. If something interruptible of lower priority is,
+ ** that's suspended, and resumed where it left off once the display is free
+ ** again. Otherwise, it waits its turn, unless it's already playing or
+ ** waiting, or too many other things are.
+ **
+ ** Only one animation can be suspended at a time. If a third of a higher
+ ** priority still cuts in, the one it cuts in on is dropped.
+ */
+void badge_anim_play(uint8_t id) {
+    const badge_anim_t *current;
+
+    if (id >= BADGE_ANIM_COUNT || id == badge_anim_current) {
+        return;
+    }
+
+    if (selftest_active()) {
+        return; // The self-test has the display.
+    }
+
+    if (badge_anim_current == BADGE_ANIM_NONE) {
+        badge_anim_start(id);
+        return;
+    }
+
+    current = &badge_anims[badge_anim_current];
+    if (badge_anims[id].priority > current->priority
+            && (current->flags & BADGE_ANIM_INTERRUPTIBLE)) {
+        if (badge_anim_suspended == BADGE_ANIM_NONE) {
+            leds_suspend(&badge_anim_resume);
+            badge_anim_suspended = badge_anim_current;
+        }
+        badge_anim_start(id);
+        return;
+    }
+
+    for (uint8_t i=0; i<badge_anim_queued; i++) {
+        if (badge_anim_queue[i] == id) {
+            return;
+        }
+    }
+    if (badge_anim_queued < BADGE_ANIM_QUEUE_LEN) {
+        badge_anim_queue[badge_anim_queued++] = id;
+    }
+}
+
+/// The display is free; give it to whatever should have it next.
+/**
+ ** That's the highest priority animation waiting, the earliest asked for
+ ** first. A suspended animation goes ahead of any waiting at its priority
+ ** or lower, since it was there first.
+ */
+static void badge_anim_next() {
+    uint8_t best = BADGE_ANIM_QUEUE_LEN;
+    uint8_t id;
+
+    for (uint8_t i=0; i<badge_anim_queued; i++) {
+        if (best == BADGE_ANIM_QUEUE_LEN
+                || badge_anims[badge_anim_queue[i]].priority > badge_anims[badge_anim_queue[best]].priority) {
+            best = i;
+        }
+    }
+
+    if (badge_anim_suspended != BADGE_ANIM_NONE
+            && (best == BADGE_ANIM_QUEUE_LEN
+                || badge_anims[badge_anim_suspended].priority >= badge_anims[badge_anim_queue[best]].priority)) {
+        badge_anim_current = badge_anim_suspended;
+        badge_anim_suspended = BADGE_ANIM_NONE;
+        leds_resume(&badge_anim_resume);
+        return;
+    }
+
+    if (best == BADGE_ANIM_QUEUE_LEN) {
+        return;
+    }
+
+    id = badge_anim_queue[best];
+    badge_anim_queued--;
+    for (uint8_t i=best; i<badge_anim_queued; i++) {
+        badge_anim_queue[i] = badge_anim_queue[i+1];
+    }
+    badge_anim_start(id);
+}
+
+/// Check whether the display has come free, after each animated tick.
+/**
+ ** The main loop calls this right after `leds_timestep()`.
+ */
+void badge_timestep() {
+    if (badge_anim_current != BADGE_ANIM_NONE && !leds_is_animating() && !leds_is_breathing()) {
+        badge_anim_current = BADGE_ANIM_NONE;
+        badge_anim_next();
+    }
+}
+
+/// Unlock animation `id`, for good.
+void badge_unlock(uint8_t id) {
+    if (badge_conf.unlocked & (1 << id)) {
+        return;
+    }
+    badge_conf.unlocked |= 1 << id;
+    badge_conf_changed();
+    sync_refresh();
+}
+
+/// Play the next unlocked bling in the rotation.
+/**
+ ** The main loop calls this every `BADGE_BLING_SECS`.
+ */
+void badge_bling() {
+    uint8_t id = badge_bling_last;
+
+    for (uint8_t i=0; i<BADGE_ANIM_COUNT; i++) {
+        id = id+1 < BADGE_ANIM_COUNT ? id+1 : 0;
+        if ((badge_anims[id].flags & BADGE_ANIM_BLING) && (badge_conf.unlocked & (1 << id))) {
+            badge_bling_last = id;
+            badge_anim_play(id);
+            return;
+        }
+    }
+}
+
+/// Unlock the hot (if `hot`) or cold animation, showing it off if it's new.
+void badge_temp_unlock(uint8_t hot) {
+    uint8_t id = hot ? BADGE_ANIM_EMBER : BADGE_ANIM_FROST;
+
+    if (badge_conf.unlocked & (1 << id)) {
+        return;
+    }
+    badge_unlock(id);
+    badge_anim_play(id);
+}
+
+/// Handle an `INPUT_EV_*` event from the buttons.
+void badge_input(uint8_t event) {
+    switch (event) {
+    case INPUT_EV_SHORT | INPUT_BTN_NOSE:
+        badge_anim_play(BADGE_ANIM_PUMPKIN_PULSE);
+        break;
+    case INPUT_EV_LONG | INPUT_BTN_NOSE:
+        // Step up a brightness level, from the brightest back around to
+        //  the dimmest, and pulse to show off the new one.
+        leds_set_brightness_level(badge_conf.brightness+1 < LEDS_BRIGHTNESS_LEVELS ? badge_conf.brightness+1 : 0);
+        badge_anim_play(BADGE_ANIM_PUMPKIN_PULSE);
+        break;
+    }
+}
+
+/// Handle a valid frame from another badge over IR.
+void badge_ir_rx(uint8_t *payload, uint8_t len) {
+    sync_rx(payload, len);
+}
 
+/// Bring our IR beacon up to the moment, just before it's sent.
+void badge_ir_beacon() {
+    sync_stamp();
+}
+
+/// Initialize the badge, and light up to show that we're on.
+/**
+ ** This runs before the buttons are up, so that the display lights the
+ ** moment the battery goes in. If the factory self-test is going to run,
+ ** it has the display instead, and starts the boot animation when it
+ ** passes.
+ */
+void badge_init() {
+    sync_init();
+    badge_anim_play(BADGE_ANIM_PUMPKIN_PULSE);
 }
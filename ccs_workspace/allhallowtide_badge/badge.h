@@ -11,6 +11,25 @@
 #ifndef BADGE_H_
 #define BADGE_H_
 
+#include <stdint.h>
+
+/// Firmware version, which invalidates anything cached in FRAM by others.
+#define BADGE_FW_VERSION 0x0001
+
+/// Seconds between commits of the persistent config to FRAM.
+/**
+ ** Changes to `badge_conf` (including the clock, every second) are only
+ ** made in RAM, and written out at most this often. A brown-out loses at
+ ** most this much.
+ */
+#define BADGE_CLOCK_WRITE_INTERVAL 60
+/// Clock authority of a badge whose time was set by hand.
+/**
+ ** Every badge synced from it, directly or not, is one less per hop; see
+ ** sync.c. 0 means the clock is just counting from whenever it was last set.
+ */
+#define BADGE_CLOCK_AUTHORITY_MAX 0xff
+
 /// Bling animation interval in seconds. preferably a power of 2.
 #define BADGE_BLING_SECS 64
 /// Temperature in Fahrenheit over which to unlock this animation.
@@ -23,12 +42,142 @@
 /// SMCLK rate in Hz.
 #define SMCLK_RATE_HZ 8000000
 
-extern uint8_t button_state;
-extern volatile uint8_t f_long_press;
-extern volatile uint8_t f_second;
-extern volatile uint8_t f_time_loop;
+/// True if MCLK is too fast for FRAM to keep up without wait states.
+/**
+ ** The FR2633's FRAM reads with no wait states up to 8 MHz. Above that,
+ ** every fetch that misses the FRAM controller's small cache stalls the
+ ** CPU, and so code that runs every tick starts costing more, and less
+ ** predictably, the more there is of it.
+ */
+#define BADGE_FRAM_WAIT_STATES (MCLK_FREQ_MHZ > 8)
+
+/// Tag for a function in the hot set, which is run from RAM if it's worth it.
+/**
+ ** The hot set is the code that runs for every animated tick: the keyframe
+ ** interpolation in `leds_timestep()`, the gamma lookup in
+ ** `ht16d_put_colors()`, and the segment list builder in
+ ** `ht16d_send_gray()`. Helpers they inline come along with them. Anything
+ ** that runs once per keyframe, once per second, or on a button press is
+ ** not hot, and stays in FRAM.
+ **
+ ** When `BADGE_FRAM_WAIT_STATES`, these go in the linker's `.TI.ramfunc`
+ ** section, which is stored in FRAM and copied to RAM by the C startup
+ ** code. Otherwise FRAM is just as fast, and RAM is too scarce to spend
+ ** on it, so this does nothing. The large const tables the hot set reads
+ ** (`ht16d_gamma`, the `ht16d_row_*` maps, and the animations) always stay in
+ ** FRAM: they're several times the size of the code, and only a byte or
+ ** two of each is read per LED.
+ */
+#if BADGE_FRAM_WAIT_STATES
+#define BADGE_HOT __attribute__((ramfunc))
+#else
+#define BADGE_HOT
+#endif
+
+// Events that interrupts post to the main loop, in `badge_events`.
+//  Each one makes a task in main.c's `badge_tasks` runnable, and the
+//  main loop runs the most urgent of those first, and then checks again.
+//  Post one from an ISR with `badge_events |= EV_...;` (a single,
+//  uninterruptible instruction) and then wake the main loop with LPM4_EXIT,
+//  which covers whatever mode `power_sleep()` picked.
+
+/// Event from the IR driver indicating a complete frame has arrived.
+#define EV_IR_RX            0x0001
+/// Event asking for a CapTIvate pass. The CapTIvate task also runs
+///  whenever the library has flagged something, without this.
+#define EV_CAPT             0x0002
+/// Event for the system clock tick.
+#define EV_TIME_LOOP        0x0004
+/// Event that ticks every second.
+#define EV_SECOND           0x0008
+/// Event from the LED driver indicating a frame push has finished.
+#define EV_HT16D_TX_DONE    0x0010
+/// Event from the ADC indicating the badge is hot.
+#define EV_HOT              0x0020
+/// Event from the ADC indicating the badge is cold.
+#define EV_COLD             0x0040
+/// Event from the tick task, while there's still startup left to do.
+#define EV_BOOT             0x0080
+/// Event from the serial console indicating bytes have arrived.
+#define EV_CONSOLE          0x0100
+
+/// The number of badge IDs, which is how many the seen bitmap can hold.
+#define BADGE_ID_COUNT 128
+
+/// Animation ID of the pumpkin pulse: the boot and button feedback.
+#define BADGE_ANIM_PUMPKIN_PULSE    0
+/// Animation ID of the candle flicker: the default bling.
+#define BADGE_ANIM_CANDLE           1
+/// Animation ID of the ember glow: bling that heat unlocks.
+#define BADGE_ANIM_EMBER            2
+/// Animation ID of the frost creep: bling that cold unlocks.
+#define BADGE_ANIM_FROST            3
+/// Animation ID of the lantern breath: bling the LED controller runs itself.
+#define BADGE_ANIM_LANTERN          4
+/// The number of animations in the registry.
+#define BADGE_ANIM_COUNT            5
+/// Animation ID meaning no animation.
+#define BADGE_ANIM_NONE             0xff
+
+/// Bitmask of the animations every badge starts out with unlocked.
+#define BADGE_UNLOCKED_DEFAULT ((1 << BADGE_ANIM_PUMPKIN_PULSE) | (1 << BADGE_ANIM_CANDLE) | (1 << BADGE_ANIM_LANTERN))
+/// System ticks the lantern breathes for: two of the controller's long cycles.
+#define BADGE_LANTERN_TICKS 1040
+
+/// Animation priority for idle bling.
+#define BADGE_PRIO_BLING    0
+/// Animation priority for effects triggered by other badges, over IR.
+#define BADGE_PRIO_IR       1
+/// Animation priority for feedback to the buttons.
+#define BADGE_PRIO_BUTTON   2
+
+/// Animation requests that can wait for the display at once.
+#define BADGE_ANIM_QUEUE_LEN 4
+
+/// The badge's persistent configuration.
+/**
+ ** Two copies of this are kept in FRAM, and each commit overwrites the
+ ** older one. The CRC is over everything before it.
+ */
+typedef struct {
+    /// Incremented on every commit; the copy with the later one wins.
+    uint16_t seq;
+    /// The value of `rtc_seconds` as of the last time it was saved here.
+    uint32_t clock;
+    /// How trustworthy `clock` is. 0 means it's just counting since reset.
+    uint8_t clock_authority;
+    /// Nonzero until this board has passed the factory self-test.
+    uint8_t selftest_pending;
+    /// Bitmask of `BADGE_ANIM_*` IDs that are unlocked.
+    uint16_t unlocked;
+    /// How fast the REFO runs, in ppm, as far as clock syncs can tell.
+    int16_t rtc_trim_ppm;
+    /// Bitmap of badge IDs we've seen, or heard about; see sync.c.
+    uint8_t seen[BADGE_ID_COUNT / 8];
+    /// The LED brightness level the user picked; see `leds_set_brightness_level()`.
+    uint8_t brightness;
+    /// CRC-16 of the preceding fields.
+    uint16_t crc;
+} badge_conf_t;
+
+extern volatile uint16_t badge_events;
+extern badge_conf_t badge_conf;
 
+void badge_conf_load();
+void badge_conf_changed();
+void badge_conf_commit();
+void badge_set_time(uint32_t clock);
+void badge_step_time(int32_t seconds);
+void badge_save_time();
+void badge_set_authority(uint8_t authority);
 void badge_init();
-void badge_button_press_short();
+void badge_anim_play(uint8_t id);
+void badge_unlock(uint8_t id);
+void badge_bling();
+void badge_temp_unlock(uint8_t hot);
+void badge_timestep();
+void badge_input(uint8_t event);
+void badge_ir_rx(uint8_t *payload, uint8_t len);
+void badge_ir_beacon();
 
 #endif /* BADGE_H_ */
@@ -0,0 +1,193 @@
+/// CapTIvate calibration cache.
+/**
+ ** A full `CAPT_calibrateUI()` searches out the coarse gain, fine gain, and
+ ** offset tap for every element, which takes a few hundred conversions
+ ** and keeps the buttons dead for a visible moment after every boot. The
+ ** answer hardly changes from one boot to the next, so we keep the last
+ ** one in FRAM, and at boot we try it first. A single conversion of each
+ ** sensor with the cached tuning tells us if it's still any good: if every
+ ** element lands near its target count, we keep it, and otherwise we fall
+ ** back to a full calibration and cache that instead.
+ **
+ ** The cache is tagged with the firmware version and a checksum of the
+ ** sensor configuration, so retuning the sensors or even just flashing
+ ** new firmware starts fresh. Temperature and supply drift are what the
+ ** conversion check is for.
+ **
+ ** \file capt_cal.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "captivate.h"
+
+#include "badge.h"
+#include "fram.h"
+
+#include "capt_cal.h"
+
+/// Conversion frequencies that each element has a tuning for.
+/**
+ ** Self and mutual elements have the same number, since the config sets
+ ** them together.
+ */
+#define CAPT_CAL_FREQS CAPT_SELF_FREQ_CNT
+
+/// The conversion that measures every frequency that has a tuning.
+#if (CAPT_CAL_FREQS > 1)
+#define CAPT_CAL_CONVERSION eMultiFrequency
+#else
+#define CAPT_CAL_CONVERSION eStandard
+#endif
+
+/// The last calibration we saved.
+#pragma PERSISTENT(capt_cal)
+capt_cal_t capt_cal = {0};
+
+/// Copy every element's tuning to or from `tuning`, returning how many there are.
+/**
+ ** If `save` is true it copies from the elements into `tuning`, and
+ ** otherwise from `tuning` into the elements. Pass a null `tuning` to just
+ ** count them. Only the first `CAPT_CAL_MAX_TUNINGS` are copied, but they're
+ ** all counted, so a return larger than that means they don't fit.
+ */
+static uint8_t capt_cal_walk(tCaptivateApplication *pApp,
+                             tCaptivateElementTuning *tuning, uint8_t save) {
+    uint8_t count = 0;
+    tSensor *pSensor;
+    tElement *pElement;
+
+    for (uint8_t s=0; s<pApp->ui8NrOfSensors; s++) {
+        pSensor = pApp->pSensorList[s];
+        for (uint8_t c=0; c<pSensor->ui8NrOfCycles; c++) {
+            for (uint8_t e=0; e<pSensor->pCycle[c]->ui8NrOfElements; e++) {
+                pElement = pSensor->pCycle[c]->pElements[e];
+                for (uint8_t f=0; f<CAPT_CAL_FREQS; f++) {
+                    if (tuning && count < CAPT_CAL_MAX_TUNINGS) {
+                        if (save) {
+                            tuning[count] = pElement->pTuning[f];
+                        } else {
+                            pElement->pTuning[f] = tuning[count];
+                        }
+                    }
+                    count++;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+/// Checksum the parts of the sensor configuration that calibration depends on.
+static uint16_t capt_cal_config(tCaptivateApplication *pApp) {
+    uint16_t config = capt_cal_walk(pApp, 0, 0);
+    tSensor *pSensor;
+
+    for (uint8_t s=0; s<pApp->ui8NrOfSensors; s++) {
+        pSensor = pApp->pSensorList[s];
+        config = (config << 1 | config >> 15) ^ pSensor->ui16ConversionCount;
+        config = (config << 1 | config >> 15) ^ pSensor->ui16ConversionGain;
+        config = (config << 1 | config >> 15) ^ pSensor->ui8FreqDiv;
+    }
+
+    return config;
+}
+
+/// Convert every sensor once, and return true if its tuning still fits.
+/**
+ ** That is, if no sensor had a calibration error, and every element's raw
+ ** count, at every frequency, is within 1/2^`CAPT_CAL_TOLERANCE_SHIFT` of
+ ** its sensor's target. The conversions are made with the CPU in
+ ** `pApp->ui8AppLPM`.
+ */
+uint8_t capt_cal_verify(tCaptivateApplication *pApp) {
+    tSensor *pSensor;
+    tElement *pElement;
+    uint16_t target;
+    uint16_t tolerance;
+
+    for (uint8_t s=0; s<pApp->ui8NrOfSensors; s++) {
+        pSensor = pApp->pSensorList[s];
+        if (pSensor->bCalibrationError) {
+            return 0;
+        }
+
+        MAP_CAPT_updateSensorRawCount(pSensor, CAPT_CAL_CONVERSION,
+                                      eNoOversampling, pApp->ui8AppLPM);
+
+        target = pSensor->ui16ConversionCount;
+        tolerance = target >> CAPT_CAL_TOLERANCE_SHIFT;
+        for (uint8_t c=0; c<pSensor->ui8NrOfCycles; c++) {
+            for (uint8_t e=0; e<pSensor->pCycle[c]->ui8NrOfElements; e++) {
+                pElement = pSensor->pCycle[c]->pElements[e];
+                for (uint8_t f=0; f<CAPT_CAL_FREQS; f++) {
+                    if (pElement->pRawCount[f] < target - tolerance
+                            || pElement->pRawCount[f] > target + tolerance) {
+                        return 0;
+                    }
+                }
+            }
+        }
+    }
+
+    return 1;
+}
+
+/// Load the cached calibration, returning true if it's still good.
+/**
+ ** This converts each sensor once, with `capt_cal_verify()`. If it returns
+ ** false, the elements may be left with a tuning that's no good, and the
+ ** caller needs to do a full `CAPT_calibrateUI()`.
+ */
+uint8_t capt_cal_restore(tCaptivateApplication *pApp) {
+    if (capt_cal.version != BADGE_FW_VERSION
+            || capt_cal.config != capt_cal_config(pApp)
+            || capt_cal.count > CAPT_CAL_MAX_TUNINGS
+            || capt_cal.count != capt_cal_walk(pApp, capt_cal.tuning, 0)) {
+        return 0;
+    }
+
+    if (!capt_cal_verify(pApp)) {
+        return 0;
+    }
+
+    // Start the filters and long term averages from scratch on the first
+    //  real scan, just as they would after a calibration.
+    for (uint8_t s=0; s<pApp->ui8NrOfSensors; s++) {
+        MAP_CAPT_flagAllElementsForReseed(pApp->pSensorList[s]);
+    }
+
+    return 1;
+}
+
+/// Save the current calibration to the cache, if it's changed.
+/**
+ ** This is cheap when nothing has changed, so it's fine to call whenever
+ ** a recalibration might have happened. If the power goes out in the
+ ** middle of a write, the tuning it leaves behind won't pass the check in
+ ** `capt_cal_restore()`, so the worst case is one full calibration.
+ */
+void capt_cal_save(tCaptivateApplication *pApp) {
+    capt_cal_t cache;
+
+    // Clear the padding and any unused entries, so memcmp() can be fair.
+    memset(&cache, 0, sizeof(cache));
+    cache.version = BADGE_FW_VERSION;
+    cache.config = capt_cal_config(pApp);
+    cache.count = capt_cal_walk(pApp, cache.tuning, 1);
+
+    if (cache.count > CAPT_CAL_MAX_TUNINGS) {
+        return;
+    }
+
+    if (!memcmp(&cache, &capt_cal, sizeof(cache))) {
+        return;
+    }
+
+    fram_write(&capt_cal, &cache, sizeof(cache));
+}
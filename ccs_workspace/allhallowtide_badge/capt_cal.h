@@ -0,0 +1,47 @@
+/// Header for the CapTIvate calibration cache.
+/**
+ ** \file capt_cal.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef CAPT_CAL_H_
+#define CAPT_CAL_H_
+
+#include <stdint.h>
+
+#include "captivate.h"
+
+/// The most element tunings (elements times frequencies) we'll cache.
+/**
+ ** Three elements, at the four frequencies that the EMC noise profiles
+ ** calibrate for.
+ */
+#define CAPT_CAL_MAX_TUNINGS 12
+/// A cached calibration is good if raw counts are within 1/2^this of target.
+/**
+ ** Calibration aims every element's raw count at its sensor's
+ ** `ui16ConversionCount`, so a count that's wandered much further than
+ ** this means the cached tuning no longer fits (a different temperature
+ ** or supply, a finger on the button, or a different board entirely).
+ */
+#define CAPT_CAL_TOLERANCE_SHIFT 3
+
+/// The calibration cache, as it sits in FRAM.
+typedef struct {
+    /// `BADGE_FW_VERSION` that this was saved by.
+    uint16_t version;
+    /// Checksum of the sensor configuration this was calibrated for.
+    uint16_t config;
+    /// Number of valid entries in `tuning`.
+    uint8_t count;
+    /// Every element's tuning, in sensor, cycle, element, frequency order.
+    tCaptivateElementTuning tuning[CAPT_CAL_MAX_TUNINGS];
+} capt_cal_t;
+
+uint8_t capt_cal_verify(tCaptivateApplication *pApp);
+uint8_t capt_cal_restore(tCaptivateApplication *pApp);
+void capt_cal_save(tCaptivateApplication *pApp);
+
+#endif /* CAPT_CAL_H_ */
@@ -52,6 +52,215 @@
 
 #include "CAPT_Manager.h"
 
+#if ((CAPT_INTERFACE==__CAPT_UART_INTERFACE__)||\
+    (CAPT_INTERFACE==__CAPT_BULKI2C_INTERFACE__))
+//*****************************************************************************
+//
+//! \var g_ui8TelemetryScans counts scans since the last turn-taking packet.
+//! \var g_ui8TelemetryNext is the next packet to take its turn: the sensor ID
+//! times two, plus one for its sensor data rather than its element data.
+//! \var g_ui8TelemetryProx is the proximity state each sensor last reported.
+//
+//*****************************************************************************
+static uint8_t g_ui8TelemetryScans;
+static uint8_t g_ui8TelemetryNext;
+static uint8_t g_ui8TelemetryProx;
+
+//*****************************************************************************
+//
+//! Send at most one telemetry packet, per the CAPT_TELEMETRY_* settings.
+//!
+//! \param pApp is the application that was just scanned.
+//! \param ui8Changed is a bitmask of the sensors whose state just changed.
+//
+//*****************************************************************************
+static void CAPT_writeTelemetry(tCaptivateApplication *pApp,
+		uint8_t ui8Changed)
+{
+	uint8_t ui8SensorID;
+
+#if (CAPT_TELEMETRY_ON_CHANGE==true)
+	if (ui8Changed)
+	{
+		for (ui8SensorID=0; !(ui8Changed & (1 << ui8SensorID)); ui8SensorID++);
+		CAPT_writeSensorData(ui8SensorID);
+		return;
+	}
+#endif  // CAPT_TELEMETRY_ON_CHANGE
+
+	if (++g_ui8TelemetryScans < CAPT_TELEMETRY_DECIMATION)
+	{
+		return;
+	}
+	g_ui8TelemetryScans = 0;
+
+	//
+	// If the interface is still busy, this turn is dropped, not delayed.
+	//
+	ui8SensorID = g_ui8TelemetryNext >> 1;
+	if (g_ui8TelemetryNext & 1)
+	{
+		CAPT_writeSensorData(ui8SensorID);
+	}
+	else
+	{
+		CAPT_writeElementData(ui8SensorID);
+
+		// If trackpad enabled, check if sensor is trackpad, then
+		// send trackpad specific data to the design center.
+#if (CAPT_TRACKPAD_ENABLE == true)
+		if((pApp->pSensorList[ui8SensorID]->TypeOfSensor) == eTrackpad)
+		{
+			CAPT_writeTrackPadData(ui8SensorID);
+		}
+#endif  // CAPT_TRACKPAD_ENABLE
+	}
+
+	if (++g_ui8TelemetryNext >= (pApp->ui8NrOfSensors << 1))
+	{
+		g_ui8TelemetryNext = 0;
+	}
+}
+#endif  // CAPT_INTERFACE
+
+//*****************************************************************************
+//
+//! \var g_ui8RecalScans counts scans since the last slow recalibration tests.
+//
+//*****************************************************************************
+static uint8_t g_ui8RecalScans;
+
+//*****************************************************************************
+//
+//! \var g_ui8NoiseProfile is the CAPT_NOISE_PROFILE_* we're converting with.
+//! \var g_ui8NoiseScans counts scans in a row that argue for the other one.
+//
+//*****************************************************************************
+#if (CAPT_NOISE_PROFILE==CAPT_NOISE_PROFILE_ROBUST)
+static uint8_t g_ui8NoiseProfile = CAPT_NOISE_PROFILE_ROBUST;
+#else
+static uint8_t g_ui8NoiseProfile = CAPT_NOISE_PROFILE_LOW_POWER;
+#endif
+#if (CAPT_NOISE_PROFILE==CAPT_NOISE_PROFILE_ADAPTIVE)
+static uint8_t g_ui8NoiseScans;
+#endif
+
+//
+// Batched scanning takes apart what CAPT_updateSensor() does, so it's only
+// available on the low power profile. EMC's update functions do more than
+// can be shared.
+//
+#if (CAPT_BATCH_SCAN==true) && (CAPT_NOISE_PROFILE!=CAPT_NOISE_PROFILE_ROBUST)
+#define CAPT_MANAGER_BATCH
+#endif
+
+#ifdef CAPT_MANAGER_BATCH
+//*****************************************************************************
+//
+//! \var g_bBatchScan is true if CAPT_initUI() found the sensors batchable.
+//
+//*****************************************************************************
+static bool g_bBatchScan;
+
+//*****************************************************************************
+//
+//! Return true if every sensor in the application can be converted at once.
+//!
+//! That needs each sensor to be a single self mode time cycle, with the
+//! conversion and threshold settings that CAPT_applySensorParams() loads
+//! into the peripheral all the same as the first sensor's, and every element
+//! of every sensor on an RX block of its own.
+//!
+//! \param pApp is the application to check.
+//
+//*****************************************************************************
+static bool CAPT_canBatch(tCaptivateApplication *pApp)
+{
+	uint8_t ui8SensorID;
+	uint8_t ui8ElementID;
+	uint8_t ui8Blocks = 0;
+	tSensor *pFirst = pApp->pSensorList[0];
+	tSensor *pSensor;
+	const tCycle *pCycle;
+
+	for (ui8SensorID=0; ui8SensorID<pApp->ui8NrOfSensors; ui8SensorID++)
+	{
+		pSensor = pApp->pSensorList[ui8SensorID];
+		if ((pSensor->SensingMethod != eSelf)
+			|| (pSensor->ui8NrOfCycles != 1)
+			|| (pSensor->ui16ConversionCount != pFirst->ui16ConversionCount)
+			|| (pSensor->ui16ConversionGain != pFirst->ui16ConversionGain)
+			|| (pSensor->ui16ErrorThreshold != pFirst->ui16ErrorThreshold)
+			|| (pSensor->ui16ProxThreshold != pFirst->ui16ProxThreshold)
+			|| (pSensor->ui16NegativeTouchThreshold != pFirst->ui16NegativeTouchThreshold)
+			|| (pSensor->ui8FreqDiv != pFirst->ui8FreqDiv)
+			|| (pSensor->ui8ChargeLength != pFirst->ui8ChargeLength)
+			|| (pSensor->ui8TransferLength != pFirst->ui8TransferLength)
+			|| (pSensor->bModEnable != pFirst->bModEnable)
+			|| (pSensor->ui8BiasControl != pFirst->ui8BiasControl)
+			|| (pSensor->bCsDischarge != pFirst->bCsDischarge)
+			|| (pSensor->bCountFilterEnable != pFirst->bCountFilterEnable)
+			|| (pSensor->ui8CntBeta != pFirst->ui8CntBeta)
+			|| (pSensor->ui8LTABeta != pFirst->ui8LTABeta))
+		{
+			return false;
+		}
+
+		pCycle = pSensor->pCycle[0];
+		for (ui8ElementID=0; ui8ElementID<pCycle->ui8NrOfElements; ui8ElementID++)
+		{
+			if (ui8Blocks & (1 << pCycle->pElements[ui8ElementID]->ui8RxBlock))
+			{
+				return false;
+			}
+			ui8Blocks |= (1 << pCycle->pElements[ui8ElementID]->ui8RxBlock);
+		}
+	}
+
+	return true;
+}
+
+//*****************************************************************************
+//
+//! Convert every sensor in one time slot, and process each of them.
+//!
+//! This is CAPT_updateSensor() for all the sensors at once: the peripheral
+//! gets the (shared) sensor settings once, every sensor's cycle is loaded
+//! onto its own RX blocks, and one conversion measures them all. Then each
+//! is unloaded and processed, and gets its callback, the same as it would
+//! have from CAPT_updateSensor().
+//!
+//! \param pApp is the application to update.
+//
+//*****************************************************************************
+static void CAPT_updateBatch(tCaptivateApplication *pApp)
+{
+	uint8_t ui8SensorID;
+	tSensor *pSensor;
+
+	MAP_CAPT_applySensorParams(pApp->pSensorList[0]);
+	for (ui8SensorID=0; ui8SensorID<pApp->ui8NrOfSensors; ui8SensorID++)
+	{
+		MAP_CAPT_loadCycle(pApp->pSensorList[ui8SensorID], 0, 0, true);
+	}
+
+	MAP_CAPT_startConversionAndWaitUntilDone(&g_bEndOfConversionFlag,
+			pApp->ui8AppLPM);
+
+	for (ui8SensorID=0; ui8SensorID<pApp->ui8NrOfSensors; ui8SensorID++)
+	{
+		pSensor = pApp->pSensorList[ui8SensorID];
+		MAP_CAPT_unloadCycle(pSensor, 0, 0, true);
+		MAP_CAPT_processFSMCycle(pSensor, (tCycle *)pSensor->pCycle[0]);
+		MAP_CAPT_processSensor(pSensor);
+		if (pSensor->pvCallback != NULL)
+		{
+			pSensor->pvCallback(pSensor);
+		}
+	}
+}
+#endif  // CAPT_MANAGER_BATCH
+
 //
 // Link in the appropriate sensor functions based on whether
 // EMC (noise immunity) is enabled.  When EMC is enabled
@@ -89,6 +298,110 @@
 #define CAPT_MANAGER_UPDATE_SENSOR(sensor, lpm) CAPT_updateSensorWithEMC(sensor, lpm)
 #endif  // CAPT_CONDUCTED_NOISE_IMMUNITY_ENABLE
 
+#if (CAPT_NOISE_PROFILE==CAPT_NOISE_PROFILE_ADAPTIVE)
+//*****************************************************************************
+//
+//! Return true if this scan looked noisy, by the current profile's measure.
+//!
+//! The robust profile has the EMC module's own noise state for each sensor.
+//! The low power profile has only one conversion per element, so it counts
+//! an element that strays from its filtered count by CAPT_NOISE_THRESHOLD
+//! (in the same units as the EMC threshold, 128ths of its LTA) as noise.
+//! A touch strays too, but the count filter catches up with it in a scan or
+//! two, where noise keeps it straying scan after scan.
+//!
+//! \param pApp is the application that was just scanned.
+//
+//*****************************************************************************
+static bool CAPT_scanIsNoisy(tCaptivateApplication *pApp)
+{
+	uint8_t ui8SensorID;
+	uint8_t ui8CycleID;
+	uint8_t ui8ElementID;
+	tSensor *pSensor;
+	const tCycle *pCycle;
+	tElement *pElement;
+	uint16_t ui16Count;
+	uint16_t ui16Filtered;
+	uint16_t ui16Spread;
+
+	for (ui8SensorID=0; ui8SensorID<pApp->ui8NrOfSensors; ui8SensorID++)
+	{
+		pSensor = pApp->pSensorList[ui8SensorID];
+		if (g_ui8NoiseProfile == CAPT_NOISE_PROFILE_ROBUST)
+		{
+			if (pSensor->bSensorNoiseState == true)
+			{
+				return true;
+			}
+			continue;
+		}
+
+		for (ui8CycleID=0; ui8CycleID<pSensor->ui8NrOfCycles; ui8CycleID++)
+		{
+			pCycle = pSensor->pCycle[ui8CycleID];
+			for (ui8ElementID=0; ui8ElementID<pCycle->ui8NrOfElements; ui8ElementID++)
+			{
+				pElement = pCycle->pElements[ui8ElementID];
+				ui16Count = pElement->pRawCount[0];
+				ui16Filtered = pElement->filterCount.ui16Natural;
+				ui16Spread = (ui16Count > ui16Filtered) ?
+						(ui16Count - ui16Filtered) : (ui16Filtered - ui16Count);
+				if (((uint32_t)ui16Spread << 7) >
+					((uint32_t)CAPT_NOISE_THRESHOLD * pElement->LTA.ui16Natural))
+				{
+					return true;
+				}
+			}
+		}
+	}
+
+	return false;
+}
+
+//*****************************************************************************
+//
+//! Switch noise profiles, if enough scans in a row have argued for it.
+//!
+//! \param pApp is the application that was just scanned.
+//
+//*****************************************************************************
+static void CAPT_updateNoiseProfile(tCaptivateApplication *pApp)
+{
+	bool bNoisy = CAPT_scanIsNoisy(pApp);
+
+	if (g_ui8NoiseProfile == CAPT_NOISE_PROFILE_LOW_POWER)
+	{
+		g_ui8NoiseScans = bNoisy ? (g_ui8NoiseScans + 1) : 0;
+		if (g_ui8NoiseScans >= CAPT_NOISE_ENTER_SCANS)
+		{
+			CAPT_setNoiseProfile(CAPT_NOISE_PROFILE_ROBUST);
+		}
+	}
+	else
+	{
+		g_ui8NoiseScans = bNoisy ? 0 : (g_ui8NoiseScans + 1);
+		if (g_ui8NoiseScans >= CAPT_NOISE_EXIT_SCANS)
+		{
+			CAPT_setNoiseProfile(CAPT_NOISE_PROFILE_LOW_POWER);
+		}
+	}
+}
+#endif  // CAPT_NOISE_PROFILE
+
+uint8_t CAPT_getNoiseProfile(void)
+{
+	return g_ui8NoiseProfile;
+}
+
+void CAPT_setNoiseProfile(uint8_t ui8Profile)
+{
+#if (CAPT_NOISE_PROFILE==CAPT_NOISE_PROFILE_ADAPTIVE)
+	g_ui8NoiseProfile = ui8Profile;
+	g_ui8NoiseScans = 0;
+#endif  // CAPT_NOISE_PROFILE
+}
+
 void CAPT_initUI(tCaptivateApplication *pApp)
 {
     uint8_t ui8SensorID;
@@ -147,6 +460,10 @@ void CAPT_initUI(tCaptivateApplication *pApp)
 #if (CAPT_INTERFACE!=__CAPT_NO_INTERFACE__)
     CAPT_initCommInterface(pApp);
 #endif  // CAPT_INTERFACE
+
+#ifdef CAPT_MANAGER_BATCH
+    g_bBatchScan = CAPT_canBatch(pApp);
+#endif  // CAPT_MANAGER_BATCH
 }
 
 void CAPT_calibrateUI(tCaptivateApplication *pApp)
@@ -167,42 +484,82 @@ void CAPT_calibrateUI(tCaptivateApplication *pApp)
 void CAPT_updateUI(tCaptivateApplication *pApp)
 {
     uint8_t ui8SensorID;
+    bool bRecalTests;
+#if ((CAPT_INTERFACE==__CAPT_UART_INTERFACE__)||\
+    (CAPT_INTERFACE==__CAPT_BULKI2C_INTERFACE__))
+    uint8_t ui8Changed = 0;
+    uint8_t ui8Prox;
+    tSensor *pSensor;
+#endif  // CAPT_INTERFACE
 
     //
-    // Loop through all of the sensors in the application pointed to by
-    // pApp.  For each sensor, update/refresh all of its values via
-    // the appropriate sensor update fxn, check for any required re-calibrations,
-    // and if enabled, write the new data out of the serial interface.
+    // Update/refresh all of the values of every sensor in the application
+    // pointed to by pApp: all at once, if CAPT_initUI() found that they can
+    // share a conversion, or else one at a time via the update sensor macro,
+    // which selected the appropriate sensor update fxn based on whether or
+    // not EMC (noise immunity) is enabled.
+    //
+    // On the adaptive noise profile, that's only while it's on robust; the
+    // low power profile uses the plain update fxn, at one frequency.
+    //
+#ifdef CAPT_MANAGER_BATCH
+    if (g_bBatchScan && (g_ui8NoiseProfile == CAPT_NOISE_PROFILE_LOW_POWER))
+    {
+        CAPT_updateBatch(pApp);
+    }
+    else
+#endif  // CAPT_MANAGER_BATCH
+    {
+        for (ui8SensorID=0; ui8SensorID<(pApp->ui8NrOfSensors); ui8SensorID++)
+        {
+#if (CAPT_NOISE_PROFILE==CAPT_NOISE_PROFILE_ADAPTIVE)
+            if (g_ui8NoiseProfile == CAPT_NOISE_PROFILE_LOW_POWER)
+            {
+                MAP_CAPT_updateSensor(
+                        pApp->pSensorList[ui8SensorID],
+                        pApp->ui8AppLPM
+                        );
+                continue;
+            }
+#endif  // CAPT_NOISE_PROFILE
+            CAPT_MANAGER_UPDATE_SENSOR(
+                    pApp->pSensorList[ui8SensorID],
+                    pApp->ui8AppLPM
+                    );
+        }
+    }
+
+#if (CAPT_NOISE_PROFILE==CAPT_NOISE_PROFILE_ADAPTIVE)
+    CAPT_updateNoiseProfile(pApp);
+#endif  // CAPT_NOISE_PROFILE
+
+    bRecalTests = (++g_ui8RecalScans >= CAPT_RECAL_DECIMATION);
+    if (bRecalTests)
+    {
+        g_ui8RecalScans = 0;
+    }
+
+    //
+    // Then, for each sensor, check for any required re-calibrations, and if
+    // enabled, note any changes for the serial interface.
     //
     for (ui8SensorID=0; ui8SensorID<(pApp->ui8NrOfSensors); ui8SensorID++)
     {
-        //
-        // Update the sensor via the update sensor macro,
-        // which selected the appropriate sensor update fxn based on
-        // whether or not EMC (noise immunity) is enabled.
-        //
-        CAPT_MANAGER_UPDATE_SENSOR(
-                pApp->pSensorList[ui8SensorID],
-                pApp->ui8AppLPM
-                );
 
         //
-        // If the UART or Bulk I2C interface is enabled, write out element
-        // and sensor data here.
+        // If the UART or Bulk I2C interface is enabled, note whether this
+        // sensor's state changed, for CAPT_writeTelemetry().
         //
 #if ((CAPT_INTERFACE==__CAPT_UART_INTERFACE__)||\
     (CAPT_INTERFACE==__CAPT_BULKI2C_INTERFACE__))
-        CAPT_writeElementData(ui8SensorID);
-        CAPT_writeSensorData(ui8SensorID);
-
-        // If trackpad enabled, check if sensor is trackpad, then
-        // send trackpad specific data to the design center.
-#if (CAPT_TRACKPAD_ENABLE == true)
-        if((pApp->pSensorList[ui8SensorID]->TypeOfSensor) == eTrackpad)
+        pSensor = pApp->pSensorList[ui8SensorID];
+        ui8Prox = (pSensor->bSensorProx == true) ? (1 << ui8SensorID) : 0;
+        if ((pSensor->bSensorTouch != pSensor->bSensorPrevTouch)
+            || ((g_ui8TelemetryProx & (1 << ui8SensorID)) != ui8Prox))
         {
-            CAPT_writeTrackPadData(ui8SensorID);
+            ui8Changed |= (1 << ui8SensorID);
         }
-#endif  // CAPT_TRACKPAD_ENABLE
+        g_ui8TelemetryProx = (g_ui8TelemetryProx & ~(1 << ui8SensorID)) | ui8Prox;
 #endif  // CAPT_INTERFACE
 
         //
@@ -210,15 +567,22 @@ void CAPT_updateUI(tCaptivateApplication *pApp)
         // operating range and needs to be re-calibrated.  If it requires
         // re-calibration,call the appropriate calibration routine via the
         // calibrate sensor macro, which selects the fxn based on whether
-        // or not EMC (noise immunity) is enabled.
+        // or not EMC (noise immunity) is enabled. Drift is slow, so only
+        // the max count test runs on every scan.
         //
         if ((MAP_CAPT_testForMaxCountRecalibration(pApp->pSensorList[ui8SensorID]) == true) ||\
-            (MAP_CAPT_testForNegativeTouchRecalibration(pApp->pSensorList[ui8SensorID]) == true) ||\
-            (MAP_CAPT_testForRecalibration(pApp->pSensorList[ui8SensorID]) == true))
+            (bRecalTests &&
+             ((MAP_CAPT_testForNegativeTouchRecalibration(pApp->pSensorList[ui8SensorID]) == true) ||\
+              (MAP_CAPT_testForRecalibration(pApp->pSensorList[ui8SensorID]) == true))))
         {
             CAPT_MANAGER_CALIBRATE_SENSOR(pApp->pSensorList[ui8SensorID]);
         }
     } // End of sensor for loop
+
+#if ((CAPT_INTERFACE==__CAPT_UART_INTERFACE__)||\
+    (CAPT_INTERFACE==__CAPT_BULKI2C_INTERFACE__))
+    CAPT_writeTelemetry(pApp, ui8Changed);
+#endif  // CAPT_INTERFACE
 }
 
 bool CAPT_getGlobalUIProximityStatus(tCaptivateApplication *pApp)
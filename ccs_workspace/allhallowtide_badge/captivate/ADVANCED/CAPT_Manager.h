@@ -101,6 +101,33 @@ extern void CAPT_calibrateUI(tCaptivateApplication *pApp);
 //*****************************************************************************
 extern void CAPT_updateUI(tCaptivateApplication *pApp);
 
+//*****************************************************************************
+//
+//! Return the noise profile that CAPT_updateUI() is converting with.
+//!
+//!  \par Returns
+//!		CAPT_NOISE_PROFILE_LOW_POWER or CAPT_NOISE_PROFILE_ROBUST.
+//
+//*****************************************************************************
+extern uint8_t CAPT_getNoiseProfile(void);
+
+//*****************************************************************************
+//
+//! Switch the noise profile that CAPT_updateUI() converts with.
+//
+//! This only has an effect if CAPT_NOISE_PROFILE is
+//! CAPT_NOISE_PROFILE_ADAPTIVE, and then only until the noise it measures
+//! says otherwise.
+//
+//! \param ui8Profile is CAPT_NOISE_PROFILE_LOW_POWER or
+//! CAPT_NOISE_PROFILE_ROBUST.
+//!
+//!  \par Returns
+//!		none
+//
+//*****************************************************************************
+extern void CAPT_setNoiseProfile(uint8_t ui8Profile);
+
 //*****************************************************************************
 //
 //! Return true if any sensor in the UI configuration has a proximity
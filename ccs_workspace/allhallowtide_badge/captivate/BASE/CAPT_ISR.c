@@ -49,6 +49,7 @@
 #include <msp430.h>
 #include <stdbool.h>
 #include "CAPT_HAL.h"
+#include "trace.h"
 
 //*****************************************************************************
 //
@@ -87,6 +88,7 @@ volatile bool g_bMaxCountErrorFlag;
 #pragma vector=CAPTIVATE_VECTOR
 __interrupt void CAPT_ISR(void)
 {
+	TRACE_ISR_ENTER();
 	switch(__even_in_range(CAPT_getInterruptVector(), CAPT_IV_MAX_COUNT_ERROR))
 	{
 		// End of Conversion Interrupt
@@ -114,6 +116,7 @@ __interrupt void CAPT_ISR(void)
 			g_bMaxCountErrorFlag = true;
 			break;
 	}
+	TRACE_ISR_EXIT();
 	__bic_SR_register_on_exit(LPM3_bits);
 }
 //*****************************************************************************
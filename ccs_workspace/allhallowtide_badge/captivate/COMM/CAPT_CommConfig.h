@@ -71,6 +71,26 @@
 //*****************************************************************************
 #include "CAPT_UserConfig.h"
 
+//*****************************************************************************
+//
+//! def CAPT_GENERAL_PURPOSE_WORDS_MAX defines the most 16-bit integers that
+//! CAPT_writeGeneralPurposeData() will send in one packet.  The protocol
+//! allows up to 29, but every one costs 4 bytes in each transmit buffer.
+//
+//*****************************************************************************
+#define CAPT_GENERAL_PURPOSE_WORDS_MAX		(12)
+
+//*****************************************************************************
+//
+//! def CAPT_LARGEST_PACKET_LENGTH defines the length, before byte stuffing,
+//! of the largest packet that is sent: a general purpose packet of
+//! CAPT_GENERAL_PURPOSE_WORDS_MAX integers, plus the serial overhead, the
+//! command and count bytes, and the checksum.  The sensor, cycle and
+//! parameter packets for this application's sensors are all shorter.
+//
+//*****************************************************************************
+#define CAPT_LARGEST_PACKET_LENGTH			(3 + 2 + 2*CAPT_GENERAL_PURPOSE_WORDS_MAX + 2)
+
 //*****************************************************************************
 //
 //! def CAPT_TRANSMIT_BUFFER_SIZE defines the size of the transmit buffer.
@@ -79,7 +99,7 @@
 //! for byte stuffing.
 //
 //*****************************************************************************
-#define CAPT_TRANSMIT_BUFFER_SIZE			(48)
+#define CAPT_TRANSMIT_BUFFER_SIZE			(64)
 
 //*****************************************************************************
 //
@@ -103,6 +123,24 @@
 //*****************************************************************************
 #define CAPT_I2C_REGISTER_RW_BUFFER_SIZE	(32)
 
+//*****************************************************************************
+//
+// Compile-time checks on the buffer sizes above.  The byte stuffing is done
+// in place, in the transmit buffer, so one that's too short for the largest
+// packet is overrun, into its neighbor.  The queue and buffer lengths are
+// 16 bits in the byte queue and the protocol layer.
+//
+//*****************************************************************************
+#if (CAPT_TRANSMIT_BUFFER_SIZE < (2 * CAPT_LARGEST_PACKET_LENGTH))
+#error "CAPT_TRANSMIT_BUFFER_SIZE must be at least 2x CAPT_LARGEST_PACKET_LENGTH"
+#endif
+#if (CAPT_GENERAL_PURPOSE_WORDS_MAX > 29)
+#error "CAPT_GENERAL_PURPOSE_WORDS_MAX is more than the protocol allows"
+#endif
+#if (CAPT_QUEUE_BUFFER_SIZE > 0xFFFF)
+#error "CAPT_QUEUE_BUFFER_SIZE must fit in 16 bits"
+#endif
+
 //*****************************************************************************
 //
 //! The I2C request line is the mechanism by which the I2C slave (this device)
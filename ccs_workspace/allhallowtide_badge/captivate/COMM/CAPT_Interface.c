@@ -51,6 +51,8 @@
 #include "I2CSlave.h"
 #include "CAPT_Interface.h"
 
+#include "console.h"
+
 //
 // If an interface is selected, include the interface layer
 //
@@ -86,6 +88,19 @@ static uint8_t g_ui8TransmitBuffer_pong[CAPT_TRANSMIT_BUFFER_SIZE];
 //*****************************************************************************
 static uint8_t g_ui8QueueBuffer[CAPT_QUEUE_BUFFER_SIZE];
 
+//
+// The Design Center's parameter packets are what's queued, and one can come
+// in, stuffed, while the last is waiting to be processed. The fixed-length
+// packets must also be covered by CAPT_LARGEST_PACKET_LENGTH, which sizes
+// the transmit buffers (see CAPT_CommConfig.h).
+//
+#if (CAPT_QUEUE_BUFFER_SIZE < (4 * TL_PARAMETER_PACKET_LENGTH))
+#error "CAPT_QUEUE_BUFFER_SIZE must hold two stuffed parameter packets"
+#endif
+#if (CAPT_LARGEST_PACKET_LENGTH < TL_PARAMETER_PACKET_LENGTH) || (CAPT_LARGEST_PACKET_LENGTH < TL_SENSOR_PACKET_LENGTH)
+#error "CAPT_LARGEST_PACKET_LENGTH is shorter than a parameter or sensor packet"
+#endif
+
 //*****************************************************************************
 //
 //! \static g_PingPongBuffer is the transmit ping-pong buffer.
@@ -157,6 +172,11 @@ static bool CAPT_UARTReceiveHandler(uint8_t ui8Data)
 			&g_ReceiveQueue,
 			ui8Data
 		);
+
+	//
+	// The badge's serial console shares the port, in its own framing.
+	//
+	console_rx_byte(ui8Data);
 	return true;
 }
 
@@ -322,6 +342,16 @@ void CAPT_initCommInterface(tCaptivateApplication *pApp)
 
 }
 
+bool CAPT_isInterfaceBusy(void)
+{
+#if (CAPT_INTERFACE==__CAPT_UART_INTERFACE__)
+	return (UART_isBufferQueued(g_PingPongBuffer.pEditBuffer)
+			|| UART_isQueueFull());
+#else
+	return false;
+#endif
+}
+
 bool CAPT_writeElementData(uint8_t ui8SensorID)
 {
 #if ((CAPT_INTERFACE==__CAPT_BULKI2C_INTERFACE__) || (CAPT_INTERFACE==__CAPT_UART_INTERFACE__))
@@ -344,6 +374,14 @@ bool CAPT_writeElementData(uint8_t ui8SensorID)
 			ui8Cycle < g_pApp->pSensorList[ui8SensorID]->ui8NrOfCycles;
 			ui8Cycle++)
 	{
+		//
+		// Drop the rest, rather than wait for the interface.
+		//
+		if (CAPT_isInterfaceBusy() == true)
+		{
+			return false;
+		}
+
 		ui16Length = MAP_CAPT_getCyclePacket(g_pApp->pSensorList,
 				ui8SensorID, ui8Cycle, g_PingPongBuffer.pEditBuffer);
 		if (ui16Length==0)
@@ -379,7 +417,8 @@ bool CAPT_writeSensorData(uint8_t ui8SensorID)
 	uint16_t ui16Length;
 
 	if ((g_pApp->bSensorDataTxEnable == false)
-			|| (g_pApp->pSensorList[ui8SensorID] == 0))
+			|| (g_pApp->pSensorList[ui8SensorID] == 0)
+			|| (CAPT_isInterfaceBusy() == true))
 	{
 		return false;
 	}
@@ -416,6 +455,20 @@ bool CAPT_writeGeneralPurposeData(uint16_t *pData, uint8_t ui8Cnt)
 
 	uint16_t ui16Length;
 
+	//
+	// The transmit buffers are only sized for this many (see
+	// CAPT_CommConfig.h).
+	//
+	if (ui8Cnt > CAPT_GENERAL_PURPOSE_WORDS_MAX)
+	{
+		return false;
+	}
+
+	if (CAPT_isInterfaceBusy() == true)
+	{
+		return false;
+	}
+
 	ui16Length = CAPT_getGeneralPurposePacket(pData,
 			ui8Cnt, g_PingPongBuffer.pEditBuffer);
 	if (ui16Length==0)
@@ -449,6 +502,11 @@ bool CAPT_writeString(const char *pSrcString)
 
 	uint16_t ui16Length;
 
+	if (CAPT_isInterfaceBusy() == true)
+	{
+		return false;
+	}
+
 	ui16Length = CAPT_getStringPacket(pSrcString, g_PingPongBuffer.pEditBuffer);
 	if (ui16Length==0)
 	{
@@ -481,7 +539,8 @@ bool CAPT_writeTrackPadData(uint8_t ui8SensorID)
 
 	uint16_t ui16Length;
 
-	if ((g_pApp->bSensorDataTxEnable == false) || (ui8SensorID == 0xFF))
+	if ((g_pApp->bSensorDataTxEnable == false) || (ui8SensorID == 0xFF)
+			|| (CAPT_isInterfaceBusy() == true))
 	{
 		return false;
 	}
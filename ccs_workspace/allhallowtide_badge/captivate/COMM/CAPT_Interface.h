@@ -84,6 +84,22 @@ extern void CAPT_initCommInterface(tCaptivateApplication *pApp);
 //*****************************************************************************
 extern bool CAPT_writeElementData(uint8_t ui8SensorID);
 
+//*****************************************************************************
+//
+//! Check whether the interface has nowhere to put another packet.
+//!
+//! The UART queues packets, rather than waiting for them to go out, so a
+//! packet can be written as long as the ping-pong buffer it will be built
+//! in is done sending, and the queue has room. Every write drops its
+//! packet, rather than wait, while this is true, so that telemetry never
+//! stalls a scan.
+//
+//! \par Returns
+//!		true if a packet written now would be dropped, else false.
+//
+//*****************************************************************************
+extern bool CAPT_isInterfaceBusy(void);
+
 //*****************************************************************************
 //
 //! Transmit all sensor-specific data for a given sensor.
@@ -76,6 +76,32 @@ volatile uint16_t g_ui16UARTTransmitBytesLeft;
 //*****************************************************************************
 volatile uint8_t g_UARTStatus;
 
+//*****************************************************************************
+//
+//! var g_UARTQueue stores the buffers waiting to transmit. The one at
+//! g_ui8UARTQueueHead is the one g_pUARTTransmitPtr is walking through.
+//! var g_ui8UARTQueueHead is the index of the oldest queued buffer.
+//! var g_ui8UARTQueueCount is how many buffers are queued, including the
+//! one being sent.
+//
+//*****************************************************************************
+tUARTDescriptor g_UARTQueue[UART__TX_QUEUE_LEN];
+volatile uint8_t g_ui8UARTQueueHead;
+volatile uint8_t g_ui8UARTQueueCount;
+
+//*****************************************************************************
+//
+//! Start sending the buffer at the head of the queue.
+//!
+//! Call this with interrupts disabled, or from the ISR.
+//
+//*****************************************************************************
+static void UART_startHead(void)
+{
+	g_pUARTTransmitPtr = g_UARTQueue[g_ui8UARTQueueHead].pBuffer;
+	g_ui16UARTTransmitBytesLeft = g_UARTQueue[g_ui8UARTQueueHead].ui16Length;
+}
+
 void UART_openPort(const tUARTPort *pPort)
 {
 	UART_closePort();
@@ -101,6 +127,7 @@ void UART_openPort(const tUARTPort *pPort)
 void UART_closePort(void)
 {
 	g_UARTStatus = eUARTIsClosed;
+	g_ui8UARTQueueCount = 0;
 	MAP_EUSCI_A_UART_disable(UART__EUSCI_A_PERIPHERAL);
 }
 
@@ -109,42 +136,78 @@ uint8_t UART_getPortStatus(void)
 	return g_UARTStatus;
 }
 
-void UART_transmitBuffer(const uint8_t *pBuffer, uint16_t ui16Length)
+bool UART_transmitBuffer(const uint8_t *pBuffer, uint16_t ui16Length)
 {
-	if (g_UARTStatus == eUARTIsClosed)
+	uint16_t ui16GIE;
+	uint8_t ui8Tail;
+
+	if ((g_UARTStatus == eUARTIsClosed) || (ui16Length == 0))
 	{
-		return;
+		return false;
 	}
-	
+
 	//
-	// Before transmitting, safely wait for
-	// current operations to finish
+	// The ISR moves the head, so the queue has to hold still while we
+	// look at it.
 	//
-#if (UART__LPMx_bits>0)
-	while (1)
+	ui16GIE = __get_SR_register() & GIE;
+	__bic_SR_register(GIE);
+
+	if (g_ui8UARTQueueCount >= UART__TX_QUEUE_LEN)
 	{
-		__bic_SR_register(GIE);
-		if (g_UARTStatus != eUARTIsIdle)
-		{
-			__bis_SR_register(UART__LPMx_bits | GIE);
-		}
-		else
+		__bis_SR_register(ui16GIE);
+		return false;
+	}
+
+	ui8Tail = (g_ui8UARTQueueHead + g_ui8UARTQueueCount)
+			& (UART__TX_QUEUE_LEN - 1);
+	g_UARTQueue[ui8Tail].pBuffer = pBuffer;
+	g_UARTQueue[ui8Tail].ui16Length = ui16Length;
+	g_ui8UARTQueueCount++;
+
+	//
+	// If the queue was empty, this buffer starts right away. Otherwise,
+	// the ISR gets to it when the ones ahead of it are done.
+	//
+	if (g_UARTStatus == eUARTIsIdle)
+	{
+		UART_startHead();
+		g_UARTStatus = eUARTIsTransmitting;
+		MAP_EUSCI_A_UART_enableInterrupt(
+				UART__EUSCI_A_PERIPHERAL,
+				EUSCI_A_UART_TRANSMIT_INTERRUPT
+			);
+	}
+
+	__bis_SR_register(ui16GIE);
+	return true;
+}
+
+bool UART_isQueueFull(void)
+{
+	return (g_ui8UARTQueueCount >= UART__TX_QUEUE_LEN);
+}
+
+bool UART_isBufferQueued(const uint8_t *pBuffer)
+{
+	uint16_t ui16GIE;
+	uint8_t ui8Index;
+	bool bQueued = false;
+
+	ui16GIE = __get_SR_register() & GIE;
+	__bic_SR_register(GIE);
+	for (ui8Index = 0; ui8Index < g_ui8UARTQueueCount; ui8Index++)
+	{
+		if (g_UARTQueue[(g_ui8UARTQueueHead + ui8Index)
+				& (UART__TX_QUEUE_LEN - 1)].pBuffer == pBuffer)
 		{
-			__bis_SR_register(GIE);
+			bQueued = true;
 			break;
 		}
-	};
-#else
-	while(g_UARTStatus != eUARTIsIdle);
-#endif
-
-	g_pUARTTransmitPtr = pBuffer;
-	g_ui16UARTTransmitBytesLeft = ui16Length;
-	g_UARTStatus = eUARTIsTransmitting;
-	MAP_EUSCI_A_UART_enableInterrupt(
-			UART__EUSCI_A_PERIPHERAL,
-			EUSCI_A_UART_TRANSMIT_INTERRUPT
-		);
+	}
+	__bis_SR_register(ui16GIE);
+
+	return bQueued;
 }
 
 extern void UART_transmitByteImmediately(uint8_t ui8Data)
@@ -209,11 +272,25 @@ __interrupt void UART_ISR(void)
 
 			if (g_ui16UARTTransmitBytesLeft == 0)
 			{
-				MAP_EUSCI_A_UART_disableInterrupt(
-						UART__EUSCI_A_PERIPHERAL,
-						EUSCI_A_UART_TRANSMIT_INTERRUPT
-					);
-				g_UARTStatus = eUARTIsIdle;
+				//
+				// This buffer is done. Go straight on to the next one, if
+				// there is one, or else go idle.
+				//
+				g_ui8UARTQueueHead = (g_ui8UARTQueueHead + 1)
+						& (UART__TX_QUEUE_LEN - 1);
+				g_ui8UARTQueueCount--;
+				if (g_ui8UARTQueueCount > 0)
+				{
+					UART_startHead();
+				}
+				else
+				{
+					MAP_EUSCI_A_UART_disableInterrupt(
+							UART__EUSCI_A_PERIPHERAL,
+							EUSCI_A_UART_TRANSMIT_INTERRUPT
+						);
+					g_UARTStatus = eUARTIsIdle;
+				}
 				__bic_SR_register_on_exit(UART__LPMx_bits);
 			}
 			break;
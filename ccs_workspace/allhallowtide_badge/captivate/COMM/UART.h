@@ -116,6 +116,26 @@ typedef struct
 
 } tUARTPort;
 
+//*****************************************************************************
+//
+//! \typedef tUARTDescriptor is one buffer in the transmit queue.
+//
+//*****************************************************************************
+typedef struct
+{
+	//
+	//! The start of the buffer.  The driver reads from it, but never
+	//! modifies it, until the last of it has gone out.
+	//
+	const uint8_t *pBuffer;
+
+	//
+	//! The number of bytes to send from pBuffer.
+	//
+	uint16_t ui16Length;
+
+} tUARTDescriptor;
+
 //*****************************************************************************
 //
 //! \enum tUARTStates enumerates the possible UART driver states.
@@ -178,19 +198,39 @@ extern uint8_t UART_getPortStatus(void);
 
 //*****************************************************************************
 //
-//! This API begins transmission of the buffer pointed to as soon as the
-//! UART hardware resources are available.  If a previous transmission is
-//! still in progress, this function will block until it is complete.
-//! The blocking may take place in a low power mode if desired by
-//! configuring UART__LPMx_bits in the UART_Definitions.h header file.
+//! This API queues the buffer pointed to for transmission, and returns
+//! without waiting for it.  Queued buffers go out back to back, in order,
+//! from the ISR.  The buffer must not be modified until
+//! UART_isBufferQueued() says it's done.  If the port is closed, or
+//! UART__TX_QUEUE_LEN buffers are already queued, nothing is queued.
 //
 //! \param pBuffer is a pointer to the buffer to transmit
 //! \param ui16Length indicates the valid byte length of the buffer to transmit
-//!  \par Returns
+//! \return true if the buffer was queued, or false if it was not.
+//
+//*****************************************************************************
+extern bool UART_transmitBuffer(const uint8_t *pBuffer, uint16_t ui16Length);
+
+//*****************************************************************************
+//
+//! This API returns true if there's no room to queue another buffer.
+//
+//!  \par Parameters
 //!		none
+//! \return true if UART_transmitBuffer() would fail for lack of room.
+//
+//*****************************************************************************
+extern bool UART_isQueueFull(void);
+
+//*****************************************************************************
+//
+//! This API returns true if the buffer is still queued or being sent.
+//
+//! \param pBuffer is the start of a buffer passed to UART_transmitBuffer().
+//! \return true if the driver may still read from pBuffer.
 //
 //*****************************************************************************
-extern void UART_transmitBuffer(const uint8_t *pBuffer, uint16_t ui16Length);
+extern bool UART_isBufferQueued(const uint8_t *pBuffer);
 
 //*****************************************************************************
 //
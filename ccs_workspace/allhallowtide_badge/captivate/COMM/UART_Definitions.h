@@ -84,6 +84,18 @@
 //*****************************************************************************
 #define UART__LPMx_bits				                                (LPM0_bits)
 
+//*****************************************************************************
+//
+//! def UART__TX_QUEUE_LEN defines how many buffers can be queued to transmit
+//! at once.  This must be a power of 2.
+//
+//*****************************************************************************
+#define UART__TX_QUEUE_LEN			                                        (4)
+
+#if ((UART__TX_QUEUE_LEN & (UART__TX_QUEUE_LEN - 1)) || (UART__TX_QUEUE_LEN > 128))
+#error "UART__TX_QUEUE_LEN must be a power of 2, and fit the 8-bit queue count"
+#endif
+
 //*****************************************************************************
 //
 //! def UART__SAMPLING_MODE defines the eUSCI_A LF or HF mode.
@@ -38,6 +38,10 @@
 //*****************************************************************************
 
 #include "captivate.h"
+#include "capt_cal.h"
+#include "power.h"
+#include "prof.h"
+#include "wdt.h"
 
 //*****************************************************************************
 //
@@ -98,9 +102,17 @@ void CAPT_appStart(void)
     //
     // Calibrate the user interface.  This function establishes
     // coarse gain, fine gain, and offset tap tuning settings for
-    // each element in the user interface.
+    // each element in the user interface.  If the calibration cached
+    // in FRAM from last time still checks out, use that instead, and
+    // skip the full calibration.
     //
-    MAP_CAPT_calibrateUI(&g_uiApp);
+    if (!capt_cal_restore(&g_uiApp))
+    {
+        wdt_op_begin(WDT_OP_CAPT_CAL);
+        MAP_CAPT_calibrateUI(&g_uiApp);
+        wdt_op_end();
+        capt_cal_save(&g_uiApp);
+    }
 
     //
     // Setup Captivate timer
@@ -116,6 +128,7 @@ void CAPT_appStart(void)
     MAP_CAPT_writeTimerCompRegister(CAPT_MS_TO_CYCLES(g_uiApp.ui16ActiveModeScanPeriod));
     MAP_CAPT_startTimer();
     MAP_CAPT_enableISR(CAPT_TIMER_INTERRUPT);
+    power_need(POWER_CLIENT_CAPT, POWER_CLOCK_ACLK);
 
 #ifdef CAPT_WOP_VLO_LPM4
     g_ui8SavedAppLPM  = g_uiApp.ui8AppLPM;
@@ -139,7 +152,11 @@ bool CAPT_appHandler(void)
                 // and update the UI
                 //
                 g_bConvTimerFlag = false;
-                MAP_CAPT_updateUI(&g_uiApp);
+                {
+                    PROF_BEGIN(PROF_CAPT_UPDATE);
+                    MAP_CAPT_updateUI(&g_uiApp);
+                    PROF_END(PROF_CAPT_UPDATE);
+                }
                 bActivity = MAP_CAPT_getGlobalUIProximityStatus(&g_uiApp);
 
                 //
@@ -164,6 +181,13 @@ bool CAPT_appHandler(void)
                     g_uiApp.state = eUIWakeOnProx;
                     bActivity = false;
 
+                    //
+                    // The library may have recalibrated sensors on its own
+                    // during the session, so this is a good quiet moment
+                    // to bring the calibration cache up to date.
+                    //
+                    capt_cal_save(&g_uiApp);
+
                     //
                     // Set the timer period for wake on touch interval
                     //
@@ -176,6 +200,7 @@ bool CAPT_appHandler(void)
                     MAP_CAPT_selectTimerSource(CAPT_TIMER_SRC_VLOCLK);
                     MAP_CAPT_writeTimerCompRegister(CAPT_MS_TO_CYCLES_VLO(g_uiApp.ui16WakeOnProxModeScanPeriod));
                     g_uiApp.ui8AppLPM = LPM4_bits;
+                    power_need(POWER_CLIENT_CAPT, POWER_CLOCK_NONE);
 #endif  // CAPT_WOP_VLO_LPM4
                     MAP_CAPT_startTimer();
                     g_bConvTimerFlag = false;
@@ -213,6 +238,7 @@ bool CAPT_appHandler(void)
 #ifdef CAPT_WOP_VLO_LPM4
                 MAP_CAPT_selectTimerSource(CAPT_TIMER_SRC_ACLK);
                 g_uiApp.ui8AppLPM = g_ui8SavedAppLPM;
+                power_need(POWER_CLIENT_CAPT, POWER_CLOCK_ACLK);
 #endif  // CAPT_WOP_VLO_LPM4
                 MAP_CAPT_writeTimerCompRegister(CAPT_MS_TO_CYCLES(g_uiApp.ui16ActiveModeScanPeriod));
 
@@ -248,6 +274,7 @@ bool CAPT_appHandler(void)
                     0
                     );
             MAP_CAPT_calibrateUI(&g_uiApp);
+            capt_cal_save(&g_uiApp);
             MAP_CAPT_startWakeOnProxMode(
                     &CAPT_WAKEONPROX_SENSOR,
                     0,
@@ -257,9 +284,11 @@ bool CAPT_appHandler(void)
         else
         {
             MAP_CAPT_calibrateUI(&g_uiApp);
+            capt_cal_save(&g_uiApp);
         }
 #else
         MAP_CAPT_calibrateUI(&g_uiApp);
+        capt_cal_save(&g_uiApp);
 #endif  // CAPT_WAKEONPROX_ENABLE
     }
 #endif  // CAPT_INTERFACE
@@ -270,13 +299,14 @@ bool CAPT_appHandler(void)
 void CAPT_appSleep(void)
 {
     //
-    // If no captivate flags are set, enter the application's low power
-    // mode.  Otherwise, re-enter the background loop immediately.
+    // If no captivate flags are set, enter the deepest low power mode that
+    // every driver allows.  Otherwise, re-enter the background loop
+    // immediately.
     //
     __bic_SR_register(GIE);
     if (!(g_bConvTimerFlag ||g_bDetectionFlag || g_bConvCounterFlag || g_bMaxCountErrorFlag))
     {
-        __bis_SR_register(g_uiApp.ui8AppLPM | GIE);
+        power_sleep();
     }
     else
     {
@@ -375,5 +375,5 @@ tCaptivateApplication g_uiApp =
     .ui16ActiveModeScanPeriod = 33,
     .ui16WakeOnProxModeScanPeriod = 100,
     .ui16InactivityTimeout = 32,
-    .ui8WakeupInterval = 5,
+    .ui8WakeupInterval = 100,
 };
@@ -78,16 +78,86 @@
 // Compile-Time System Configuration Definitions
 //
 #define CAPT_SENSOR_COUNT                     (3)
+//
+// The Debug build streams sensor data to the CapTIvate Design Center over
+// the UART. Production (Release) builds define BADGE_PRODUCTION, which
+// leaves the interface out, along with all of its per-scan packet work,
+// and frees UCA0 for the IR link.
+//
+#ifdef BADGE_PRODUCTION
+#define CAPT_INTERFACE  (__CAPT_NO_INTERFACE__)
+#else
 #define CAPT_INTERFACE  (__CAPT_UART_INTERFACE__)
-#define CAPT_WAKEONPROX_ENABLE  (false)
-#define CAPT_WAKEONPROX_SENSOR  (none)
+#endif
+#define CAPT_WAKEONPROX_ENABLE  (true)
+#define CAPT_WAKEONPROX_SENSOR  (BTN00_NOSE)
 #define CAPT_TRACKPAD_ENABLE  (false)
-#define CAPT_LOW_POWER_MODE (LPM0_bits)
+#define CAPT_LOW_POWER_MODE (LPM3_bits)
+
+//
+// Design Center telemetry, for builds with the UART interface. Rather than
+// every packet on every scan, one packet goes out every
+// CAPT_TELEMETRY_DECIMATION scans, taking turns through each sensor's
+// element and sensor data. If CAPT_TELEMETRY_ON_CHANGE is true, a sensor
+// whose touch or proximity state changes sends its sensor data on that scan.
+// Anything that would have to wait for the UART is dropped.
+//
+#define CAPT_TELEMETRY_DECIMATION  (8)
+#define CAPT_TELEMETRY_ON_CHANGE  (true)
+
+//
+// Batched scanning. If CAPT_BATCH_SCAN is true, and every sensor is a single
+// time cycle with the same conversion and threshold settings, and no two of
+// their elements share an RX block, CAPT_updateUI() converts all of them
+// together in one time slot instead of one after another (see
+// CAPT_Manager.c). Only the low power noise profile can batch, since EMC
+// conversions are per sensor. Either way, the LTA and negative touch
+// recalibration tests only run every CAPT_RECAL_DECIMATION scans; the max
+// count test, which only reads a flag from the latest conversion, still runs
+// every scan.
+//
+#define CAPT_BATCH_SCAN  (true)
+#define CAPT_RECAL_DECIMATION  (16)
+
+//
+// Without a COMM interface, wake-on-prox can time its scans from the VLO, so
+// that CapTIvate doesn't need ACLK (see CAPT_App.c).
+//
+#if (CAPT_INTERFACE==__CAPT_NO_INTERFACE__)
+#define CAPT_WOP_VLO_LPM4
+#endif
+
+//
+// Noise profiles. CAPT_NOISE_PROFILE_LOW_POWER converts each element at one
+// frequency, with no oversampling. CAPT_NOISE_PROFILE_ROBUST uses the
+// multi-frequency EMC conversions below, which is four conversions per
+// element per scan. CAPT_NOISE_PROFILE_ADAPTIVE builds in both, and starts
+// out on low power: CAPT_updateUI() switches to robust after
+// CAPT_NOISE_ENTER_SCANS scans in a row where some element's count strayed
+// from its filtered count by more than CAPT_NOISE_THRESHOLD, and back after
+// CAPT_NOISE_EXIT_SCANS scans in a row where no sensor reported noise (see
+// CAPT_Manager.c). Debug builds, which are on the bench and talking to the
+// Design Center, are always robust, so that the noise data is there.
+//
+#define CAPT_NOISE_PROFILE_LOW_POWER  (0)
+#define CAPT_NOISE_PROFILE_ROBUST  (1)
+#define CAPT_NOISE_PROFILE_ADAPTIVE  (2)
+#ifdef BADGE_PRODUCTION
+#define CAPT_NOISE_PROFILE  (CAPT_NOISE_PROFILE_ADAPTIVE)
+#else
+#define CAPT_NOISE_PROFILE  (CAPT_NOISE_PROFILE_ROBUST)
+#endif
+#define CAPT_NOISE_ENTER_SCANS  (4)
+#define CAPT_NOISE_EXIT_SCANS  (128)
 
 //
 // Compile-Time Noise Immunity Configuration Definitions
 //
+#if (CAPT_NOISE_PROFILE==CAPT_NOISE_PROFILE_LOW_POWER)
 #define CAPT_CONDUCTED_NOISE_IMMUNITY_ENABLE  (false)
+#else
+#define CAPT_CONDUCTED_NOISE_IMMUNITY_ENABLE  (true)
+#endif
 #define CAPT_SELF_MODE_CONVERSION_STYLE  (eMultiFrequency)
 #define CAPT_PROJ_MODE_CONVERSION_STYLE  (eMultiFrequencyWithOutlierRemoval)
 #define CAPT_SELF_MODE_OVERSAMPLING_STYLE  (eNoOversampling)
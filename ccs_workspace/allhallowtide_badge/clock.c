@@ -0,0 +1,83 @@
+/// MCLK/SMCLK profile switcher.
+/**
+ ** `init_clocks()` locks the DCO at `MCLK_FREQ_MHZ`, and it stays there. What
+ ** changes between profiles is only the MCLK divider, which SMCLK is also
+ ** sourced from. That way a switch takes effect on the next cycle, with no
+ ** FLL relock and no retrim, and the DCO is off in every sleep either way.
+ **
+ ** Most of what the CPU does when it wakes is short: counting a second,
+ ** servicing a CapTIvate scan, draining an IR frame. That runs fine at
+ ** 1 MHz. Walking keyframes and pushing a frame to the LED controller every
+ ** tick is the one job that wants the full clock, so we burst while an
+ ** animation is running.
+ **
+ ** The SPI and UART bit clocks are divided down from SMCLK, so they're
+ ** recomputed on every switch. Everything on ACLK (the RTC, the CapTIvate
+ ** timer, and the watchdog) doesn't care, and neither does the CapTIvate
+ ** conversion clock, nor the ADC, which runs from MODCLK.
+ **
+ ** \file clock.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "clock.h"
+#include "ht16d35a.h"
+#include "ir.h"
+#include "leds.h"
+#include "power.h"
+
+/// The current `CLOCK_PROFILE_*`. `init_clocks()` leaves us in burst.
+uint8_t clock_profile = CLOCK_PROFILE_BURST;
+
+/// Returns the current MCLK (and SMCLK) rate in MHz.
+uint8_t clock_mhz() {
+    return clock_profile == CLOCK_PROFILE_BURST ? MCLK_FREQ_MHZ : CLOCK_IDLE_MHZ;
+}
+
+/// Switch to `profile`, and retune the serial peripherals to match.
+/**
+ ** Nothing may be using SMCLK's rate when this is called: no SPI or UART
+ ** transfer in flight, and the IR window closed. `clock_update()` checks
+ ** that for us.
+ */
+void clock_set_profile(uint8_t profile) {
+    clock_profile = profile;
+
+    if (profile == CLOCK_PROFILE_BURST) {
+        CSCTL5 = (CSCTL5 & ~DIVM) | DIVM__1;
+    } else {
+        CSCTL5 = (CSCTL5 & ~DIVM) | DIVM__8;
+    }
+
+    ht16d_set_smclk_mhz(clock_mhz());
+    ir_set_smclk_mhz(clock_mhz());
+}
+
+/// Pick the clock profile for whatever's going on, and switch if we can.
+/**
+ ** The main loop calls this just before it sleeps. If a driver needs SMCLK
+ ** right then, its bit clock depends on SMCLK's rate staying put, so the
+ ** switch waits for a later sleep.
+ */
+void clock_update() {
+#if CLOCK_SWITCHING
+    uint8_t profile = leds_is_animating() ? CLOCK_PROFILE_BURST : CLOCK_PROFILE_IDLE;
+
+    if (profile == clock_profile) {
+        return;
+    }
+
+    if (power_lpm_bits() == LPM0_bits) {
+        return;
+    }
+
+    clock_set_profile(profile);
+#endif
+}
@@ -0,0 +1,39 @@
+/// Header for the MCLK/SMCLK profile switcher.
+/**
+ ** \file clock.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef CLOCK_H_
+#define CLOCK_H_
+
+#include <stdint.h>
+
+#include "captivate.h"
+
+/// True if this build switches clock profiles at runtime.
+/**
+ ** The CapTIvate Design Center UART interface's baud rate is fixed by the
+ ** library for an 8 MHz SMCLK, so builds that have it stay in the burst
+ ** profile the whole time.
+ */
+#define CLOCK_SWITCHING (CAPT_INTERFACE != __CAPT_UART_INTERFACE__)
+
+/// Profile for everything but animating: MCLK and SMCLK at 1 MHz.
+#define CLOCK_PROFILE_IDLE  0
+/// Profile for animating: MCLK and SMCLK at the full `MCLK_FREQ_MHZ`.
+#define CLOCK_PROFILE_BURST 1
+
+/// MCLK and SMCLK rate in MHz in `CLOCK_PROFILE_IDLE`.
+#define CLOCK_IDLE_MHZ 1
+
+/// The current `CLOCK_PROFILE_*`.
+extern uint8_t clock_profile;
+
+uint8_t clock_mhz();
+void clock_set_profile(uint8_t profile);
+void clock_update();
+
+#endif /* CLOCK_H_ */
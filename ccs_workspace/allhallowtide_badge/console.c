@@ -0,0 +1,433 @@
+/// Serial test and debug console, sharing the CapTIvate UART interface.
+/**
+ ** The production test station (or anyone at a terminal with a script)
+ ** talks to the console in frames, framed the same way as IR frames, but
+ ** with their own sync byte:
+ **
+ ** Byte   | Console frame
+ ** :---   | :------------
+ ** 0      | `CONSOLE_SYNC_BYTE`
+ ** 1      | payload length, 1 to `CONSOLE_PAYLOAD_MAX`
+ ** 2-     | payload
+ ** last 2 | CRC-16 of the length and payload, MSB first
+ **
+ ** A request's payload is any number of commands back to back, each a
+ ** `CONSOLE_CMD_*` byte and its arguments, and the response carries each
+ ** one's `CONSOLE_OK` or `CONSOLE_ERR_*` result byte, and whatever it
+ ** returns, in the same order. So a station can provision and check a
+ ** badge in one round trip, rather than one per command. The first
+ ** command that fails is the last one run, since after an unknown command
+ ** there's no telling where the next one starts. Multi-byte values are
+ ** little endian.
+ **
+ ** The CapTIvate interface's receive handler hands us every byte it gets,
+ ** and the Design Center's own packets just don't frame. Like
+ ** `CAPT_checkForInboundPacket()`, the ISR only queues the bytes, and the
+ ** main loop parses them a byte at a time, as they come. Responses go out
+ ** through the UART's transmit queue, alongside the telemetry.
+ **
+ ** \file console.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
+
+#include "captivate.h"
+
+#include "badge.h"
+#include "leds.h"
+#include "power.h"
+#include "prof.h"
+#include "rtc.h"
+#include "selftest.h"
+#include "sync.h"
+#include "temp.h"
+
+#include "console.h"
+
+#if CONSOLE_ENABLE
+
+#include "UART.h"
+
+/// Receive framing state: waiting for `CONSOLE_SYNC_BYTE`.
+#define CONSOLE_RX_STATE_SYNC 0
+/// Receive framing state: waiting for the length byte.
+#define CONSOLE_RX_STATE_LEN 1
+/// Receive framing state: receiving the payload and CRC.
+#define CONSOLE_RX_STATE_DATA 2
+
+/// Bytes from the UART, waiting for the main loop.
+uint8_t console_ring[CONSOLE_RING_LEN];
+/// Index in `console_ring` that the ISR writes next.
+volatile uint8_t console_ring_head = 0;
+/// Index in `console_ring` that the main loop reads next.
+volatile uint8_t console_ring_tail = 0;
+/// Bytes dropped because `console_ring` was full.
+uint16_t console_overflows = 0;
+
+/// One of `CONSOLE_RX_STATE_*`.
+uint8_t console_rx_state = CONSOLE_RX_STATE_SYNC;
+/// Payload length of the request being received.
+uint8_t console_rx_len;
+/// Bytes of the request's payload and CRC received so far.
+uint8_t console_rx_count;
+/// The request being received: its payload, then its CRC.
+uint8_t console_rx_frame[CONSOLE_PAYLOAD_MAX + 2];
+/// The last response frame, which stays put until the UART has sent it.
+uint8_t console_tx_frame[CONSOLE_PAYLOAD_MAX + CONSOLE_FRAME_OVERHEAD];
+
+/// Size of each `CONSOLE_CONF_*` field, by field.
+const uint8_t console_conf_sizes[CONSOLE_CONF_COUNT] = {
+    sizeof(badge_conf.clock),
+    sizeof(badge_conf.clock_authority),
+    sizeof(badge_conf.unlocked),
+    sizeof(badge_conf.rtc_trim_ppm),
+    sizeof(badge_conf.seen),
+    sizeof(badge_conf.selftest_pending),
+    sizeof(badge_conf.brightness),
+};
+
+/// Compute the CRC-16 of a frame's length byte and payload. Main loop only.
+static uint16_t console_crc16(uint8_t len, const uint8_t *payload) {
+    CRCINIRES = 0xFFFF;
+    CRCDI_L = len;
+    for (uint8_t i=0; i<len; i++) {
+        CRCDI_L = payload[i];
+    }
+    return CRCINIRES;
+}
+
+/// Get ready for requests.
+/**
+ ** UCA0 runs from SMCLK, so the console keeps it on through sleep, or the
+ ** UART would miss requests. Builds with the console are for the bench
+ ** and the test station, where that's fine.
+ */
+void console_init() {
+    power_need(POWER_CLIENT_CONSOLE, POWER_CLOCK_SMCLK);
+}
+
+/// Queue a byte from the UART for the main loop. ISR only.
+void console_rx_byte(uint8_t byte) {
+    uint8_t next = (console_ring_head + 1) & (CONSOLE_RING_LEN - 1);
+
+    if (next == console_ring_tail) {
+        console_overflows++;
+        return;
+    }
+
+    console_ring[console_ring_head] = byte;
+    console_ring_head = next;
+    badge_events |= EV_CONSOLE;
+}
+
+/// Returns true if there are bytes to parse, and room to respond to them.
+/**
+ ** While the last response is still going out, the bytes wait in the
+ ** ring; this becomes true again once it's gone.
+ */
+uint8_t console_pending() {
+    return console_ring_tail != console_ring_head &&
+            !UART_isBufferQueued(console_tx_frame);
+}
+
+/// Write the value of config field `field` to `out`.
+static void console_conf_get(uint8_t field, uint8_t *out) {
+    uint16_t gie = __get_SR_register() & GIE;
+    uint32_t clock;
+
+    switch (field) {
+    case CONSOLE_CONF_CLOCK:
+        // The RTC ISR counts the seconds, so hold it off for all 4 bytes.
+        __bic_SR_register(GIE);
+        clock = rtc_seconds;
+        __bis_SR_register(gie);
+        memcpy(out, &clock, sizeof(clock));
+        break;
+    case CONSOLE_CONF_AUTHORITY:
+        *out = badge_conf.clock_authority;
+        break;
+    case CONSOLE_CONF_UNLOCKED:
+        memcpy(out, &badge_conf.unlocked, sizeof(badge_conf.unlocked));
+        break;
+    case CONSOLE_CONF_TRIM:
+        memcpy(out, &badge_conf.rtc_trim_ppm, sizeof(badge_conf.rtc_trim_ppm));
+        break;
+    case CONSOLE_CONF_SEEN:
+        memcpy(out, badge_conf.seen, sizeof(badge_conf.seen));
+        break;
+    case CONSOLE_CONF_SELFTEST:
+        *out = badge_conf.selftest_pending;
+        break;
+    case CONSOLE_CONF_BRIGHTNESS:
+        *out = badge_conf.brightness;
+        break;
+    }
+}
+
+/// Set config field `field` from `in`, and do whatever goes with that.
+static void console_conf_set(uint8_t field, const uint8_t *in) {
+    uint32_t clock;
+    int16_t trim;
+
+    switch (field) {
+    case CONSOLE_CONF_CLOCK:
+        memcpy(&clock, in, sizeof(clock));
+        badge_set_time(clock);
+        return;
+    case CONSOLE_CONF_AUTHORITY:
+        badge_set_authority(*in);
+        return;
+    case CONSOLE_CONF_UNLOCKED:
+        memcpy(&badge_conf.unlocked, in, sizeof(badge_conf.unlocked));
+        break;
+    case CONSOLE_CONF_TRIM:
+        memcpy(&trim, in, sizeof(trim));
+        // Store what the RTC will actually use, as sync.c does.
+        if (trim > RTC_TRIM_MAX_PPM) {
+            trim = RTC_TRIM_MAX_PPM;
+        } else if (trim < -RTC_TRIM_MAX_PPM) {
+            trim = -RTC_TRIM_MAX_PPM;
+        }
+        badge_conf.rtc_trim_ppm = trim;
+        rtc_set_trim(trim);
+        break;
+    case CONSOLE_CONF_SEEN:
+        memcpy(badge_conf.seen, in, sizeof(badge_conf.seen));
+        break;
+    case CONSOLE_CONF_SELFTEST:
+        badge_conf.selftest_pending = *in;
+        break;
+    case CONSOLE_CONF_BRIGHTNESS:
+        leds_set_brightness_level(*in);
+        return;
+    }
+
+    badge_conf_changed();
+    sync_refresh();
+}
+
+/// Run the commands in `req`, writing their results to `resp`.
+/**
+ ** Returns the length of the response payload.
+ */
+static uint8_t console_run(const uint8_t *req, uint8_t req_len, uint8_t *resp) {
+    uint8_t in = 0;
+    uint8_t out = 0;
+    uint8_t cmd;
+    uint8_t args;   // Argument bytes the command takes.
+    uint8_t ret;    // Bytes the command returns, after its result byte.
+    uint8_t status;
+    int16_t degf;
+#if PROF_ENABLE
+    prof_stats_t *stats;
+    uint16_t word;
+#endif
+
+    while (in < req_len) {
+        cmd = req[in++];
+
+        // Work out the command's size first, so that nothing's half done
+        //  when the request or the response runs out.
+        switch (cmd) {
+        case CONSOLE_CMD_VERSION:
+            args = 0;
+            ret = 3;
+            break;
+        case CONSOLE_CMD_CONF_GET:
+        case CONSOLE_CMD_CONF_SET:
+            if (in >= req_len || req[in] >= CONSOLE_CONF_COUNT) {
+                resp[out++] = CONSOLE_ERR_ARG;
+                return out;
+            }
+            args = 1;
+            ret = 0;
+            if (cmd == CONSOLE_CMD_CONF_GET) {
+                ret = console_conf_sizes[req[in]];
+            } else {
+                args += console_conf_sizes[req[in]];
+            }
+            break;
+        case CONSOLE_CMD_PROF:
+            args = 1;
+            ret = 10;
+            break;
+        case CONSOLE_CMD_ANIM:
+            args = 1;
+            ret = 0;
+            break;
+        case CONSOLE_CMD_TEMP:
+            args = 0;
+            ret = 4;
+            break;
+        case CONSOLE_CMD_COMMIT:
+            args = 0;
+            ret = 0;
+            break;
+        case CONSOLE_CMD_SELFTEST:
+            args = 0;
+            ret = sizeof(selftest_report);
+            break;
+        default:
+            resp[out++] = CONSOLE_ERR_CMD;
+            return out;
+        }
+
+        if (args > req_len - in) {
+            resp[out++] = CONSOLE_ERR_ARG;
+            return out;
+        }
+        // This leaves room for one more result byte, so that whatever
+        //  stops the batch after this command can still say why.
+        if (1 + ret > CONSOLE_PAYLOAD_MAX - 1 - out) {
+            resp[out++] = CONSOLE_ERR_FULL;
+            return out;
+        }
+
+        status = CONSOLE_OK;
+        switch (cmd) {
+        case CONSOLE_CMD_VERSION:
+            resp[out + 1] = BADGE_FW_VERSION & 0xff;
+            resp[out + 2] = BADGE_FW_VERSION >> 8;
+            resp[out + 3] = sync_id;
+            break;
+        case CONSOLE_CMD_CONF_GET:
+            console_conf_get(req[in], &resp[out + 1]);
+            break;
+        case CONSOLE_CMD_CONF_SET:
+            console_conf_set(req[in], &req[in + 1]);
+            break;
+        case CONSOLE_CMD_PROF:
+#if PROF_ENABLE
+            if (req[in] >= PROF_REGION_COUNT) {
+                status = CONSOLE_ERR_ARG;
+                break;
+            }
+            stats = &prof_stats[req[in]];
+            word = stats->count ? stats->min : 0;
+            memcpy(&resp[out + 1], &word, 2);
+            memcpy(&resp[out + 3], &stats->max, 2);
+            word = stats->count ? stats->total / stats->count : 0;
+            memcpy(&resp[out + 5], &word, 2);
+            memcpy(&resp[out + 7], &stats->count, 2);
+            memcpy(&resp[out + 9], &stats->overruns, 2);
+#else
+            status = CONSOLE_ERR_ABSENT;
+#endif
+            break;
+        case CONSOLE_CMD_ANIM:
+            if (req[in] >= BADGE_ANIM_COUNT) {
+                status = CONSOLE_ERR_ARG;
+                break;
+            }
+            badge_anim_play(req[in]);
+            break;
+        case CONSOLE_CMD_TEMP:
+            degf = temp_degf();
+            memcpy(&resp[out + 1], &degf, 2);
+            memcpy(&resp[out + 3], (const void *) &temp_code, 2);
+            break;
+        case CONSOLE_CMD_COMMIT:
+            badge_conf_commit();
+            break;
+        case CONSOLE_CMD_SELFTEST:
+            memcpy(&resp[out + 1], &selftest_report, sizeof(selftest_report));
+            break;
+        }
+
+        resp[out++] = status;
+        if (status != CONSOLE_OK) {
+            return out;
+        }
+        out += ret;
+        in += args;
+    }
+
+    return out;
+}
+
+/// Check a complete request frame, and queue the response to it.
+static void console_handle_frame() {
+    uint16_t crc = console_crc16(console_rx_len, console_rx_frame);
+    uint8_t len;
+
+    if (console_rx_frame[console_rx_len] != (crc >> 8) ||
+            console_rx_frame[console_rx_len + 1] != (crc & 0xff)) {
+        return;
+    }
+
+    len = console_run(console_rx_frame, console_rx_len, &console_tx_frame[2]);
+    crc = console_crc16(len, &console_tx_frame[2]);
+    console_tx_frame[0] = CONSOLE_SYNC_BYTE;
+    console_tx_frame[1] = len;
+    console_tx_frame[2 + len] = crc >> 8;
+    console_tx_frame[3 + len] = crc & 0xff;
+    UART_transmitBuffer(console_tx_frame, len + CONSOLE_FRAME_OVERHEAD);
+}
+
+/// Parse whatever's arrived, and answer any request it completes.
+/**
+ ** Call this from the main loop when `EV_CONSOLE` is posted, or when
+ ** `console_pending()`. It stops after one request, if the response to
+ ** that one is still going out.
+ */
+void console_handle_rx() {
+    uint8_t byte;
+
+    while (console_ring_tail != console_ring_head) {
+        if (UART_isBufferQueued(console_tx_frame)) {
+            return;
+        }
+
+        byte = console_ring[console_ring_tail];
+        console_ring_tail = (console_ring_tail + 1) & (CONSOLE_RING_LEN - 1);
+
+        switch (console_rx_state) {
+        case CONSOLE_RX_STATE_SYNC:
+            if (byte == CONSOLE_SYNC_BYTE) {
+                console_rx_state = CONSOLE_RX_STATE_LEN;
+            }
+            break;
+        case CONSOLE_RX_STATE_LEN:
+            if (!byte || byte > CONSOLE_PAYLOAD_MAX) {
+                console_rx_state = CONSOLE_RX_STATE_SYNC;
+                break;
+            }
+            console_rx_len = byte;
+            console_rx_count = 0;
+            console_rx_state = CONSOLE_RX_STATE_DATA;
+            break;
+        case CONSOLE_RX_STATE_DATA:
+            console_rx_frame[console_rx_count++] = byte;
+            if (console_rx_count == console_rx_len + 2) {
+                console_rx_state = CONSOLE_RX_STATE_SYNC;
+                console_handle_frame();
+            }
+            break;
+        }
+    }
+}
+
+#else
+
+// The IR link has UCA0, so there's no console in this build.
+
+void console_init() {
+}
+
+void console_rx_byte(uint8_t byte) {
+}
+
+uint8_t console_pending() {
+    return 0;
+}
+
+void console_handle_rx() {
+}
+
+#endif
@@ -0,0 +1,97 @@
+/// Header for the serial test and debug console.
+/**
+ ** \file console.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+
+#include "captivate.h"
+
+/// True if this build has the console.
+/**
+ ** The console shares UCA0 with the CapTIvate Design Center UART interface,
+ ** so it's in the same builds that one is, and not in the ones with IR.
+ */
+#define CONSOLE_ENABLE (CAPT_INTERFACE == __CAPT_UART_INTERFACE__)
+
+/// First byte of every console frame.
+#define CONSOLE_SYNC_BYTE 0xC5
+/// The largest payload a request or response frame can carry.
+#define CONSOLE_PAYLOAD_MAX 64
+/// Bytes that framing adds to a payload: sync, length, and CRC-16.
+#define CONSOLE_FRAME_OVERHEAD 4
+/// Bytes of receive buffer between the UART ISR and the main loop.
+/**
+ ** This must be a power of 2, up to 256 for the 8-bit indices. It holds a
+ ** full request frame, and most of another, since one can arrive while the
+ ** response to the last is still going out.
+ */
+#define CONSOLE_RING_LEN 128
+
+#if (CONSOLE_RING_LEN & (CONSOLE_RING_LEN - 1)) || CONSOLE_RING_LEN > 256
+#error "CONSOLE_RING_LEN must be a power of 2, and at most 256"
+#endif
+#if CONSOLE_RING_LEN < CONSOLE_PAYLOAD_MAX + CONSOLE_FRAME_OVERHEAD
+#error "CONSOLE_RING_LEN must hold a whole request frame"
+#endif
+#if CONSOLE_PAYLOAD_MAX > 255
+#error "CONSOLE_PAYLOAD_MAX must fit in the frame's length byte"
+#endif
+
+/// Command: no arguments. Responds with the firmware version and our ID.
+#define CONSOLE_CMD_VERSION     0x01
+/// Command: a `CONSOLE_CONF_*` field. Responds with the field's value.
+#define CONSOLE_CMD_CONF_GET    0x02
+/// Command: a `CONSOLE_CONF_*` field, and its new value.
+#define CONSOLE_CMD_CONF_SET    0x03
+/// Command: a region ID. Responds with its min, max, mean, count, overruns.
+#define CONSOLE_CMD_PROF        0x04
+/// Command: a `BADGE_ANIM_*` ID to play, as though a button asked for it.
+#define CONSOLE_CMD_ANIM        0x05
+/// Command: no arguments. Responds with degrees F, and the raw ADC code.
+#define CONSOLE_CMD_TEMP        0x06
+/// Command: no arguments. Commits the config to FRAM now.
+#define CONSOLE_CMD_COMMIT      0x07
+/// Command: no arguments. Responds with the `selftest_report_t`.
+#define CONSOLE_CMD_SELFTEST    0x08
+
+/// Config field: the clock, in seconds, 4 bytes. Setting it keeps authority.
+#define CONSOLE_CONF_CLOCK      0
+/// Config field: the clock's authority, 1 byte.
+#define CONSOLE_CONF_AUTHORITY  1
+/// Config field: the bitmask of unlocked animations, 2 bytes.
+#define CONSOLE_CONF_UNLOCKED   2
+/// Config field: the RTC's trim, in ppm, 2 bytes, up to `RTC_TRIM_MAX_PPM`.
+#define CONSOLE_CONF_TRIM       3
+/// Config field: the seen badge bitmap, 16 bytes.
+#define CONSOLE_CONF_SEEN       4
+/// Config field: nonzero to run the self-test on the next boot, 1 byte.
+#define CONSOLE_CONF_SELFTEST   5
+/// Config field: the LED brightness level, 1 byte, below `LEDS_BRIGHTNESS_LEVELS`.
+#define CONSOLE_CONF_BRIGHTNESS 6
+/// The number of config fields.
+#define CONSOLE_CONF_COUNT      7
+
+/// Result: the command did what it was asked.
+#define CONSOLE_OK              0x00
+/// Result: unknown command. Nothing after it in the request is run.
+#define CONSOLE_ERR_CMD         0x01
+/// Result: an argument was out of range, or missing; nothing after it runs.
+#define CONSOLE_ERR_ARG         0x02
+/// Result: the response frame had no room; nothing after it runs.
+#define CONSOLE_ERR_FULL        0x03
+/// Result: this build doesn't have what the command needs.
+#define CONSOLE_ERR_ABSENT      0x04
+
+void console_init();
+void console_rx_byte(uint8_t byte);
+uint8_t console_pending();
+void console_handle_rx();
+
+#endif /* CONSOLE_H_ */
@@ -0,0 +1,100 @@
+/// Software deadline timer service.
+/**
+ ** Anything that needs to happen some number of system ticks from now (a
+ ** long press, a double tap window, a debounce, an animation timeout)
+ ** starts a `deadline_t`, and its callback is run from the main loop when
+ ** the time comes. Running deadlines are kept in a singly linked list,
+ ** sorted soonest first, so that checking them is just a look at the head,
+ ** and the tickless scheduler can ask for exactly the ticks until it.
+ **
+ ** Times are in `rtc_ticks`, which wraps every 655 seconds. Comparisons
+ ** are done on the signed difference, so that's fine for any deadline less
+ ** than half that away.
+ **
+ ** \file deadline.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include "rtc.h"
+
+#include "deadline.h"
+
+/// The running deadline that passes soonest, or 0 if there are none.
+deadline_t *deadline_head = 0;
+
+/// Run `deadline` once `ticks` system ticks have passed, restarting it if needed.
+/**
+ ** Its `cb` and `arg` must be set first. This is for the main loop only.
+ */
+void deadline_start(deadline_t *deadline, uint16_t ticks) {
+    deadline_t **link = &deadline_head;
+
+    deadline_stop(deadline);
+    deadline->at = rtc_ticks + ticks;
+
+    // Walk to the first deadline that passes later than this one.
+    while (*link && (int16_t) ((*link)->at - deadline->at) <= 0) {
+        link = &(*link)->next;
+    }
+
+    deadline->next = *link;
+    *link = deadline;
+    deadline->running = 1;
+}
+
+/// Stop `deadline` without running it. Harmless if it's not running.
+void deadline_stop(deadline_t *deadline) {
+    deadline_t **link = &deadline_head;
+
+    if (!deadline->running) {
+        return;
+    }
+
+    while (*link != deadline) {
+        link = &(*link)->next;
+    }
+
+    *link = deadline->next;
+    deadline->running = 0;
+}
+
+/// Returns the number of system ticks until the next deadline passes.
+/**
+ ** This is 0xff, meaning no ticks are needed, if none is running.
+ */
+uint8_t deadline_ticks_needed() {
+    int16_t left;
+
+    if (!deadline_head) {
+        return 0xff;
+    }
+
+    left = (int16_t) (deadline_head->at - rtc_ticks);
+    if (left <= 0) {
+        return 1;
+    }
+    if (left > 0xfe) {
+        return 0xfe;
+    }
+    return left;
+}
+
+/// Run the callback of every deadline that has passed, soonest first.
+/**
+ ** This should be called from the main loop on every `EV_TIME_LOOP`.
+ ** A callback can start or stop deadlines, including its own.
+ */
+void deadline_timestep() {
+    deadline_t *deadline;
+
+    while (deadline_head && (int16_t) (deadline_head->at - rtc_ticks) <= 0) {
+        deadline = deadline_head;
+        deadline_head = deadline->next;
+        deadline->running = 0;
+        deadline->cb(deadline->arg);
+    }
+}
@@ -0,0 +1,40 @@
+/// Header for the software deadline timer service.
+/**
+ ** \file deadline.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef DEADLINE_H_
+#define DEADLINE_H_
+
+#include <stdint.h>
+
+/// Function to call when a deadline passes, with the deadline's `arg`.
+typedef void (*deadline_cb_t)(uint8_t arg);
+
+/// A one-shot software timer.
+/**
+ ** These belong to whoever uses them (usually as a static), and the
+ ** service only links them into its list while they're running.
+ */
+typedef struct deadline {
+    /// The next deadline to pass after this one, while it's running.
+    struct deadline *next;
+    /// `rtc_ticks` value at which this passes.
+    uint16_t at;
+    /// Called from the main loop when this passes.
+    deadline_cb_t cb;
+    /// Passed to `cb`.
+    uint8_t arg;
+    /// True while this is in the list.
+    uint8_t running;
+} deadline_t;
+
+void deadline_start(deadline_t *deadline, uint16_t ticks);
+void deadline_stop(deadline_t *deadline);
+uint8_t deadline_ticks_needed();
+void deadline_timestep();
+
+#endif /* DEADLINE_H_ */
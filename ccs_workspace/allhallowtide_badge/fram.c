@@ -0,0 +1,36 @@
+/// FRAM write helpers.
+/**
+ ** Anything declared `#pragma PERSISTENT` lives in program FRAM, which
+ ** comes out of reset write protected (`PFWP` in `SYSCFG0`), so that a stray
+ ** pointer can't scribble on the code. Writes to it have to go through
+ ** here, which lifts the protection only for as long as the copy takes.
+ **
+ ** \file fram.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
+
+#include "fram.h"
+
+/// Copy `len` bytes from `src` to `dest` in persistent FRAM.
+/**
+ ** Interrupts are held off while it's unprotected, so an ISR can't write
+ ** through a bad pointer meanwhile.
+ */
+void fram_write(void *dest, const void *src, uint16_t len) {
+    uint16_t sr = __get_SR_register() & GIE;
+    uint8_t protect;
+
+    __bic_SR_register(GIE);
+    protect = SYSCFG0_L;
+    SYSCFG0 = FRWPPW | (protect & ~PFWP);
+    memcpy(dest, src, len);
+    SYSCFG0 = FRWPPW | protect;
+    __bis_SR_register(sr);
+}
@@ -0,0 +1,16 @@
+/// Header for FRAM write helpers.
+/**
+ ** \file fram.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef FRAM_H_
+#define FRAM_H_
+
+#include <stdint.h>
+
+void fram_write(void *dest, const void *src, uint16_t len);
+
+#endif /* FRAM_H_ */
@@ -27,6 +27,9 @@
 #include <msp430.h>
 
 #include "badge.h"
+#include "power.h"
+#include "prof.h"
+#include "trace.h"
 
 #include "ht16d35a.h"
 
@@ -37,6 +40,19 @@
 #define HTCMD_READ_DISPLAY  0x81
 /// Read the status register.
 #define HTCMD_READ_STATUS   0x71
+/// Bytes in the status register.
+/**
+ ** It reads out the data bytes of the control commands, from
+ ** `HTCMD_BWGRAY_SEL` through `HTCMD_MODE_CTL`, in command order.
+ */
+#define HT16D_STATUS_LEN    8
+/// Index in the status register of the data byte of control command `cmd`.
+#define HT16D_STATUS_BYTE(cmd) ((cmd) - HTCMD_BWGRAY_SEL)
+/// Bitmask, by index, of the status bytes we set, and so can check.
+/**
+ ** 0x34 isn't a command we use, so its byte is left out.
+ */
+#define HT16D_STATUS_TRACKED 0xF7
 /// Command to toggle between binary and grayscale mode.
 #define HTCMD_BWGRAY_SEL    0x31
 /// Payload for `HTCMD_BWGRAY_SEL` to select binary (black & white) mode.
@@ -53,32 +69,119 @@
 #define HTCMD_I_RATIO       0x36
 /// Set the global brightness (0x40 is max).
 #define HTCMD_GLOBAL_BRTNS  0x37
+/// Enable or disable the fade, blink, UCOM, and masking functions.
 #define HTCMD_MODE_CTL      0x38
+/// `HTCMD_MODE_CTL` bit to run the per-dot fade/blink from the fade RAM.
+#define HTCMD_MODE_CTL_FDEN 0x01
+/// Write the buffer that follows to the per-dot fade RAM.
+#define HTCMD_WRITE_FADE    0x82
+/// Fade RAM bit to select slope (breathing) instead of blinking for a dot.
+#define HTCMD_FADE_FSS      0x20
 #define HTCMD_COM_PIN_CTL   0x41
 #define HTCMD_ROW_PIN_CTL   0x42
 #define HTCMD_DIR_PIN_CTL   0x43
 /// Command to order a software reset of the HT16D35B.
 #define HTCMD_SW_RESET      0xCC
-/// The number of RGB (3-channel) LEDs in the system.
-#define HT16D_LED_COUNT 9
+/// The number of display RAM rows (channels) that our LEDs occupy per column.
+#define HT16D_ROW_COUNT (HT16D_LED_COUNT*3/HT16D_COL_COUNT)
+/// Dirty bitmask value with every LED set.
+#define HT16D_ALL_DIRTY HT16D_ALL_LEDS
+/// Clean rows between two dirty windows that we'll resend rather than split.
+/**
+ ** Starting a new window costs a command byte, an address byte, and a CS
+ ** cycle, so resending up to two unchanged rows is never worse than that.
+ */
+#define HT16D_WINDOW_MERGE_GAP 2
+/// Size of the segment list for the worst-case set of dirty windows.
+/**
+ ** Every window is a length byte, `HTCMD_WRITE_DISPLAY`, an address, and
+ ** its rows. Since windows are always separated by more than
+ ** `HT16D_WINDOW_MERGE_GAP` clean rows, this never exceeds one full window
+ ** per column, plus the terminating zero length.
+ */
+#define HT16D_FRAME_BUF_LEN (HT16D_COL_COUNT*(HT16D_ROW_COUNT + 3) + 1)
+
+#if HT16D_LED_COUNT*3 % HT16D_COL_COUNT
+#error "HT16D_LED_COUNT's channels must divide evenly across HT16D_COL_COUNT"
+#endif
+#if HT16D_ROW_COUNT + 2 > 255
+#error "A whole column's window must fit in a segment's length byte"
+#endif
 
-/// 8-bit values for the RGB LEDs.
+/// Gamma-corrected 6-bit grayscale codes for the RGB LEDs.
 /**
- ** This is a HT16D_LED_COUNT-element array of 3-tuples of RGB color (1 byte /
- ** 8 bits per channel). Note that, in this array, all 8 bits are "significant";
- ** the right-shifting by two is done in `led_send_gray()`, to send 6-bit data
- ** to the LED controller, because it only has 6 bits of grayscale.
+ ** This is a HT16D_LED_COUNT-element array of 3-tuples of RGB color (1 byte
+ ** per channel). The values here are already gamma and balance corrected
+ ** through `ht16d_gamma`, and are in the LED controller's native 6-bit
+ ** grayscale range, so they can be sent as-is.
  **
+ ** Nothing reads this while a frame is on the wire; it's only copied out, into
+ ** a segment list, when a frame is committed with `ht16d_send_gray()`. So it's
+ ** safe to start drawing the next frame here at any time.
  */
 uint8_t ht16d_gs_values[HT16D_LED_COUNT][3] = {0,};
 
+/// Gamma and balance correction from 8-bit channel values to 6-bit codes.
+extern const uint8_t ht16d_gamma[3][256];
+
+/// Bitmask of LEDs whose `ht16d_gs_values` haven't been sent yet.
+static ht16d_mask_t ht16d_dirty = HT16D_ALL_DIRTY;
+/// Bitmask of LEDs with at least one channel that isn't off.
+static ht16d_mask_t ht16d_lit = 0;
+
+/// Currently enabled `HTCMD_MODE_CTL` bits.
+static uint8_t ht16d_mode = 0x00;
+/// What the status register should read back, from what we've sent it.
+static uint8_t ht16d_settings[HT16D_STATUS_LEN];
+/// The arguments of the last `ht16d_hw_fade()`, to restore after a reset.
+static ht16d_mask_t ht16d_fade_mask;
+static uint8_t ht16d_fade_slope;
+static uint8_t ht16d_fade_cycle;
+static uint8_t ht16d_fade_stagger;
+
+ht16d_stats_t ht16d_stats = {0,};
+
 /// Correlate our LED_ID,COLOR to COL,ROW.
 /**
- ** Note that the HT16D35B does include a feature to handle this mapping for us
- ** onboard the chip. We are currently not using it, but there's not really
- ** any reason that we couldn't.
+ ** Each `ROW(led, rgb)` is one display RAM row, in column, then row, order:
+ ** the LED it drives, and which of that LED's channels. The mapping is
+ ** written out once, here, and expanded at build time into the flat tables
+ ** below, so that everything the drawing code needs to know about a row is
+ ** a single indexed load. (The MSP430 shifts one bit per instruction, and
+ ** multiplies in a peripheral, so an LED's mask bit or a channel's offset
+ ** is bought dearly at runtime.)
+ **
+ ** The HT16D35B's UCOM and USEG functions only force whole COM or ROW lines
+ ** on, so they can't stand in for this table. It's the hardware fade and
+ ** blink (see `ht16d_hw_fade()`) that let idle effects run without us
+ ** walking it every frame.
  */
-const uint8_t ht16d_col_mapping[1][HT16D_LED_COUNT*3][2] = {{{0, 2}, {0, 1}, {0, 0}, {1, 2}, {1, 1}, {1, 0}, {2, 2}, {2, 1}, {2, 0}, {3, 2}, {3, 1}, {3, 0}, {4, 2}, {4, 1}, {4, 0}, {5, 2}, {5, 1}, {5, 0}, {6, 2}, {6, 1}, {6, 0}, {7, 2}, {7, 1}, {7, 0}, {8, 2}, {8, 1}, {8, 0}}};
+#define HT16D_MAPPING(ROW) \
+    ROW(0, 2) ROW(0, 1) ROW(0, 0) ROW(1, 2) ROW(1, 1) ROW(1, 0) \
+    ROW(2, 2) ROW(2, 1) ROW(2, 0) ROW(3, 2) ROW(3, 1) ROW(3, 0) \
+    ROW(4, 2) ROW(4, 1) ROW(4, 0) ROW(5, 2) ROW(5, 1) ROW(5, 0) \
+    ROW(6, 2) ROW(6, 1) ROW(6, 0) ROW(7, 2) ROW(7, 1) ROW(7, 0) \
+    ROW(8, 2) ROW(8, 1) ROW(8, 0)
+
+/// `HT16D_MAPPING` row expansion: the row's LED.
+#define HT16D_ROW_LED(led, rgb) (led),
+/// `HT16D_MAPPING` row expansion: the row's LED's bit in a `ht16d_mask_t`.
+#define HT16D_ROW_MASK(led, rgb) ((ht16d_mask_t) 1 << (led)),
+/// `HT16D_MAPPING` row expansion: the row's byte offset in `ht16d_gs_values`.
+#define HT16D_ROW_OFFSET(led, rgb) ((led)*3 + (rgb)),
+
+/// Index of row `row` of column `col` in the `ht16d_row_*` tables.
+#define HT16D_ROW_INDEX(col, row) ((col)*HT16D_ROW_COUNT + (row))
+
+/// The LED on each display RAM row, by `HT16D_ROW_INDEX()`.
+const uint8_t ht16d_row_leds[] = {HT16D_MAPPING(HT16D_ROW_LED)};
+/// The dirty bit of the LED on each display RAM row, by `HT16D_ROW_INDEX()`.
+const ht16d_mask_t ht16d_row_masks[] = {HT16D_MAPPING(HT16D_ROW_MASK)};
+/// Each display RAM row's byte offset in `ht16d_gs_values`, by `HT16D_ROW_INDEX()`.
+const uint8_t ht16d_row_offsets[] = {HT16D_MAPPING(HT16D_ROW_OFFSET)};
+
+/// Fails to compile unless `HT16D_MAPPING` has exactly one entry per row.
+typedef char ht16d_mapping_size_check[sizeof(ht16d_row_leds) == HT16D_COL_COUNT*HT16D_ROW_COUNT ? 1 : -1];
 
 /// Initialize GPIO and SPI peripheral.
 void ht16d_init_peripheral() {
@@ -97,24 +200,119 @@ void ht16d_init_peripheral() {
     UCB0CTLW0 &= ~UCSWRST; // enable it.
 }
 
-/// Transmit a `len` byte array `txdat` to the HT16D35B.
-void ht16d_send_array(uint8_t txdat[], uint8_t len) {
-    // TODO: Convert to SPI
+/// Retune the SPI clock for a new SMCLK rate, keeping it at 2 MHz or under.
+/**
+ ** This must only be called between transfers. Holding the eUSCI in reset
+ ** clears its interrupt enables, which is the state it's in there anyway.
+ */
+void ht16d_set_smclk_mhz(uint8_t smclk_mhz) {
+    UCB0CTLW0 |= UCSWRST;
+    UCB0BRW = smclk_mhz > 2 ? smclk_mhz / 2 : 1;
+    UCB0CTLW0 &= ~UCSWRST;
+}
+
+/// Pointer to the next byte to clock out to the HT16D35B.
+static volatile const uint8_t *ht16d_tx_ptr;
+/// Number of bytes remaining after the one currently on the wire.
+static volatile uint8_t ht16d_tx_len = 0;
+/// Length byte of the next segment to send after this one, or 0 if none.
+static volatile const uint8_t *ht16d_tx_next;
+/// True from the time CS drops until the last byte has fully shifted out.
+static volatile uint8_t ht16d_tx_busy = 0;
+/// Where the next byte read back goes, or 0 if this transfer is a write.
+static volatile uint8_t *ht16d_rx_ptr = 0;
+/// Bytes still to read back.
+static volatile uint8_t ht16d_rx_len = 0;
+/// Bytes still to send before what comes back is worth keeping.
+static volatile uint8_t ht16d_rx_skip = 0;
+/// Front and back segment lists for the display writes in `ht16d_send_gray()`.
+/**
+ ** Each is a sequence of CS-framed transactions, each preceded by its
+ ** length, and terminated by a zero length. Like `CAPT_PingPongBuffer`, one
+ ** is for editing (the next frame is built into it) and one is for
+ ** transmitting (the ISR is reading it), and a commit just swaps them.
+ */
+static uint8_t ht16d_frame_bufs[2][HT16D_FRAME_BUF_LEN];
+/// The segment list that the next `ht16d_send_gray()` will build.
+static uint8_t *ht16d_frame_edit = ht16d_frame_bufs[0];
+/// The segment list that's on the wire, or that was most recently.
+static uint8_t *ht16d_frame_transmit = ht16d_frame_bufs[1];
+
+/// Returns true if a transfer to the HT16D35B is still in progress.
+uint8_t ht16d_busy() {
+    return ht16d_tx_busy;
+}
+
+/// Wait, asleep, for any in-flight transfer to the LED controller to finish.
+/**
+ ** Interrupts are left as the caller had them, though they're on while
+ ** it sleeps.
+ */
+void ht16d_wait_idle() {
+    uint16_t gie = __get_SR_register() & GIE;
+
+    while (1) {
+        __bic_SR_register(GIE);
+        if (!ht16d_tx_busy) {
+            break;
+        }
+        power_sleep();
+    }
+    __bis_SR_register(gie);
+}
+
+/// Drop CS and start clocking out `len` bytes, followed by segments `next`.
+static void ht16d_start_tx(const uint8_t txdat[], uint8_t len, const uint8_t *next) {
+    ht16d_wait_idle();
+
+    ht16d_tx_busy = 1;
+    power_need(POWER_CLIENT_HT16D, POWER_CLOCK_SMCLK);
+    ht16d_tx_ptr = &txdat[1];
+    ht16d_tx_len = len-1;
+    ht16d_tx_next = next;
 
     // CS low
     P1OUT &= ~BIT0;
+    TRACE_SPI_START();
 
-    // Send bits
-    for (uint8_t i=0; i<len; i++) {
-        // Wait for the TX buffer to become available again.
-        while (!(UCB0IFG & UCTXIFG)); // While TX is unavailable, spin.
+    UCB0IFG &= ~UCRXIFG; // Clear any stale RX flag
+    UCB0IE |= UCRXIE;    // so that the next one marks our first byte done.
+    UCB0TXBUF = txdat[0];
+}
 
-        UCB0IFG &= ~UCTXIFG; // Clear TX flag.
-        UCB0TXBUF = txdat[i]; // write dat.
+/// Begin an interrupt-driven transmit of `len` bytes from `txdat`.
+/**
+ ** This returns as soon as the first byte is loaded into the eUSCI. The
+ ** remaining bytes are fed from `EUSCI_B0_ISR`, which is paced off of the
+ ** receive flag so that CS is only released after the final byte has
+ ** completely shifted out. `txdat` must remain valid until the transfer
+ ** completes, at which point `EV_HT16D_TX_DONE` is posted.
+ */
+void ht16d_send_array_async(uint8_t txdat[], uint8_t len) {
+    if (!len) {
+        return;
     }
 
-    // CS high
-    P1OUT |= BIT0;
+    ht16d_start_tx(txdat, len, 0);
+}
+
+/// Begin sending a zero-terminated list of length-prefixed transactions.
+/**
+ ** Each transaction gets its own CS assertion, and they're chained back to
+ ** back from the ISR. The list must remain valid until `EV_HT16D_TX_DONE`.
+ */
+void ht16d_send_segments_async(const uint8_t segments[]) {
+    if (!segments[0]) {
+        return;
+    }
+
+    ht16d_start_tx(&segments[1], segments[0], &segments[1+segments[0]]);
+}
+
+/// Transmit a `len` byte array `txdat` to the HT16D35B, and wait for it.
+void ht16d_send_array(uint8_t txdat[], uint8_t len) {
+    ht16d_send_array_async(txdat, len);
+    ht16d_wait_idle();
 }
 
 /// Transmit a single byte command to the HT16D35B.
@@ -130,6 +328,146 @@ void ht16_d_send_cmd_dat(uint8_t cmd, uint8_t dat) {
     ht16d_send_array(v, 2);
 }
 
+/// Begin an interrupt-driven read: send `txlen` bytes, then read `rxlen`.
+/**
+ ** The command (and the address, if it takes one) in `txdat` go out as
+ ** usual, and then the ISR clocks out a zero for each byte it reads back
+ ** into `rxdat`, all inside one CS assertion. Both must stay valid until
+ ** the transfer completes.
+ **
+ ** P1.3 (UCB0SOMI) is the awake trace pin the rest of the time, so it's
+ ** only lent to the eUSCI for reads, with a pulldown. That way a controller
+ ** that doesn't answer reads as zeroes, or with `TRACE_ENABLE` (which
+ ** leaves P1OUT.3 high, and so the pull up), as ones.
+ */
+static void ht16d_read_async(const uint8_t txdat[], uint8_t txlen, uint8_t rxdat[], uint8_t rxlen) {
+    ht16d_wait_idle();
+
+    P1OUT &= ~BIT3;
+    P1REN |= BIT3;
+    P1SEL0 |= BIT3;
+
+    ht16d_rx_ptr = rxdat;
+    ht16d_rx_len = rxlen;
+    ht16d_rx_skip = txlen;
+    ht16d_start_tx(txdat, txlen, 0);
+}
+
+/// Read `rxlen` bytes after sending `txlen` from `txdat`, and wait for them.
+static void ht16d_read(const uint8_t txdat[], uint8_t txlen, uint8_t rxdat[], uint8_t rxlen) {
+    ht16d_read_async(txdat, txlen, rxdat, rxlen);
+    ht16d_wait_idle();
+}
+
+/// Read the LED controller's status register into `status`, and wait for it.
+static void ht16d_read_status(uint8_t status[HT16D_STATUS_LEN]) {
+    static const uint8_t cmd = HTCMD_READ_STATUS;
+
+    ht16d_read(&cmd, 1, status, HT16D_STATUS_LEN);
+}
+
+/// Returns true if `status` shows the LED controller has lost its setup.
+/**
+ ** This checks the settings that `ht16d_init()` makes once and nothing
+ ** changes after, and that survive standby: the grayscale mode and the
+ ** number of COMs scanned. A controller that's been reset is back to its
+ ** defaults there. An absent one reads as zeroes, and a stuck bus as ones,
+ ** and neither of those is what we set either.
+ */
+static uint8_t ht16d_status_lost(const uint8_t status[HT16D_STATUS_LEN]) {
+    return status[HT16D_STATUS_BYTE(HTCMD_BWGRAY_SEL)] != HTCMD_BWGRAY_SEL_GRAYSCALE
+            || status[HT16D_STATUS_BYTE(HTCMD_COM_NUM)] != HT16D_SCAN_COUNT - 1;
+}
+
+/// Returns true if the LED controller answers, with the setup we gave it.
+uint8_t ht16d_responding() {
+    uint8_t status[HT16D_STATUS_LEN];
+
+    ht16d_read_status(status);
+
+    return !ht16d_status_lost(status);
+}
+
+/// Send control command `cmd` with data byte `dat`, and remember we did.
+/**
+ ** Every control command that the status register reads back goes through
+ ** here, so that `ht16d_health_check()` knows what it should read.
+ */
+static void ht16d_send_setting(uint8_t cmd, uint8_t dat) {
+    ht16d_settings[HT16D_STATUS_BYTE(cmd)] = dat;
+    ht16_d_send_cmd_dat(cmd, dat);
+}
+
+/// Command script to reset the HT16D35B.
+/**
+ ** This, like the other scripts below, is a const segment list for
+ ** `ht16d_send_segments_async()`, so that the whole sequence goes out as one
+ ** interrupt-driven transfer from FRAM, with only a CS toggle between
+ ** commands.
+ */
+static const uint8_t ht16d_reset_script[] = {
+    // SW Reset (HTCMD_SW_RESET)
+    1, HTCMD_SW_RESET,
+    0
+};
+
+/// Command script to set the HT16D35B up from reset, with the display off.
+/**
+ ** The display is left off until its RAM has been written. This is also
+ ** what `ht16d_health_check()` sends to a controller that's lost its setup.
+ */
+static const uint8_t ht16d_setup_script[] = {
+    // Set global brightness
+    2, HTCMD_GLOBAL_BRTNS, HT16D_BRIGHTNESS_DEFAULT,
+    // Set BW/Binary display mode.
+    2, HTCMD_BWGRAY_SEL, HTCMD_BWGRAY_SEL_GRAYSCALE,
+    // Set column pin control for in-use cols (HTCMD_COM_PIN_CTL)
+    2, HTCMD_COM_PIN_CTL, (1 << HT16D_COL_COUNT) - 1,
+    // Set constant current ratio (HTCMD_I_RATIO)
+    2, HTCMD_I_RATIO, HT16D_I_RATIO_DEFAULT, // 0b000 (max) is :fire: :fire:
+    // Set the number of columns to scan, and HIGH SCAN mode (HTCMD_COM_NUM)
+    2, HTCMD_COM_NUM, HT16D_SCAN_COUNT - 1,
+    // Set ROW pin control for in-use rows (HTCMD_ROW_PIN_CTL)
+    5, HTCMD_ROW_PIN_CTL, 0b01111111, 0xff, 0xff, 0xff,
+    // No hardware effects until somebody asks for them.
+    2, HTCMD_MODE_CTL, 0x00,
+    2, HTCMD_SYS_OSC_CTL, 0b10, // Activate oscillator.
+    0
+};
+
+/// Command script to put the HT16D35B in standby.
+static const uint8_t ht16d_standby_script[] = {
+    2, HTCMD_SYS_OSC_CTL, 0b00, // Deactivate everything.
+    0
+};
+
+/// Command script to turn off the display, but leave the oscillator running.
+static const uint8_t ht16d_display_off_script[] = {
+    2, HTCMD_SYS_OSC_CTL, 0b10, // Activate oscillator.
+    0
+};
+
+/// Command script to wake the HT16D35B (from standby, or display off).
+/**
+ ** The oscillator needs to be on before the display is.
+ */
+static const uint8_t ht16d_display_on_script[] = {
+    2, HTCMD_SYS_OSC_CTL, 0b10, // Activate oscillator.
+    2, HTCMD_SYS_OSC_CTL, 0b11, // Activate osc & display.
+    0
+};
+
+/// Set `ht16d_settings` to what `ht16d_setup_script` leaves them at.
+static void ht16d_settings_setup() {
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_BWGRAY_SEL)] = HTCMD_BWGRAY_SEL_GRAYSCALE;
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_COM_NUM)] = HT16D_SCAN_COUNT - 1;
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_BLINKING)] = 0x00;
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_SYS_OSC_CTL)] = 0b10;
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_I_RATIO)] = HT16D_I_RATIO_DEFAULT;
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_GLOBAL_BRTNS)] = HT16D_BRIGHTNESS_DEFAULT;
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_MODE_CTL)] = 0x00;
+}
+
 /// Initialize the HT16D35B, and enable the eUSCI for talking to it.
 /**
  ** Specifically, we initialize the device with the following characteristics:
@@ -138,9 +476,13 @@ void ht16_d_send_cmd_dat(uint8_t cmd, uint8_t dat) {
  ** * Grayscale mode
  ** * No fade, UCOM, USEG, or matrix masking
  ** * Global brightness to `HT16D_BRIGHTNESS_DEFAULT`
- ** * Only columns 0, 1, and 2 in use
+ ** * `HT16D_SCAN_COUNT` columns scanned, `HT16D_COL_COUNT` of them driven
  ** * Maximum constant current ratio
  ** * HIGH SCAN mode (common-anode on columns)
+ **
+ ** The register setup, the first frame, and turning the display on are each
+ ** a single transfer, and each is queued behind the last without any waiting
+ ** in between, so this returns while the display is still being turned on.
  */
 void ht16d_init() {
     // On POR:
@@ -151,29 +493,16 @@ void ht16d_init() {
 
     ht16d_init_peripheral();
 
-    // SW Reset (HTCMD_SW_RESET)
-    ht16d_send_cmd_single(HTCMD_SW_RESET);
-
-    // Set global brightness
-    ht16_d_send_cmd_dat(HTCMD_GLOBAL_BRTNS, HT16D_BRIGHTNESS_DEFAULT);
-    // Set BW/Binary display mode.
-    ht16_d_send_cmd_dat(HTCMD_BWGRAY_SEL, HTCMD_BWGRAY_SEL_GRAYSCALE);
-    // Set column pin control for in-use cols (HTCMD_COM_PIN_CTL)
-    // TODO: variable for this:
-    ht16_d_send_cmd_dat(HTCMD_COM_PIN_CTL, 0b0000001);
-    // Set constant current ratio (HTCMD_I_RATIO)
-    ht16_d_send_cmd_dat(HTCMD_I_RATIO, 0b0111); // 0b000 (max) is :fire: :fire:
-    // Set columns to 3 (0--2), and HIGH SCAN mode (HTCMD_COM_NUM)
-    ht16_d_send_cmd_dat(HTCMD_COM_NUM, 0x02);
-
-    // Set ROW pin control for in-use rows (HTCMD_ROW_PIN_CTL)
-    uint8_t row_ctl[] = {HTCMD_ROW_PIN_CTL, 0b01111111, 0xff, 0xff, 0xff};
-    ht16d_send_array(row_ctl, 5);
-    ht16_d_send_cmd_dat(HTCMD_SYS_OSC_CTL, 0b10); // Activate oscillator.
+    ht16d_mode = 0x00;
+    ht16d_settings_setup();
+    ht16d_send_segments_async(ht16d_reset_script);
+    ht16d_send_segments_async(ht16d_setup_script);
 
+    // Display RAM isn't cleared on POR, so the first frame must be complete.
+    ht16d_dirty = HT16D_ALL_DIRTY;
     ht16d_all_one_color(128,128,128); // Turn off all the LEDs.
 
-    ht16_d_send_cmd_dat(HTCMD_SYS_OSC_CTL, 0b11); // Activate oscillator & display.
+    ht16d_display_on();
 }
 
 /// Set the global brightness of the display module.
@@ -190,69 +519,442 @@ void ht16d_init() {
 void ht16d_set_global_brightness(uint8_t brightness) {
     if (brightness > HT16D_BRIGHTNESS_MAX)
         brightness = HT16D_BRIGHTNESS_MAX;
-    ht16_d_send_cmd_dat(HTCMD_GLOBAL_BRTNS, brightness);
+    ht16d_send_setting(HTCMD_GLOBAL_BRTNS, brightness);
+}
+
+/// Set the constant current ratio, which scales every row's current.
+/**
+ ** This goes from `HT16D_I_RATIO_MAX` (0, full current) down to 7, which is
+ ** 9/16 of full current, in steps of 1/16. Unlike the global brightness, which
+ ** is a PWM duty cycle, this reduces the peak current through the LEDs.
+ **
+ ** \param ratio The new constant current ratio, from 0 (max) to 7.
+ */
+void ht16d_set_current_ratio(uint8_t ratio) {
+    ht16d_send_setting(HTCMD_I_RATIO, ratio & 0x07);
 }
 
-/// Transmit the data currently in `led_values` to the LED controller.
+/// Get the 6-bit grayscale value for display RAM row `row` of column `col`.
+static inline uint8_t ht16d_row_value(uint8_t col, uint8_t row) {
+    return ((const uint8_t *) ht16d_gs_values)[ht16d_row_offsets[HT16D_ROW_INDEX(col, row)]];
+}
+
+/// Commit the changed parts of `ht16d_gs_values`, and start sending them.
 /**
- ** Here, and only here, we also convert the LED channel brightness values
- ** from 8-bit to 6-bit.
+ ** Only the rows belonging to LEDs that have changed
+ ** since the last call are sent, as one `HTCMD_WRITE_DISPLAY` window per
+ ** contiguous run of dirty rows (runs separated by a small enough gap are
+ ** merged into one window).
+ **
+ ** The windows are built into the back segment list, which nothing else is
+ ** using, so this can run while the previous frame is still on the wire. We
+ ** only wait for that frame when it's time to swap the two lists, which is
+ ** just a pointer exchange, and then kick off the new one. The caller is free
+ ** to start on the next frame as soon as this returns; `EV_HT16D_TX_DONE` is
+ ** posted once the frame has finished sending. This is in the hot set; see
+ ** `BADGE_HOT`.
  */
-void ht16d_send_gray() {
-    // We must send a column at a time.
-    uint8_t light_array[30] = {HTCMD_WRITE_DISPLAY, 0x00, 0};
-
-    // TODO: this time, we're only using one column...
-    uint8_t col = 0;
-    {
-        light_array[1] = 0x20*col;
-        // TODO: account for multiple columns:
-        for (uint8_t row=0; row<28; row++) {
-            uint8_t led_num = ht16d_col_mapping[col][row][0];
-            uint8_t rgb_num = ht16d_col_mapping[col][row][1];
-
-            light_array[row+2] = ht16d_gs_values[led_num][rgb_num]>>2;
+BADGE_HOT void ht16d_send_gray() {
+    const uint8_t *gs = (const uint8_t *) ht16d_gs_values;
+    const uint8_t *offsets = ht16d_row_offsets;
+    const ht16d_mask_t *masks = ht16d_row_masks;
+    uint8_t *window;
+    uint8_t *out = ht16d_frame_edit;
+    uint8_t *swap;
+    uint8_t last_row;
+
+    if (!ht16d_dirty) {
+        return;
+    }
+
+    PROF_BEGIN(PROF_HT16D_SEND_GRAY);
+
+    // Every column's windows go in the same segment list, so the whole
+    // frame is still a single interrupt-driven burst.
+    for (uint8_t col=0; col<HT16D_COL_COUNT; col++) {
+        window = 0;
+        last_row = 0;
+
+        for (uint8_t row=0; row<HT16D_ROW_COUNT; row++) {
+            if (!(ht16d_dirty & masks[row])) {
+                continue;
+            }
+
+            if (window && row - last_row <= HT16D_WINDOW_MERGE_GAP + 1) {
+                // Close enough to the current window to just extend it.
+                while (++last_row < row) {
+                    *(out++) = gs[offsets[last_row]];
+                    (*window)++;
+                }
+            } else {
+                // Open a new window starting at this row.
+                window = out;
+                *(out++) = 2;
+                *(out++) = HTCMD_WRITE_DISPLAY;
+                *(out++) = 0x20*col + row;
+            }
+
+            *(out++) = gs[offsets[row]];
+            (*window)++;
+            last_row = row;
         }
-        ht16d_send_array(light_array, 30);
+
+        offsets += HT16D_ROW_COUNT;
+        masks += HT16D_ROW_COUNT;
     }
+    *out = 0;
+
+    ht16d_dirty = 0;
+
+    // Waiting on the previous frame is the SPI bus's time, not ours.
+    PROF_END(PROF_HT16D_SEND_GRAY);
+
+    // The front list is ours again once the last frame is done with it.
+    ht16d_wait_idle();
+    swap = ht16d_frame_transmit;
+    ht16d_frame_transmit = ht16d_frame_edit;
+    ht16d_frame_edit = swap;
+
+    ht16d_send_segments_async(ht16d_frame_transmit);
 }
 
 /// Set some of the colors, but don't send them to the LED controller.
-void ht16d_put_colors(uint8_t id_start, uint8_t id_len, rgbcolor16_t* colors) {
+/**
+ ** This is where the 15 significant bits per channel are reduced to the 8
+ ** bit index into `ht16d_gamma`, which yields the 6-bit grayscale code that
+ ** we'll store and eventually send. This is in the hot set; see `BADGE_HOT`.
+ */
+BADGE_HOT void ht16d_put_colors(uint8_t id_start, uint8_t id_len, rgbcolor16_t* colors) {
     if (id_start >= HT16D_LED_COUNT || id_start+id_len > HT16D_LED_COUNT) {
         return;
     }
     for (uint8_t i=0; i<id_len; i++) {
-        ht16d_gs_values[(id_start+i)][0] = (uint8_t)(colors[i].r >> 7);
-        ht16d_gs_values[(id_start+i)][1] = (uint8_t)(colors[i].g >> 7);
-        ht16d_gs_values[(id_start+i)][2] = (uint8_t)(colors[i].b >> 7);
+        uint8_t *gs = ht16d_gs_values[id_start+i];
+        uint8_t r = ht16d_gamma[0][(uint8_t)(colors[i].r >> 7)];
+        uint8_t g = ht16d_gamma[1][(uint8_t)(colors[i].g >> 7)];
+        uint8_t b = ht16d_gamma[2][(uint8_t)(colors[i].b >> 7)];
+
+        if (gs[0] != r || gs[1] != g || gs[2] != b) {
+            gs[0] = r;
+            gs[1] = g;
+            gs[2] = b;
+            ht16d_dirty |= (ht16d_mask_t) 1 << (id_start+i);
+            if (r || g || b) {
+                ht16d_lit |= (ht16d_mask_t) 1 << (id_start+i);
+            } else {
+                ht16d_lit &= ~((ht16d_mask_t) 1 << (id_start+i));
+            }
+        }
     }
 }
 
+/// Returns true if every LED is set to be completely off.
+/**
+ ** This reflects the colors that have been put, whether or not they've been
+ ** sent yet.
+ */
+uint8_t ht16d_all_dark() {
+    return !ht16d_lit;
+}
+
 /// Set some of the colors, and immediately send them to the LED controller.
 void ht16d_set_colors(uint8_t id_start, uint8_t id_len, rgbcolor16_t* colors) {
     ht16d_put_colors(id_start, id_len, colors);
     ht16d_send_gray();
 }
 
-/// Set all LEDs to the same R,G,B colors.
+/// Set all LEDs to the same 8-bit R,G,B colors.
 void ht16d_all_one_color(uint8_t r, uint8_t g, uint8_t b) {
+    r = ht16d_gamma[0][r];
+    g = ht16d_gamma[1][g];
+    b = ht16d_gamma[2][b];
+
     for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
-        ht16d_gs_values[i][0] = r;
-        ht16d_gs_values[i][1] = g;
-        ht16d_gs_values[i][2] = b;
+        if (ht16d_gs_values[i][0] != r ||
+            ht16d_gs_values[i][1] != g ||
+            ht16d_gs_values[i][2] != b) {
+            ht16d_gs_values[i][0] = r;
+            ht16d_gs_values[i][1] = g;
+            ht16d_gs_values[i][2] = b;
+            ht16d_dirty |= (ht16d_mask_t) 1 << i;
+        }
     }
 
+    ht16d_lit = (r || g || b) ? HT16D_ALL_LEDS : 0;
+
     ht16d_send_gray();
 
 }
 
+/// Have the LED controller fade or blink some LEDs on its own.
+/**
+ ** This programs the fade RAM for every row we use, then turns on the fade
+ ** function. From then on, each LED in `led_mask` ramps between off and the
+ ** value currently in display RAM (or blinks, if `slope` is false), every
+ ** `cycle` (one of `HT16D_HW_CYCLE_*`), with no further help from us. LEDs
+ ** not in `led_mask` hold steady.
+ **
+ ** `stagger` offsets each successive LED's start by that many quarters of the
+ ** cycle, so 0 puts every LED in phase and 1 makes a four-step chase.
+ **
+ ** The display RAM is left as it is, so `ht16d_send_gray()` can still change
+ ** the colors being faded, but there's no need to. This only works in
+ ** grayscale mode, which is all we use.
+ */
+void ht16d_hw_fade(ht16d_mask_t led_mask, uint8_t slope, uint8_t cycle, uint8_t stagger) {
+    uint8_t fade_data[HT16D_ROW_COUNT + 2];
+
+    ht16d_fade_mask = led_mask;
+    ht16d_fade_slope = slope;
+    ht16d_fade_cycle = cycle;
+    ht16d_fade_stagger = stagger;
+
+    for (uint8_t col=0; col<HT16D_COL_COUNT; col++) {
+        fade_data[0] = HTCMD_WRITE_FADE;
+        fade_data[1] = 0x20*col;
+
+        for (uint8_t row=0; row<HT16D_ROW_COUNT; row++) {
+            uint8_t led_num = ht16d_row_leds[HT16D_ROW_INDEX(col, row)];
+            uint8_t dot = 0x00;
+
+            if (led_mask & ht16d_row_masks[HT16D_ROW_INDEX(col, row)]) {
+                dot = (cycle & 0x03) | (((led_num * stagger) & 0x03) << 2);
+                if (slope) {
+                    dot |= HTCMD_FADE_FSS;
+                }
+            }
+
+            fade_data[2+row] = dot;
+        }
+
+        ht16d_send_array(fade_data, HT16D_ROW_COUNT + 2);
+    }
+
+    ht16d_mode |= HTCMD_MODE_CTL_FDEN;
+    ht16d_send_setting(HTCMD_MODE_CTL, ht16d_mode);
+}
+
+/// Returns true if the LED controller is running any effects on its own.
+uint8_t ht16d_hw_effects_active() {
+    return ht16d_mode & HTCMD_MODE_CTL_FDEN;
+}
+
+/// Stop all hardware fading and blinking; LEDs show their display RAM values.
+void ht16d_hw_effects_stop() {
+    if (!ht16d_hw_effects_active()) {
+        return;
+    }
+
+    ht16d_mode &= ~HTCMD_MODE_CTL_FDEN;
+    ht16d_send_setting(HTCMD_MODE_CTL, ht16d_mode);
+}
+
+/// Put the LED controller into standby, and wait until it's there.
+/**
+ ** This waits so that it's safe to go into a low power mode that turns off
+ ** the eUSCI's clock as soon as this returns.
+ */
 void ht16d_standby() {
-    ht16_d_send_cmd_dat(HTCMD_SYS_OSC_CTL, 0b00); // Deactivate everything.
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_SYS_OSC_CTL)] = 0b00;
+    ht16d_send_segments_async(ht16d_standby_script);
+    ht16d_wait_idle();
 }
+
+/// Turn the display off, leaving the LED controller's oscillator on.
 void ht16d_display_off() {
-    ht16_d_send_cmd_dat(HTCMD_SYS_OSC_CTL, 0b10); // Activate oscillator.
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_SYS_OSC_CTL)] = 0b10;
+    ht16d_send_segments_async(ht16d_display_off_script);
 }
+
+/// Turn the LED controller's oscillator and display on.
 void ht16d_display_on() {
-    ht16_d_send_cmd_dat(HTCMD_SYS_OSC_CTL, 0b11); // Activate osc & display.
+    ht16d_settings[HT16D_STATUS_BYTE(HTCMD_SYS_OSC_CTL)] = 0b11;
+    ht16d_send_segments_async(ht16d_display_on_script);
+}
+
+/// Put the oscillator and display back how `ht16d_settings` says they were.
+static void ht16d_restore_osc() {
+    switch (ht16d_settings[HT16D_STATUS_BYTE(HTCMD_SYS_OSC_CTL)]) {
+    case 0b00:
+        ht16d_standby();
+        break;
+    case 0b10:
+        ht16d_display_off();
+        break;
+    default:
+        ht16d_display_on();
+        break;
+    }
+}
+
+/// Read back display RAM, and mark any LED that doesn't match as dirty.
+/**
+ ** LEDs that are already dirty are skipped, since their new colors haven't
+ ** been sent yet. Returns true if anything didn't match.
+ */
+static uint8_t ht16d_verify_display() {
+    uint8_t cmd[2];
+    uint8_t rows[HT16D_ROW_COUNT];
+    ht16d_mask_t mask;
+    uint8_t mismatched = 0;
+
+    for (uint8_t col=0; col<HT16D_COL_COUNT; col++) {
+        cmd[0] = HTCMD_READ_DISPLAY;
+        cmd[1] = 0x20*col;
+        ht16d_read(cmd, 2, rows, HT16D_ROW_COUNT);
+
+        for (uint8_t row=0; row<HT16D_ROW_COUNT; row++) {
+            mask = ht16d_row_masks[HT16D_ROW_INDEX(col, row)];
+            if (ht16d_dirty & mask) {
+                continue;
+            }
+            if (rows[row] != ht16d_row_value(col, row)) {
+                ht16d_dirty |= mask;
+                mismatched = 1;
+            }
+        }
+    }
+
+    return mismatched;
+}
+
+/// Check that the LED controller still has its setup and frame, and repair it.
+/**
+ ** This reads the status register back, and compares it to what we've
+ ** sent. If the mode and COM count that only `ht16d_init()` sets are gone,
+ ** the controller has been reset, by a brown-out or a glitch on its supply,
+ ** so it gets `ht16d_setup_script` again (with no software reset, and the
+ ** display off), and then every setting we've changed since. Otherwise, only
+ ** the settings that don't match are resent.
+ **
+ ** Either way, display RAM is read back next, and only the LEDs whose rows
+ ** don't match are sent again, so there's none of the flicker of a full
+ ** `ht16d_init()` and frame. The display comes back on (if it was on) only
+ ** after its RAM has been put right.
+ **
+ ** This takes a couple of dozen bytes on the bus, so it's cheap enough to
+ ** call every few seconds, from the main loop. Setting it right takes a
+ ** few more, and only when something's gone wrong.
+ */
+void ht16d_health_check() {
+    uint8_t status[HT16D_STATUS_LEN];
+    uint8_t lost;
+    uint8_t osc;
+
+    ht16d_stats.checks++;
+    ht16d_read_status(status);
+    lost = ht16d_status_lost(status);
+    osc = HT16D_STATUS_BYTE(HTCMD_SYS_OSC_CTL);
+
+    if (lost) {
+        ht16d_stats.resets++;
+        ht16d_send_segments_async(ht16d_setup_script);
+        // Everything but the oscillator is back to its default now, or to
+        //  the setup script's, so compare against those from here on.
+        for (uint8_t i=0; i<HT16D_STATUS_LEN; i++) {
+            status[i] = 0x00;
+        }
+        status[HT16D_STATUS_BYTE(HTCMD_BWGRAY_SEL)] = HTCMD_BWGRAY_SEL_GRAYSCALE;
+        status[HT16D_STATUS_BYTE(HTCMD_COM_NUM)] = HT16D_SCAN_COUNT - 1;
+        status[HT16D_STATUS_BYTE(HTCMD_I_RATIO)] = HT16D_I_RATIO_DEFAULT;
+        status[HT16D_STATUS_BYTE(HTCMD_GLOBAL_BRTNS)] = HT16D_BRIGHTNESS_DEFAULT;
+        status[osc] = 0b10;
+
+        // The fade RAM is gone, too.
+        if (ht16d_mode & HTCMD_MODE_CTL_FDEN) {
+            ht16d_hw_fade(ht16d_fade_mask, ht16d_fade_slope, ht16d_fade_cycle, ht16d_fade_stagger);
+            status[HT16D_STATUS_BYTE(HTCMD_MODE_CTL)] = ht16d_settings[HT16D_STATUS_BYTE(HTCMD_MODE_CTL)];
+        }
+    }
+
+    for (uint8_t i=0; i<HT16D_STATUS_LEN; i++) {
+        if (i == osc || !(HT16D_STATUS_TRACKED & (1 << i))) {
+            continue;
+        }
+        if (status[i] != ht16d_settings[i]) {
+            if (!lost) {
+                ht16d_stats.settings++;
+            }
+            ht16d_send_setting(HTCMD_BWGRAY_SEL + i, ht16d_settings[i]);
+        }
+    }
+
+    if (ht16d_verify_display()) {
+        ht16d_stats.rows++;
+        ht16d_send_gray();
+    }
+
+    if (status[osc] != ht16d_settings[osc]) {
+        ht16d_restore_osc();
+    }
+}
+
+/// eUSCI_B0 (SPI to the LED controller) interrupt service routine.
+/**
+ ** We only enable the RX interrupt, which fires each time a byte has been
+ ** completely exchanged on the bus. That lets us load the next byte, or, if
+ ** we're out of bytes, release CS knowing that nothing is still in the
+ ** shift register. In a read, the bytes that come back once the command
+ ** and address are out are kept, and a zero is clocked out for each.
+ */
+#pragma vector=USCI_B0_VECTOR
+__interrupt void EUSCI_B0_ISR(void) {
+    uint8_t rx;
+
+    TRACE_ISR_ENTER();
+    switch(__even_in_range(UCB0IV, USCI_SPI_UCTXIFG)) {
+    case USCI_SPI_UCRXIFG:
+        rx = UCB0RXBUF; // Reading it clears the flag.
+
+        if (ht16d_rx_skip) {
+            ht16d_rx_skip--;
+        } else if (ht16d_rx_len) {
+            *(ht16d_rx_ptr++) = rx;
+            ht16d_rx_len--;
+        }
+
+        if (ht16d_tx_len) {
+            ht16d_tx_len--;
+            UCB0TXBUF = *(ht16d_tx_ptr++);
+            break;
+        }
+
+        if (ht16d_rx_len) {
+            UCB0TXBUF = 0x00;
+            break;
+        }
+
+        // CS high
+        P1OUT |= BIT0;
+
+        if (ht16d_rx_ptr) {
+            // Give P1.3 back to the trace.
+            ht16d_rx_ptr = 0;
+            P1SEL0 &= ~BIT3;
+            P1REN &= ~BIT3;
+        }
+
+        if (ht16d_tx_next && *ht16d_tx_next) {
+            // Chain straight into the next segment.
+            ht16d_tx_len = *ht16d_tx_next - 1;
+            ht16d_tx_ptr = ht16d_tx_next + 1;
+            ht16d_tx_next = ht16d_tx_next + 1 + *ht16d_tx_next;
+
+            // CS low
+            P1OUT &= ~BIT0;
+            UCB0TXBUF = *(ht16d_tx_ptr++);
+            break;
+        }
+
+        UCB0IE &= ~UCRXIE;
+        ht16d_tx_busy = 0;
+        TRACE_SPI_DONE();
+        power_need(POWER_CLIENT_HT16D, POWER_CLOCK_NONE);
+        badge_events |= EV_HT16D_TX_DONE;
+        LPM4_EXIT;
+        break;
+    default:
+        break;
+    }
+    TRACE_ISR_EXIT();
 }
@@ -18,6 +18,57 @@
 #define HT16D_BRIGHTNESS_DEFAULT 0x30
 #define HT16D_BRIGHTNESS_MIN 0x01
 #define HT16D_BRIGHTNESS_MAX 0x40 // Real BRIGHTNESS_MAX is 0x40.
+/// The initial constant current ratio, 9/16 of the maximum row current.
+#define HT16D_I_RATIO_DEFAULT 0b0111
+/// The constant current ratio for the full row current.
+#define HT16D_I_RATIO_MAX 0b0000
+/// Seconds between checks that the LED controller hasn't lost its setup.
+#define HT16D_HEALTH_SECS 8
+/// The number of RGB (3-channel) LEDs in the system.
+#define HT16D_LED_COUNT 9
+/// The number of COM lines (columns) that have LEDs on them.
+/**
+ ** The LEDs are assumed to be spread evenly across the columns, with
+ ** `HT16D_MAPPING`, in ht16d35a.c, saying which are where.
+ */
+#define HT16D_COL_COUNT 1
+/// The number of COM lines that the LED controller scans.
+/**
+ ** This sets the duty cycle (1/`HT16D_SCAN_COUNT`), and so the frame time and
+ ** the speed of the hardware effects. It must be at least `HT16D_COL_COUNT`.
+ */
+#define HT16D_SCAN_COUNT 3
+
+#if HT16D_COL_COUNT > HT16D_SCAN_COUNT
+#error "HT16D_SCAN_COUNT must be at least HT16D_COL_COUNT"
+#endif
+
+#if HT16D_LED_COUNT > 32
+#error "ht16d_mask_t only has room for 32 LEDs"
+#elif HT16D_LED_COUNT > 16
+/// A bitmask with one bit per LED.
+typedef uint32_t ht16d_mask_t;
+#else
+/// A bitmask with one bit per LED.
+typedef uint16_t ht16d_mask_t;
+#endif
+
+/// Bitmask with a bit set for every LED.
+#define HT16D_ALL_LEDS ((ht16d_mask_t) ~(ht16d_mask_t) 0 >> (sizeof(ht16d_mask_t)*8 - HT16D_LED_COUNT))
+
+/// Hardware fade/blink cycle settings, given a 3 COM (1/3 duty) scan.
+/**
+ ** A frame is `HT16D_SCAN_COUNT`*4160 cycles of the 4.92 MHz internal
+ ** oscillator, so about 2.5 ms with 3 COMs. The times below are for 3 COMs;
+ ** they're halved for 4 through 6, and quartered for 7 or 8.
+ */
+#define HT16D_HW_CYCLE_OFF   0x00
+/// 512 frames, about 1.3 seconds.
+#define HT16D_HW_CYCLE_SHORT 0x01
+/// 1024 frames, about 2.6 seconds.
+#define HT16D_HW_CYCLE_MED   0x02
+/// 2048 frames, about 5.2 seconds.
+#define HT16D_HW_CYCLE_LONG  0x03
 
 typedef struct {
     uint8_t r;
@@ -31,12 +82,37 @@ typedef struct {
     uint16_t b;
 } rgbcolor16_t;
 
+/// Counters for how the LED controller has been holding up, for diagnostics.
+typedef struct {
+    /// Calls to `ht16d_health_check()`.
+    uint16_t checks;
+    /// Times the controller had lost its setup, and was set up again.
+    uint16_t resets;
+    /// Settings that had to be resent, besides after a reset.
+    uint16_t settings;
+    /// Times display RAM didn't match, and the LEDs that differed were resent.
+    uint16_t rows;
+} ht16d_stats_t;
+
+extern ht16d_stats_t ht16d_stats;
+
 void ht16d_init();
+void ht16d_set_smclk_mhz(uint8_t smclk_mhz);
+uint8_t ht16d_busy();
+void ht16d_wait_idle();
 void ht16d_send_gray();
 void ht16d_all_one_color(uint8_t r, uint8_t g, uint8_t b);
 void ht16d_put_colors(uint8_t id_start, uint8_t id_len, rgbcolor16_t* colors);
 void ht16d_set_colors(uint8_t id_start, uint8_t id_end, rgbcolor16_t* colors);
 void ht16d_set_global_brightness(uint8_t brightness);
+void ht16d_set_current_ratio(uint8_t ratio);
+uint8_t ht16d_all_dark();
+uint8_t ht16d_responding();
+void ht16d_health_check();
+
+void ht16d_hw_fade(ht16d_mask_t led_mask, uint8_t slope, uint8_t cycle, uint8_t stagger);
+uint8_t ht16d_hw_effects_active();
+void ht16d_hw_effects_stop();
 
 void ht16d_standby();
 void ht16d_display_off();
@@ -0,0 +1,122 @@
+/// Touch button input module.
+/**
+ ** Every CapTIvate sensor gets the same callback, which looks up the
+ ** sensor's index in `g_uiApp.pSensorList` and updates that button's row
+ ** of `input_buttons`. Those rows are all the button state there is; chords
+ ** are worked out from their timestamps, and long presses are a deadline
+ ** per button, rather than any per-button code or extra scans.
+ **
+ ** What comes out is a stream of one-byte `INPUT_EV_*` events, which go to
+ ** `badge_input()`:
+ **
+ ** Event            | When
+ ** :----            | :---
+ ** `INPUT_EV_PRESS` | A button goes down.
+ ** `INPUT_EV_SHORT` | A button comes up before `INPUT_LONG_PRESS_TICKS`.
+ ** `INPUT_EV_LONG`  | A button has been down for `INPUT_LONG_PRESS_TICKS`.
+ ** `INPUT_EV_CHORD` | A button goes down within `INPUT_CHORD_TICKS` of another.
+ **
+ ** Once buttons are in a chord, they get no short or long events of their
+ ** own until they're released, and a chord that grows sends another
+ ** `INPUT_EV_CHORD` with the bigger mask.
+ **
+ ** \file input.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include "captivate.h"
+
+#include "badge.h"
+#include "deadline.h"
+#include "rtc.h"
+
+#include "input.h"
+
+/// State and timestamps for each button, by index in `g_uiApp.pSensorList`.
+input_button_t input_buttons[INPUT_BUTTON_COUNT];
+/// Each button's long press deadline, which runs while it's down.
+deadline_t input_long_press[INPUT_BUTTON_COUNT];
+
+/// Deadline callback for button `index` having been held for a long press.
+static void input_long_press_cb(uint8_t index) {
+    if (input_buttons[index].state == INPUT_STATE_DOWN) {
+        input_buttons[index].state = INPUT_STATE_LONG;
+        badge_input(INPUT_EV_LONG | index);
+    }
+}
+
+/// Callback from CapTIvate after it updates any of the buttons' sensors.
+static void input_sensor_cb(tSensor *pSensor) {
+    uint8_t index;
+    uint8_t chord = 0;
+    input_button_t *button;
+
+    if (pSensor->bSensorTouch == pSensor->bSensorPrevTouch) {
+        return;
+    }
+
+    for (index=0; index<INPUT_BUTTON_COUNT; index++) {
+        if (g_uiApp.pSensorList[index] == pSensor) {
+            break;
+        }
+    }
+    if (index == INPUT_BUTTON_COUNT) {
+        return;
+    }
+    button = &input_buttons[index];
+
+    if (pSensor->bSensorTouch) {
+        // Press. Get every tick again first, so that the timestamp, and
+        //  the long press after it, are both exact.
+        rtc_schedule(1);
+        button->press_ticks = rtc_ticks;
+        button->state = INPUT_STATE_DOWN;
+        deadline_start(&input_long_press[index], INPUT_LONG_PRESS_TICKS);
+        badge_input(INPUT_EV_PRESS | index);
+
+        // Anything else that went down recently is in a chord with this.
+        for (uint8_t i=0; i<INPUT_BUTTON_COUNT; i++) {
+            if (i != index && input_buttons[i].state != INPUT_STATE_UP &&
+                    (input_buttons[i].state == INPUT_STATE_CHORD ||
+                     (uint16_t) (rtc_ticks - input_buttons[i].press_ticks) <= INPUT_CHORD_TICKS)) {
+                chord |= 1 << i;
+            }
+        }
+
+        if (chord) {
+            chord |= 1 << index;
+            for (uint8_t i=0; i<INPUT_BUTTON_COUNT; i++) {
+                if (chord & (1 << i)) {
+                    input_buttons[i].state = INPUT_STATE_CHORD;
+                    deadline_stop(&input_long_press[i]);
+                }
+            }
+            badge_input(INPUT_EV_CHORD | chord);
+        }
+    } else {
+        // Release.
+        button->release_ticks = rtc_ticks;
+        deadline_stop(&input_long_press[index]);
+        if (button->state == INPUT_STATE_DOWN) {
+            badge_input(INPUT_EV_SHORT | index);
+        }
+        button->state = INPUT_STATE_UP;
+    }
+}
+
+/// Register as the callback for every button, with all of them up.
+/**
+ ** Call this after `CAPT_appStart()`.
+ */
+void input_init() {
+    for (uint8_t i=0; i<INPUT_BUTTON_COUNT; i++) {
+        input_buttons[i].state = INPUT_STATE_UP;
+        input_long_press[i].cb = input_long_press_cb;
+        input_long_press[i].arg = i;
+        MAP_CAPT_registerCallback(g_uiApp.pSensorList[i], &input_sensor_cb);
+    }
+}
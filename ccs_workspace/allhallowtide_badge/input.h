@@ -0,0 +1,67 @@
+/// Header for the touch button input module.
+/**
+ ** \file input.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef INPUT_H_
+#define INPUT_H_
+
+#include <stdint.h>
+
+#include "captivate.h"
+
+/// Number of buttons; one per sensor in `g_uiApp.pSensorList`.
+#define INPUT_BUTTON_COUNT CAPT_SENSOR_COUNT
+
+/// Button index of the nose (`BTN00_NOSE`).
+#define INPUT_BTN_NOSE 0
+/// Button index of the eye (`BTN01_EYE`).
+#define INPUT_BTN_EYE 1
+/// Button index of the lock (`BTN02_LOCK`).
+#define INPUT_BTN_LOCK 2
+
+/// System ticks that a button must be held to count as a long press.
+#define INPUT_LONG_PRESS_TICKS 100
+/// System ticks apart that two presses can be and still count as a chord.
+#define INPUT_CHORD_TICKS 20
+
+/// Input event: a button was pressed. The low bits are its button index.
+#define INPUT_EV_PRESS 0x10
+/// Input event: a button was released before a long press.
+#define INPUT_EV_SHORT 0x20
+/// Input event: a button has been held for `INPUT_LONG_PRESS_TICKS`.
+#define INPUT_EV_LONG 0x30
+/// Input event: buttons were pressed together. The low bits are a bitmask.
+#define INPUT_EV_CHORD 0x40
+/// Mask for the kind of event, one of `INPUT_EV_*`.
+#define INPUT_EV_TYPE_MASK 0xF0
+/// Mask for the event's button index, or bitmask of buttons for chords.
+#define INPUT_EV_ARG_MASK 0x0F
+
+/// The button isn't pressed.
+#define INPUT_STATE_UP 0
+/// The button is pressed, and hasn't been held long enough for a long press.
+#define INPUT_STATE_DOWN 1
+/// The button is pressed, and its long press has already been sent.
+#define INPUT_STATE_LONG 2
+/// The button is pressed as part of a chord, so it gets no events of its own.
+#define INPUT_STATE_CHORD 3
+
+/// What we know about one button.
+typedef struct {
+    /// One of `INPUT_STATE_*`.
+    uint8_t state;
+    /// `rtc_ticks` when the button was last pressed.
+    uint16_t press_ticks;
+    /// `rtc_ticks` when the button was last released.
+    uint16_t release_ticks;
+} input_button_t;
+
+extern input_button_t input_buttons[INPUT_BUTTON_COUNT];
+
+void input_init();
+
+#endif /* INPUT_H_ */
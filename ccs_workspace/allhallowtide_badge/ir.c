@@ -6,4 +6,742 @@
  * \copyright MIT License.
  */
 
+/// Interrupt-driven IrDA link layer, on UCA0 and the TFBS4711 transceiver.
+/**
+ ** The eUSCI does the IrDA pulse encoding and decoding in hardware, so from
+ ** here up this is just a UART. Everything on the wire is framed as:
+ **
+ ** Byte      | Contents
+ ** :-------  | :-------
+ ** 0         | `IR_SYNC_BYTE`
+ ** 1         | Payload length, 1 to `IR_PAYLOAD_MAX`
+ ** 2...      | Payload
+ ** last 2    | CRC-16 of the length and payload, MSB first
+ **
+ ** Both directions share a small pool of `ir_packet_t` slots, which the
+ ** ISR fills and drains in place; only slot numbers are ever queued. On the
+ ** receive side, the ISR does the framing itself, claiming a free slot when
+ ** it sees `IR_SYNC_BYTE`, and only queues the slot for the main loop (and
+ ** posts `EV_IR_RX`) once the whole frame is in. So the CPU stays asleep for
+ ** the whole frame, and the main loop only has to check the CRC in
+ ** `ir_handle_rx()` before handing `badge_ir_rx()` a pointer to the payload
+ ** right where it landed. To transmit, claim a slot with `ir_packet_alloc()`,
+ ** fill it in, and pass it to `ir_packet_send()`.
+ **
+ ** The transceiver isn't left on. Every `IR_CYCLE_TICKS`, it's brought out
+ ** of shutdown for a listening window of `IR_WINDOW_TICKS`, at a random
+ ** point in the cycle, and shut down again afterwards. Transmissions,
+ ** including the beacon set with `ir_set_beacon()`, are held until our
+ ** window opens. Because every badge's window moves around randomly from
+ ** cycle to cycle, any two badges in view of each other will soon share a
+ ** window, but a crowd of badges won't all be talking at once.
+ **
+ ** Once our clock has been synced to another badge's (see sync.c), the
+ ** schedule can be shared instead, with `ir_set_shared_schedule()`. Then the
+ ** cycle lines up with the second, and the window's place in it is a hash
+ ** of `rtc_seconds`, so every synced badge opens its window at once. As
+ ** they're sure to share a window, they only listen every
+ ** `IR_SHARED_CYCLES` cycles.
+ **
+ ** For when there's a crowd anyway, transmission goes through a simple
+ ** CSMA MAC in `ir_tick()`. Before we start sending, we check whether
+ ** we've heard anything lately, and if so, back off for a random number of
+ ** ticks from a window that doubles with each attempt. After
+ ** `IR_MAC_MAX_RETRIES` attempts, we drop what's queued rather than keep
+ ** adding to the noise. All of this is counted in `ir_stats`.
+ **
+ ** \file ir.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "power.h"
+#include "rtc.h"
+#include "trace.h"
+
+#include "ir.h"
+
+#if IR_ENABLE
+
+/// Receive framing state: waiting for `IR_SYNC_BYTE`.
+#define IR_RX_STATE_SYNC 0
+/// Receive framing state: waiting for the length byte.
+#define IR_RX_STATE_LEN 1
+/// Receive framing state: receiving the payload and CRC.
+#define IR_RX_STATE_BODY 2
+
+/// Pool slot state: free for anyone to claim.
+#define IR_SLOT_FREE 0
+/// Pool slot state: the ISR is receiving into it.
+#define IR_SLOT_RX 1
+/// Pool slot state: belongs to the main loop (received, or being filled in).
+#define IR_SLOT_APP 2
+/// Pool slot state: queued for, or being clocked out by, the ISR.
+#define IR_SLOT_TX 3
+/// Slot number meaning no slot.
+#define IR_NO_SLOT 0xFF
+
+/// The packet pool.
+ir_packet_t ir_pool[IR_POOL_SLOTS];
+/// The `IR_SLOT_*` state of each slot in `ir_pool`.
+volatile uint8_t ir_pool_state[IR_POOL_SLOTS] = {IR_SLOT_FREE,};
+
+/// Slot numbers of received frames, waiting for the main loop.
+volatile uint8_t ir_rx_queue[IR_QUEUE_LEN];
+/// Index just past the last slot in `ir_rx_queue`; only the ISR writes it.
+volatile uint8_t ir_rx_head = 0;
+/// Index of the first unhandled slot in `ir_rx_queue`; only main writes it.
+volatile uint8_t ir_rx_tail = 0;
+/// The slot that the ISR is receiving into, or `IR_NO_SLOT`.
+volatile uint8_t ir_rx_slot = IR_NO_SLOT;
+/// Which `IR_RX_STATE_*` the receive framing is in.
+volatile uint8_t ir_rx_state = IR_RX_STATE_SYNC;
+/// Bytes of the current frame's payload and CRC received so far.
+volatile uint8_t ir_rx_pos = 0;
+/// System ticks since the last byte of the frame in progress.
+uint8_t ir_rx_silent_ticks = 0;
+
+/// Slot numbers of frames waiting to be sent.
+volatile uint8_t ir_tx_queue[IR_QUEUE_LEN];
+/// Index just past the last slot in `ir_tx_queue`; only main writes it.
+volatile uint8_t ir_tx_head = 0;
+/// Index of the next slot for the ISR to send; only the ISR writes it.
+volatile uint8_t ir_tx_tail = 0;
+/// The slot that the ISR is sending, or `IR_NO_SLOT`.
+volatile uint8_t ir_tx_slot = IR_NO_SLOT;
+/// Index of the next byte of the frame in `ir_tx_slot` to send.
+volatile uint8_t ir_tx_pos = 0;
+/// True from when a frame starts sending until its last bit has left the UART.
+volatile uint8_t ir_tx_active = 0;
+
+/// System ticks left before we consider the channel quiet again.
+volatile uint8_t ir_mac_sense_ticks = 0;
+/// System ticks left to wait before trying to transmit again.
+uint8_t ir_mac_backoff_ticks = 0;
+/// Times in a row we've found the channel busy.
+uint8_t ir_mac_retries = 0;
+
+/// Link statistics.
+ir_stats_t ir_stats = {0,};
+
+/// Frame to send at the start of each listening window, or 0 for none.
+const uint8_t *ir_beacon = 0;
+/// Length of `ir_beacon`.
+uint8_t ir_beacon_len = 0;
+/// `ir_tx_head` as the last beacon was queued, to find it again.
+uint8_t ir_beacon_at = 0;
+/// True if the last beacon was queued; it may have been sent since.
+uint8_t ir_beacon_queued = 0;
+/// System ticks into the current listen/beacon cycle.
+uint8_t ir_cycle_tick = 0;
+/// The tick in this cycle at which our listening window opens.
+uint8_t ir_window_start = 0;
+/// System ticks left in the current window, or 0 if the window is closed.
+uint8_t ir_window_left = 0;
+/// True if the window has been open long enough to transmit.
+uint8_t ir_tx_allowed = 0;
+/// State of the pseudorandom number generator.
+uint16_t ir_rand_state = 1;
+/// True if we're on the schedule shared by synced badges.
+uint8_t ir_shared = 0;
+
+/// Location of this chip's die record (lot, wafer, and die position) in TLV.
+#define IR_TLV_DIE_RECORD ((const uint16_t *) 0x1A0A)
+
+/// Get a pseudorandom number, with a 16-bit xorshift.
+static uint16_t ir_rand() {
+    ir_rand_state ^= ir_rand_state << 7;
+    ir_rand_state ^= ir_rand_state >> 9;
+    ir_rand_state ^= ir_rand_state << 8;
+    return ir_rand_state;
+}
+
+/// Drop the frame being received, if any, and wait for the next sync byte.
+/**
+ ** Call this from the ISR, or with interrupts disabled.
+ */
+static void ir_rx_abort() {
+    if (ir_rx_slot != IR_NO_SLOT) {
+        ir_pool_state[ir_rx_slot] = IR_SLOT_FREE;
+        ir_rx_slot = IR_NO_SLOT;
+    }
+    ir_rx_state = IR_RX_STATE_SYNC;
+}
+
+/// Let the ISR start sending everything that's queued.
+static void ir_tx_start() {
+    // TXIFG is already set whenever the UART is idle, so this starts it.
+    ir_tx_active = 1;
+    TRACE_UART_START();
+    UCA0IE |= UCTXIE;
+}
+
+/// Decide, once per tick, whether to start sending what's queued.
+/**
+ ** Backoff windows are seeded from our chip's die record (via `ir_rand()`)
+ ** and the current `rtc_centiseconds`.
+ */
+static void ir_mac_tick() {
+    uint8_t exp;
+
+    if (!ir_tx_allowed || ir_tx_active || ir_tx_head == ir_tx_tail) {
+        return;
+    }
+
+    if (ir_mac_backoff_ticks) {
+        ir_mac_backoff_ticks--;
+        return;
+    }
+
+    if (!ir_mac_sense_ticks && ir_rx_state == IR_RX_STATE_SYNC) {
+        // Channel's clear.
+        ir_mac_retries = 0;
+        ir_tx_start();
+        return;
+    }
+
+    if (++ir_mac_retries > IR_MAC_MAX_RETRIES) {
+        // The ISR isn't sending, so the tail is ours to move.
+        while (ir_tx_tail != ir_tx_head) {
+            ir_pool_state[ir_tx_queue[ir_tx_tail++ & (IR_QUEUE_LEN-1)]] = IR_SLOT_FREE;
+            ir_stats.tx_dropped++;
+        }
+        ir_mac_retries = 0;
+        return;
+    }
+
+    ir_stats.tx_backoffs++;
+    exp = ir_mac_retries < IR_MAC_MAX_BACKOFF_EXP ? ir_mac_retries : IR_MAC_MAX_BACKOFF_EXP;
+    ir_mac_backoff_ticks = (ir_rand() ^ rtc_centiseconds) & ((1 << exp) - 1);
+}
+
+/// Compute the CRC-16 of a frame's length byte and payload.
+/**
+ ** This uses the CRC16 module, and must only be called from the main loop.
+ */
+static uint16_t ir_crc16(uint8_t len, const uint8_t *payload) {
+    CRCINIRES = 0xFFFF;
+    CRCDI_L = len;
+    for (uint8_t i=0; i<len; i++) {
+        CRCDI_L = payload[i];
+    }
+    return CRCINIRES;
+}
+
+/// Initialize UCA0 as a 9600 baud IrDA UART, with the transceiver shut down.
+/**
+ ** The pins are already set up by `init_io()`. The transceiver stays shut
+ ** down until the first listening window, and the random window placement
+ ** is seeded from this chip's unique die record, so that badges that are
+ ** switched on together don't keep choosing the same windows.
+ */
+void ir_init() {
+    P1OUT |= BIT6; // SD high: transceiver shut down.
+
+    ir_rand_state = IR_TLV_DIE_RECORD[0] ^ IR_TLV_DIE_RECORD[1] ^
+                    IR_TLV_DIE_RECORD[2] ^ IR_TLV_DIE_RECORD[3];
+    if (!ir_rand_state) {
+        ir_rand_state = 1;
+    }
+    ir_window_start = ir_rand() % (IR_CYCLE_TICKS - IR_WINDOW_TICKS);
+
+    UCA0CTLW0 = UCSWRST;  // Shut down USCI_A0 and clear CTLW0.
+    UCA0CTLW0 |= UCSSEL__SMCLK; // SMCLK source, 8N1.
+
+    // 9600 baud from 8 MHz, per the eUSCI baud rate table:
+    UCA0BRW = 52;
+    UCA0MCTLW = 0x4900 | UCBRF_1 | UCOS16;
+
+    // IrDA encoder and decoder. The TX pulse is 3/16 of a bit
+    //  ((5+1)/(2*16*baud)), and the TFBS4711 gives us low RX pulses.
+    UCA0IRCTL = UCIREN | UCIRTXCLK | UCIRTXPL2 | UCIRTXPL0 | UCIRRXPL;
+
+    UCA0CTLW0 &= ~UCSWRST; // enable it.
+}
+
+/// Retune the baud rate generator for a new SMCLK rate.
+/**
+ ** This must only be called while the link is idle, with the window closed.
+ ** Holding the eUSCI in reset clears its interrupt enables, which is the
+ ** state it's in there anyway. The IrDA pulse is timed from the baud rate's
+ ** 16x oversampling clock, so it follows along by itself.
+ */
+void ir_set_smclk_mhz(uint8_t smclk_mhz) {
+    UCA0CTLW0 |= UCSWRST;
+    if (smclk_mhz == 1) {
+        // 9600 baud from 1 MHz, per the eUSCI baud rate table:
+        UCA0BRW = 6;
+        UCA0MCTLW = 0x2000 | UCBRF_8 | UCOS16;
+    } else {
+        UCA0BRW = 52;
+        UCA0MCTLW = 0x4900 | UCBRF_1 | UCOS16;
+    }
+    UCA0CTLW0 &= ~UCSWRST;
+}
+
+/// Claim a free packet slot, so that a frame can be built in it.
+/**
+ ** \return The slot, or 0 if the pool is empty. Give it back with either
+ **         `ir_packet_send()` or `ir_packet_release()`.
+ */
+ir_packet_t *ir_packet_alloc() {
+    uint16_t gie = __get_SR_register() & GIE;
+    ir_packet_t *packet = 0;
+
+    // The ISR claims slots too, so this must be atomic.
+    __bic_SR_register(GIE);
+    for (uint8_t i=0; i<IR_POOL_SLOTS; i++) {
+        if (ir_pool_state[i] == IR_SLOT_FREE) {
+            ir_pool_state[i] = IR_SLOT_APP;
+            packet = &ir_pool[i];
+            break;
+        }
+    }
+    __bis_SR_register(gie);
+
+    return packet;
+}
+
+/// Give a packet slot back to the pool, without sending it.
+void ir_packet_release(ir_packet_t *packet) {
+    ir_pool_state[packet - ir_pool] = IR_SLOT_FREE;
+}
+
+/// Queue a packet that's been filled in to be sent over IR.
+/**
+ ** `packet->len` and `packet->payload` must be set; the CRC is filled in
+ ** here. The slot belongs to the driver again once this is called, and is
+ ** freed once it's sent. This returns immediately, and `ir_tick()` will
+ ** start sending once our listening window is open and the channel is clear.
+ */
+void ir_packet_send(ir_packet_t *packet) {
+    uint8_t slot = packet - ir_pool;
+
+    if (!packet->len || packet->len > IR_PAYLOAD_MAX) {
+        ir_packet_release(packet);
+        return;
+    }
+
+    packet->crc = ir_crc16(packet->len, packet->payload);
+    ir_pool_state[slot] = IR_SLOT_TX;
+
+    // There are no more slots than queue entries, so this can't overflow.
+    ir_tx_queue[ir_tx_head & (IR_QUEUE_LEN-1)] = slot;
+    ir_tx_head++;
+    ir_stats.tx_frames++;
+}
+
+/// Queue a frame with a copy of `len` bytes of `payload` to send over IR.
+/**
+ ** \return 1 if the frame was queued, or 0 if it's too long or there's no
+ **         free packet slot for it right now.
+ */
+uint8_t ir_send(const uint8_t *payload, uint8_t len) {
+    ir_packet_t *packet;
+
+    if (!len || len > IR_PAYLOAD_MAX) {
+        return 0;
+    }
+
+    packet = ir_packet_alloc();
+    if (!packet) {
+        return 0;
+    }
+
+    packet->len = len;
+    for (uint8_t i=0; i<len; i++) {
+        packet->payload[i] = payload[i];
+    }
+    ir_packet_send(packet);
+
+    return 1;
+}
+
+/// Returns true if anything is still being, or waiting to be, sent.
+uint8_t ir_tx_busy() {
+    return ir_tx_active || ir_tx_head != ir_tx_tail;
+}
+
+/// Set a frame to be sent at the start of every one of our listening windows.
+/**
+ ** `payload` isn't copied until each window opens, so it must stay valid
+ ** (and can be updated in place) until this is called again. Pass a `len`
+ ** of 0 to stop beaconing. `badge_ir_beacon()` is called just before each
+ ** copy, for anything in it that has to be up to the moment.
+ */
+void ir_set_beacon(const uint8_t *payload, uint8_t len) {
+    ir_beacon = payload;
+    ir_beacon_len = len;
+}
+
+/// Queue this window's beacon, or bring last window's up to date.
+/**
+ ** A beacon that didn't get out in its window is still in the queue, with
+ ** a time in it that's gone stale. Rather than queue a second one behind
+ ** it, that one is refilled in place. The window's closed until this is
+ ** done, so nothing is sending it.
+ */
+static void ir_queue_beacon() {
+    ir_packet_t *packet;
+
+    badge_ir_beacon();
+
+    if (ir_beacon_queued && (uint8_t) (ir_beacon_at - ir_tx_tail) < (uint8_t) (ir_tx_head - ir_tx_tail)) {
+        packet = &ir_pool[ir_tx_queue[ir_beacon_at & (IR_QUEUE_LEN-1)]];
+        packet->len = ir_beacon_len;
+        for (uint8_t i=0; i<ir_beacon_len; i++) {
+            packet->payload[i] = ir_beacon[i];
+        }
+        packet->crc = ir_crc16(packet->len, packet->payload);
+        return;
+    }
+
+    ir_beacon_at = ir_tx_head;
+    ir_beacon_queued = ir_send(ir_beacon, ir_beacon_len);
+}
+
+/// Power up the transceiver and open our listening window.
+static void ir_window_open() {
+    P1OUT &= ~BIT6; // SD low: transceiver on.
+    // A frame can start at any time, and the UART runs from SMCLK.
+    power_need(POWER_CLIENT_IR, POWER_CLOCK_SMCLK);
+    UCA0IFG &= ~UCRXIFG;
+    UCA0IE |= UCRXIE;
+    ir_window_left = IR_WINDOW_TICKS;
+    ir_tx_allowed = 0;
+
+    if (ir_beacon_len) {
+        ir_queue_beacon();
+    }
+}
+
+/// Close our listening window, and shut the transceiver down.
+/**
+ ** This is only called while nothing is being sent. Anything still queued
+ ** waits for the next window.
+ */
+static void ir_window_close() {
+    ir_tx_allowed = 0;
+    // A shut down transceiver doesn't drive RXD, so don't listen to it.
+    UCA0IE &= ~UCRXIE;
+    P1OUT |= BIT6; // SD high: transceiver shut down.
+    power_need(POWER_CLIENT_IR, POWER_CLOCK_NONE);
+}
+
+/// Pick where in the cycle that's starting our window goes.
+static void ir_place_window() {
+    if (!ir_shared) {
+        ir_window_start = ir_rand() % (IR_CYCLE_TICKS - IR_WINDOW_TICKS);
+    } else if (rtc_seconds % IR_SHARED_CYCLES) {
+        ir_window_start = IR_CYCLE_TICKS; // No window this cycle.
+    } else {
+        ir_window_start = ((uint16_t) rtc_seconds * 40503u >> 8) % (IR_CYCLE_TICKS - IR_WINDOW_TICKS);
+    }
+}
+
+/// Join (if `shared`) or leave the window schedule shared by synced badges.
+void ir_set_shared_schedule(uint8_t shared) {
+    if (shared == ir_shared) {
+        return;
+    }
+    ir_shared = shared;
+    if (shared) {
+        ir_cycle_tick = rtc_centiseconds;
+    }
+    ir_place_window();
+}
+
+/// Run the duty cycle and the MAC, and drop partial frames that go quiet.
+/**
+ ** Call on every `EV_TIME_LOOP`, with the system ticks that have passed.
+ ** Without the timeout, a frame that was cut off would swallow the start of
+ ** the next one.
+ **
+ ** A window that's due to close is held open for as long as we're in the
+ ** middle of receiving or sending a frame. A frame that's only waiting out
+ ** the MAC's backoff doesn't hold it, so that a busy channel can't keep the
+ ** transceiver and SMCLK on; it stays queued for the next window instead.
+ ** `ir_ticks_needed()` keeps `ticks` at 1 whenever a window is open, and
+ ** makes sure that a longer step lands exactly on the start of the next
+ ** window.
+ */
+void ir_tick(uint8_t ticks) {
+    uint16_t gie = __get_SR_register() & GIE;
+    uint8_t rx_idle;
+
+    __bic_SR_register(GIE);
+    if (ir_rx_state != IR_RX_STATE_SYNC) {
+        ir_rx_silent_ticks += ticks;
+        if (ir_rx_silent_ticks >= IR_RX_TIMEOUT_TICKS) {
+            ir_rx_abort();
+        }
+    }
+    rx_idle = ir_rx_state == IR_RX_STATE_SYNC;
+    if (ir_mac_sense_ticks > ticks) {
+        ir_mac_sense_ticks -= ticks;
+    } else {
+        ir_mac_sense_ticks = 0;
+    }
+    __bis_SR_register(gie);
+
+    ir_cycle_tick += ticks;
+    if (ir_cycle_tick >= IR_CYCLE_TICKS) {
+        ir_cycle_tick -= IR_CYCLE_TICKS;
+        ir_place_window();
+    }
+    if (ir_shared) {
+        // The cycle is the second; stay lined up with it.
+        ir_cycle_tick = rtc_centiseconds;
+    }
+
+    if (ir_window_left) {
+        if (ir_window_left == IR_WINDOW_TICKS - IR_WINDOW_TX_DELAY_TICKS) {
+            ir_tx_allowed = 1;
+        }
+
+        ir_mac_tick();
+
+        if (ir_window_left > 1) {
+            ir_window_left--;
+        } else if (rx_idle && !ir_tx_active) {
+            ir_window_left = 0;
+            ir_window_close();
+        }
+    } else if (ir_cycle_tick == ir_window_start) {
+        ir_window_open();
+    }
+}
+
+/// Returns the number of system ticks until `ir_tick()` has something to do.
+/**
+ ** The link needs every tick while a window is open or a frame is coming in.
+ ** Otherwise it can sleep until its next window opens, or until the end of
+ ** the cycle, when the next window's start is picked.
+ */
+uint8_t ir_ticks_needed() {
+    if (ir_window_left || ir_rx_state != IR_RX_STATE_SYNC || ir_mac_sense_ticks) {
+        return 1;
+    }
+
+    if (ir_cycle_tick < ir_window_start) {
+        return ir_window_start - ir_cycle_tick;
+    }
+    return IR_CYCLE_TICKS - ir_cycle_tick;
+}
+
+/// Check and dispatch every complete frame that the ISR has received.
+/**
+ ** This should be called from the main loop on `EV_IR_RX`. Each
+ ** frame is handed to `badge_ir_rx()` where it sits in the pool, so the
+ ** payload is only valid until the handler returns, at which point its slot
+ ** is released. Frames with a bad CRC are dropped, and only counted.
+ */
+void ir_handle_rx() {
+    ir_packet_t *packet;
+    uint8_t slot;
+
+    while (ir_rx_tail != ir_rx_head) {
+        slot = ir_rx_queue[ir_rx_tail & (IR_QUEUE_LEN-1)];
+        ir_rx_tail++;
+        packet = &ir_pool[slot];
+
+        if (packet->crc == ir_crc16(packet->len, packet->payload)) {
+            ir_stats.rx_frames++;
+            badge_ir_rx(packet->payload, packet->len);
+        } else {
+            ir_stats.rx_bad_crc++;
+        }
+
+        ir_packet_release(packet);
+    }
+}
+
+/// Handle a received byte, framing it into the pool.
+static inline void ir_rx_byte(uint8_t rx_byte) {
+    ir_packet_t *packet;
+
+    ir_rx_silent_ticks = 0;
+    // Anything at all that we hear means somebody's talking.
+    ir_mac_sense_ticks = IR_MAC_SENSE_TICKS;
+
+    switch (ir_rx_state) {
+    case IR_RX_STATE_SYNC:
+        if (rx_byte != IR_SYNC_BYTE) {
+            break;
+        }
+        for (uint8_t i=0; i<IR_POOL_SLOTS; i++) {
+            if (ir_pool_state[i] == IR_SLOT_FREE) {
+                ir_pool_state[i] = IR_SLOT_RX;
+                ir_rx_slot = i;
+                ir_rx_state = IR_RX_STATE_LEN;
+                return;
+            }
+        }
+        // Nowhere to put it.
+        ir_stats.rx_overflows++;
+        break;
+    case IR_RX_STATE_LEN:
+        // Drop the frame if it's nonsense.
+        if (!rx_byte || rx_byte > IR_PAYLOAD_MAX) {
+            ir_rx_abort();
+            break;
+        }
+        ir_pool[ir_rx_slot].len = rx_byte;
+        ir_rx_pos = 0;
+        ir_rx_state = IR_RX_STATE_BODY;
+        break;
+    case IR_RX_STATE_BODY:
+        packet = &ir_pool[ir_rx_slot];
+        if (ir_rx_pos < packet->len) {
+            packet->payload[ir_rx_pos++] = rx_byte;
+            break;
+        } else if (ir_rx_pos == packet->len) {
+            packet->crc = (uint16_t) rx_byte << 8;
+            ir_rx_pos++;
+            break;
+        }
+        packet->crc |= rx_byte;
+
+        // Frame complete; hand it to the main loop.
+        ir_pool_state[ir_rx_slot] = IR_SLOT_APP;
+        ir_rx_queue[ir_rx_head & (IR_QUEUE_LEN-1)] = ir_rx_slot;
+        ir_rx_head++;
+        ir_rx_slot = IR_NO_SLOT;
+        ir_rx_state = IR_RX_STATE_SYNC;
+        badge_events |= EV_IR_RX;
+        LPM4_EXIT;
+        break;
+    }
+}
+
+/// Get byte `pos` of `packet`'s frame, as it goes on the wire.
+static inline uint8_t ir_tx_byte(ir_packet_t *packet, uint8_t pos) {
+    if (!pos) {
+        return IR_SYNC_BYTE;
+    } else if (pos == 1) {
+        return packet->len;
+    } else if (pos < packet->len + 2) {
+        return packet->payload[pos-2];
+    } else if (pos == packet->len + 2) {
+        return packet->crc >> 8;
+    }
+    return packet->crc & 0xFF;
+}
+
+/// eUSCI_A0 (IrDA UART) interrupt service routine.
+#pragma vector=USCI_A0_VECTOR
+__interrupt void EUSCI_A0_ISR(void) {
+    uint8_t rx_byte;
+    ir_packet_t *packet;
+
+    TRACE_ISR_ENTER();
+    switch(__even_in_range(UCA0IV, USCI_UART_UCTXCPTIFG)) {
+    case USCI_UART_UCRXIFG:
+        // Check the error flags before reading RXBUF clears them.
+        if (UCA0STATW & (UCFE | UCOE | UCPE)) {
+            rx_byte = UCA0RXBUF;
+            if (!ir_tx_active) {
+                ir_mac_sense_ticks = IR_MAC_SENSE_TICKS;
+            }
+            ir_rx_abort();
+            break;
+        }
+        rx_byte = UCA0RXBUF;
+
+        // The transceiver can hear its own transmissions; ignore them.
+        if (ir_tx_active) {
+            break;
+        }
+
+        ir_rx_byte(rx_byte);
+        break;
+    case USCI_UART_UCTXIFG:
+        if (ir_tx_slot == IR_NO_SLOT && ir_tx_tail != ir_tx_head) {
+            ir_tx_slot = ir_tx_queue[ir_tx_tail & (IR_QUEUE_LEN-1)];
+            ir_tx_tail++;
+            ir_tx_pos = 0;
+        }
+        if (ir_tx_slot != IR_NO_SLOT) {
+            packet = &ir_pool[ir_tx_slot];
+            UCA0TXBUF = ir_tx_byte(packet, ir_tx_pos++);
+            if (ir_tx_pos == packet->len + IR_FRAME_OVERHEAD) {
+                // That's the whole frame loaded; its slot can go back.
+                ir_pool_state[ir_tx_slot] = IR_SLOT_FREE;
+                ir_tx_slot = IR_NO_SLOT;
+            }
+            break;
+        }
+        // Nothing left to load; wait for the last byte to finish.
+        UCA0IE &= ~UCTXIE;
+        UCA0IFG &= ~UCTXCPTIFG;
+        UCA0IE |= UCTXCPTIE;
+        break;
+    case USCI_UART_UCTXCPTIFG:
+        if (UCA0IE & UCTXIE) {
+            // More was queued in the meantime.
+            break;
+        }
+        UCA0IE &= ~UCTXCPTIE;
+        ir_tx_active = 0;
+        TRACE_UART_DONE();
+        break;
+    default:
+        break;
+    }
+    TRACE_ISR_EXIT();
+}
+
+#else
+
+// The CapTIvate UART interface has UCA0, so there's no IR in this build.
+
+ir_stats_t ir_stats = {0,};
+
+void ir_init() {
+    P1OUT |= BIT6; // SD high: keep the transceiver shut down.
+}
+
+void ir_set_smclk_mhz(uint8_t smclk_mhz) {
+}
+
+ir_packet_t *ir_packet_alloc() {
+    return 0;
+}
+
+void ir_packet_release(ir_packet_t *packet) {
+}
+
+void ir_packet_send(ir_packet_t *packet) {
+}
+
+uint8_t ir_send(const uint8_t *payload, uint8_t len) {
+    return 0;
+}
+
+uint8_t ir_tx_busy() {
+    return 0;
+}
+
+void ir_set_beacon(const uint8_t *payload, uint8_t len) {
+}
+
+void ir_set_shared_schedule(uint8_t shared) {
+}
+
+void ir_tick(uint8_t ticks) {
+}
+
+uint8_t ir_ticks_needed() {
+    return 0xff;
+}
+
+void ir_handle_rx() {
+}
 
+#endif
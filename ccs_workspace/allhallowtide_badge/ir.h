@@ -9,6 +9,103 @@
 #ifndef IR_H_
 #define IR_H_
 
+#include <stdint.h>
 
+#include "captivate.h"
+
+/// True if this build has the IR link.
+/**
+ ** The IR transceiver is on UCA0, which is also what the CapTIvate Design
+ ** Center UART interface uses. Only one of them can have it, so when
+ ** CapTIvate is configured for the UART interface, the IR link is left out.
+ */
+#define IR_ENABLE (CAPT_INTERFACE != __CAPT_UART_INTERFACE__)
+
+/// First byte of every IR frame.
+#define IR_SYNC_BYTE 0xAC
+/// The largest payload that can be sent in a single frame.
+#define IR_PAYLOAD_MAX 32
+/// Bytes that framing adds to a payload: sync, length, and CRC-16.
+#define IR_FRAME_OVERHEAD 4
+/// Number of packet slots shared by receive and transmit.
+#define IR_POOL_SLOTS 4
+/// Length of the queues of slot numbers. Must be a power of 2, and at least
+///  `IR_POOL_SLOTS`.
+#define IR_QUEUE_LEN 4
+
+#if (IR_QUEUE_LEN & (IR_QUEUE_LEN - 1)) || IR_QUEUE_LEN > 256
+#error "IR_QUEUE_LEN must be a power of 2, and at most 256"
+#endif
+#if IR_QUEUE_LEN < IR_POOL_SLOTS
+#error "IR_QUEUE_LEN must be at least IR_POOL_SLOTS"
+#endif
+#if IR_PAYLOAD_MAX > 255
+#error "IR_PAYLOAD_MAX must fit in the frame's length byte"
+#endif
+/// System ticks of silence, in the middle of a frame, before we drop it.
+#define IR_RX_TIMEOUT_TICKS 2
+/// System ticks in each IR listen/beacon cycle.
+#define IR_CYCLE_TICKS 100
+/// System ticks per cycle that the transceiver is powered and listening.
+#define IR_WINDOW_TICKS 8
+/// On the shared schedule, we only listen in one cycle out of this many.
+#define IR_SHARED_CYCLES 4
+/// System ticks at the start of a window before we're allowed to transmit.
+/**
+ ** This gives the transceiver time to come out of shutdown, and gives the
+ ** other badges' windows a chance to open before our beacon goes out.
+ */
+#define IR_WINDOW_TX_DELAY_TICKS 1
+/// System ticks after hearing a byte that we still consider the channel busy.
+#define IR_MAC_SENSE_TICKS 2
+/// Times we'll find the channel busy and back off before dropping our frames.
+#define IR_MAC_MAX_RETRIES 6
+/// Cap on the backoff exponent; backoff is at most 2^this system ticks.
+#define IR_MAC_MAX_BACKOFF_EXP 5
+
+/// One IR frame, as it sits in the packet pool.
+/**
+ ** The ISR receives straight into these and transmits straight out of them,
+ ** so a payload is never copied on its way between the UART and its user.
+ */
+typedef struct {
+    /// Number of bytes in `payload`.
+    uint8_t len;
+    /// The frame's payload.
+    uint8_t payload[IR_PAYLOAD_MAX];
+    /// CRC-16 of `len` and `payload`.
+    uint16_t crc;
+} ir_packet_t;
+
+/// Counters for how the IR link is doing, for diagnostics.
+typedef struct {
+    /// Frames queued to be sent.
+    uint16_t tx_frames;
+    /// Times we found the channel busy and backed off.
+    uint16_t tx_backoffs;
+    /// Frames dropped after `IR_MAC_MAX_RETRIES` backoffs.
+    uint16_t tx_dropped;
+    /// Frames received with a good CRC.
+    uint16_t rx_frames;
+    /// Frames received with a bad CRC.
+    uint16_t rx_bad_crc;
+    /// Frames dropped because the receive buffer was full.
+    uint16_t rx_overflows;
+} ir_stats_t;
+
+extern ir_stats_t ir_stats;
+
+void ir_init();
+void ir_set_smclk_mhz(uint8_t smclk_mhz);
+ir_packet_t *ir_packet_alloc();
+void ir_packet_release(ir_packet_t *packet);
+void ir_packet_send(ir_packet_t *packet);
+uint8_t ir_send(const uint8_t *payload, uint8_t len);
+uint8_t ir_tx_busy();
+void ir_set_beacon(const uint8_t *payload, uint8_t len);
+void ir_set_shared_schedule(uint8_t shared);
+void ir_tick(uint8_t ticks);
+uint8_t ir_ticks_needed();
+void ir_handle_rx();
 
 #endif /* IR_H_ */
@@ -0,0 +1,466 @@
+/// High-level LED animation module.
+/**
+ ** This module drives keyframe animations off of the system tick from the
+ ** RTC, and hands the resulting colors to the HT16D35A driver. Animations are
+ ** packed, const `leds_animation_t`s, which the linker leaves in FRAM. They're
+ ** unpacked one keyframe at a time, as each fade starts, into the one frame of
+ ** colors we keep in RAM, so no animation is ever unpacked as a whole.
+ **
+ ** Between two keyframes, every LED whose color changes is interpolated
+ ** linearly in Q15 fixed point. The reciprocal of each keyframe's duration is
+ ** packed in with it, worked out at compile time, so playing an animation
+ ** only ever multiplies (using the hardware multiplier) and never divides.
+ ** LEDs that aren't changing between the current pair of keyframes aren't
+ ** touched at all, so the per-tick cost scales with the number of LEDs
+ ** actually moving.
+ **
+ ** This module also powers the LED controller down when there's been nothing
+ ** to show for a while, and back up on the next commit with something lit,
+ ** and it picks the controller's brightness settings to suit the situation.
+ **
+ ** \file leds.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <QmathLib.h>
+
+#include "badge.h"
+#include "ht16d35a.h"
+#include "rtc.h"
+
+#include "leds.h"
+
+/// The animation currently being played, or 0 if none.
+const leds_animation_t *leds_animation = 0;
+/// Index of the keyframe we're currently fading towards.
+uint8_t leds_frame_index = 0;
+/// The keyframe we're currently fading towards, in `leds_animation->frames`.
+const uint8_t *leds_frame_this = 0;
+/// The next keyframe to unpack, in `leds_animation->frames`.
+const uint8_t *leds_frame_next = 0;
+/// System ticks elapsed since we started fading towards the current frame.
+uint16_t leds_elapsed = 0;
+/// Each LED's color in the keyframe we're fading towards.
+rgbcolor16_t leds_frame_colors[HT16D_LED_COUNT];
+/// System ticks to fade to the current keyframe.
+uint8_t leds_frame_duration = 0;
+/// Q15 reciprocal of `leds_frame_duration`, so `elapsed * recip` is progress.
+_q15 leds_frame_recip = 0;
+
+/// Each LED's color at the start of the current fade.
+rgbcolor16_t leds_start_colors[HT16D_LED_COUNT];
+/// Each LED's per-channel change, start to end, over the current fade.
+int16_t leds_deltas[HT16D_LED_COUNT][3];
+/// Bitmask of LEDs that differ between the previous and current keyframe.
+ht16d_mask_t leds_moving = 0;
+/// System ticks left for the LED controller to breathe, or 0 if it isn't.
+uint16_t leds_breathe_left = 0;
+
+/// Which of the `LEDS_POWER_*` states the LED controller is in.
+uint8_t leds_power = LEDS_POWER_ON;
+/// Consecutive system ticks for which every LED has been dark.
+uint16_t leds_dark_ticks = 0;
+
+/// LED controller settings for each brightness level, dimmest first.
+/**
+ ** Each level is a global brightness (PWM duty) and a constant current
+ ** ratio. Dimming is done with the duty cycle, since the current ratio can
+ ** only go from full current down to 9/16; above the default, the extra
+ ** headroom comes from the current ratio instead.
+ */
+const uint8_t leds_brightness_table[LEDS_BRIGHTNESS_LEVELS][2] = {
+    {0x08, HT16D_I_RATIO_DEFAULT},
+    {0x10, HT16D_I_RATIO_DEFAULT},
+    {0x20, HT16D_I_RATIO_DEFAULT},
+    {HT16D_BRIGHTNESS_DEFAULT, HT16D_I_RATIO_DEFAULT},
+    {HT16D_BRIGHTNESS_MAX, HT16D_I_RATIO_DEFAULT},
+    {HT16D_BRIGHTNESS_MAX, 0b0101},
+};
+
+/// The brightness level that the LED controller is currently set to.
+uint8_t leds_brightness_level = LEDS_BRIGHTNESS_DEFAULT;
+
+/// Multiply two Q15 values.
+/**
+ ** This is equivalent to QmathLib's `_Q15mpy()`, but inline, because that
+ ** library isn't linked into the CCS build and the call overhead would
+ ** dominate this anyway.
+ */
+static inline _q15 leds_q15mpy(_q15 a, _q15 b) {
+    return (_q15)(((int32_t) a * b) >> 15);
+}
+
+/// Unpack the next keyframe, and begin fading to it from the last one.
+/**
+ ** This runs once per keyframe, not once per tick, and it's the only place
+ ** that walks every LED. `leds_frame_colors` goes from the last keyframe's
+ ** colors to this one's, and each LED that changes is set up to fade.
+ */
+static void leds_load_frame() {
+    const rgbcolor16_t *palette = leds_animation->palette;
+    const uint8_t *next = leds_frame_next;
+    uint8_t run = 0;
+    uint8_t index = LEDS_KEEP;
+
+    leds_frame_this = next;
+    leds_moving = 0;
+    leds_elapsed = 0;
+    leds_frame_duration = *next++;
+    leds_frame_recip = (_q15) (next[0] | ((uint16_t) next[1] << 8));
+    next += 2;
+
+    for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
+        if (!run) {
+            run = (*next >> 5) + 1;
+            index = *next++ & 0x1f;
+        }
+        run--;
+
+        if (index == LEDS_KEEP) {
+            continue;
+        }
+
+        rgbcolor16_t *from = &leds_frame_colors[i];
+        const rgbcolor16_t *to = &palette[index];
+
+        if (from->r == to->r && from->g == to->g && from->b == to->b) {
+            continue;
+        }
+
+        leds_start_colors[i] = *from;
+        leds_deltas[i][0] = (int16_t) to->r - (int16_t) from->r;
+        leds_deltas[i][1] = (int16_t) to->g - (int16_t) from->g;
+        leds_deltas[i][2] = (int16_t) to->b - (int16_t) from->b;
+        leds_moving |= (ht16d_mask_t) 1 << i;
+        *from = *to;
+    }
+
+    leds_frame_next = next;
+}
+
+/// Set every LED to exactly the colors of the current keyframe.
+static void leds_put_frame() {
+    ht16d_put_colors(0, HT16D_LED_COUNT, leds_frame_colors);
+}
+
+/// Send the current colors, waking the LED controller if they aren't dark.
+/**
+ ** Everything in this module that changes the colors should commit them
+ ** through here rather than with `ht16d_send_gray()` directly, so that a
+ ** display we powered down comes back as soon as there's something to show.
+ ** The frame is queued ahead of the wakeup, so it's never shown stale.
+ */
+void leds_commit() {
+    ht16d_send_gray();
+
+    if (ht16d_all_dark()) {
+        return;
+    }
+
+    leds_dark_ticks = 0;
+    if (leds_power != LEDS_POWER_ON) {
+        ht16d_display_on();
+        leds_power = LEDS_POWER_ON;
+    }
+}
+
+/// Power down the LED controller in stages while it's been dark long enough.
+/**
+ ** The display is turned off after `LEDS_DARK_OFF_TICKS`, and the whole
+ ** controller is put in standby after `LEDS_DARK_STANDBY_TICKS`. Anything
+ ** the controller is fading or blinking by itself counts as lit.
+ */
+static void leds_power_timestep(uint8_t ticks) {
+    if (!ht16d_all_dark() || ht16d_hw_effects_active()) {
+        leds_dark_ticks = 0;
+        return;
+    }
+
+    if (leds_dark_ticks < LEDS_DARK_STANDBY_TICKS) {
+        leds_dark_ticks += ticks;
+    }
+
+    if (leds_dark_ticks >= LEDS_DARK_STANDBY_TICKS) {
+        if (leds_power != LEDS_POWER_STANDBY) {
+            ht16d_standby();
+            leds_power = LEDS_POWER_STANDBY;
+        }
+    } else if (leds_dark_ticks >= LEDS_DARK_OFF_TICKS) {
+        if (leds_power == LEDS_POWER_ON) {
+            ht16d_display_off();
+            leds_power = LEDS_POWER_DISPLAY_OFF;
+        }
+    }
+}
+
+/// Start playing `animation` from its first keyframe.
+/**
+ ** The first keyframe is shown immediately; its duration is how long it
+ ** holds before fading into the second (or, if looping, how long the last
+ ** keyframe takes to fade back into it).
+ */
+void leds_start(const leds_animation_t *animation) {
+    if (!animation || !animation->frame_count) {
+        leds_stop();
+        return;
+    }
+
+    // Take the display back from any effect the controller is running.
+    leds_breathe_left = 0;
+    ht16d_hw_effects_stop();
+
+    leds_animation = animation;
+    leds_frame_index = 0;
+    leds_frame_next = animation->frames;
+    for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
+        leds_frame_colors[i].r = 0;
+        leds_frame_colors[i].g = 0;
+        leds_frame_colors[i].b = 0;
+    }
+    leds_load_frame();
+    leds_put_frame();
+    leds_moving = 0;
+    leds_commit();
+}
+
+/// Stop animating, leaving the LEDs showing whatever they currently show.
+/**
+ ** If the controller was breathing, that stops too, and the LEDs hold the
+ ** colors it was breathing.
+ */
+void leds_stop() {
+    leds_animation = 0;
+    leds_moving = 0;
+    if (leds_breathe_left) {
+        leds_breathe_left = 0;
+        ht16d_hw_effects_stop();
+    }
+}
+
+/// Stop animating, and save where we were into `resume`.
+/**
+ ** The LEDs keep showing whatever they currently show.
+ */
+void leds_suspend(leds_resume_t *resume) {
+    resume->animation = leds_animation;
+    resume->frame = leds_frame_this;
+    resume->frame_index = leds_frame_index;
+    leds_stop();
+}
+
+/// Pick a suspended animation back up where `leds_suspend()` left it.
+/**
+ ** Rather than jumping back to the colors it was showing, it fades from
+ ** the last keyframe shown since into the keyframe it was fading towards,
+ ** and carries on from there. LEDs that keyframe keeps stay as they are.
+ */
+void leds_resume(const leds_resume_t *resume) {
+    if (!resume->animation) {
+        return;
+    }
+
+    leds_breathe_left = 0;
+    ht16d_hw_effects_stop();
+
+    leds_animation = resume->animation;
+    leds_frame_index = resume->frame_index;
+    leds_frame_next = resume->frame;
+    leds_load_frame();
+}
+
+/// Show `colors` and leave the LED controller to breathe them by itself.
+/**
+ ** This is for idle bling: the HT16D35A ramps every LED in and out every
+ ** `cycle` (one of `HT16D_HW_CYCLE_*`), offset by `stagger` quarter cycles
+ ** per LED, so there's no per-tick work for us at all and the MCU can stay
+ ** asleep. After `ticks` system ticks, the LEDs go dark. Any software
+ ** animation is stopped, and starting one with `leds_start()`, or calling
+ ** `leds_stop()`, ends the breathing early.
+ */
+void leds_breathe(const rgbcolor16_t *colors, uint8_t cycle, uint8_t stagger, uint16_t ticks) {
+    leds_stop();
+    for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
+        leds_frame_colors[i] = colors[i];
+    }
+    leds_put_frame();
+    leds_commit();
+    ht16d_hw_fade(HT16D_ALL_LEDS, 1, cycle, stagger);
+    leds_breathe_left = ticks;
+}
+
+/// Count down the breathing by `ticks`, and go dark once it's over.
+static void leds_breathe_timestep(uint8_t ticks) {
+    if (ticks < leds_breathe_left) {
+        leds_breathe_left -= ticks;
+        return;
+    }
+
+    leds_breathe_left = 0;
+    ht16d_hw_effects_stop();
+    for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
+        leds_frame_colors[i].r = 0;
+        leds_frame_colors[i].g = 0;
+        leds_frame_colors[i].b = 0;
+    }
+    leds_put_frame();
+    leds_commit();
+}
+
+/// Returns nonzero if the LED controller is breathing, from `leds_breathe()`.
+uint8_t leds_is_breathing() {
+    return leds_breathe_left != 0;
+}
+
+/// Returns nonzero if an animation is currently playing.
+uint8_t leds_is_animating() {
+    return leds_animation != 0;
+}
+
+/// Returns the number of system ticks until this module has something to do.
+/**
+ ** An animation needs every tick, and breathing needs the tick it ends on.
+ ** Otherwise, the only thing to wait for is the next step in powering down
+ ** the controller, and once that's done (or if anything is lit), this
+ ** returns 0xff, meaning the LEDs don't need ticks.
+ */
+uint8_t leds_ticks_needed() {
+    if (leds_animation) {
+        return 1;
+    }
+
+    if (leds_breathe_left) {
+        return leds_breathe_left < 0xfe ? leds_breathe_left : 0xfe;
+    }
+
+    if (leds_power == LEDS_POWER_STANDBY || !ht16d_all_dark() || ht16d_hw_effects_active()) {
+        return 0xff;
+    }
+
+    if (leds_dark_ticks < LEDS_DARK_OFF_TICKS) {
+        return LEDS_DARK_OFF_TICKS - leds_dark_ticks;
+    }
+
+    if (LEDS_DARK_STANDBY_TICKS - leds_dark_ticks > 0xfe) {
+        return 0xfe;
+    }
+    return LEDS_DARK_STANDBY_TICKS - leds_dark_ticks;
+}
+
+/// Advance the current animation by `ticks` system ticks.
+/**
+ ** This should be called from the main loop on every `EV_TIME_LOOP`, with
+ ** the ticks from `rtc_take_ticks()`. That's 1 while animating, unless the
+ ** main loop has fallen behind. This is in the hot set; see `BADGE_HOT`.
+ */
+BADGE_HOT void leds_timestep(uint8_t ticks) {
+    _q15 progress;
+    rgbcolor16_t color;
+
+    leds_power_timestep(ticks);
+
+    if (!leds_animation) {
+        if (leds_breathe_left) {
+            leds_breathe_timestep(ticks);
+        }
+        return;
+    }
+
+    leds_elapsed += ticks;
+
+    if (leds_elapsed >= leds_frame_duration) {
+        // Snap exactly to this keyframe, and set up the next one.
+        leds_put_frame();
+
+        if (leds_frame_index+1 < leds_animation->frame_count) {
+            leds_frame_index++;
+        } else if (leds_animation->loop) {
+            leds_frame_index = 0;
+            leds_frame_next = leds_animation->frames;
+        } else {
+            leds_stop();
+            leds_commit();
+            return;
+        }
+
+        leds_load_frame();
+        leds_commit();
+        return;
+    }
+
+    if (!leds_moving) {
+        return;
+    }
+
+    progress = (_q15) (leds_elapsed * leds_frame_recip);
+
+    for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
+        if (!(leds_moving & ((ht16d_mask_t) 1 << i))) {
+            continue;
+        }
+
+        color.r = leds_start_colors[i].r + leds_q15mpy(leds_deltas[i][0], progress);
+        color.g = leds_start_colors[i].g + leds_q15mpy(leds_deltas[i][1], progress);
+        color.b = leds_start_colors[i].b + leds_q15mpy(leds_deltas[i][2], progress);
+        ht16d_put_colors(i, 1, &color);
+    }
+
+    leds_commit();
+}
+
+/// Set the user's preferred brightness level, from 0 to `LEDS_BRIGHTNESS_LEVELS`-1.
+/**
+ ** This is kept in `badge_conf.brightness`, so it lasts across resets.
+ */
+void leds_set_brightness_level(uint8_t level) {
+    if (level >= LEDS_BRIGHTNESS_LEVELS) {
+        level = LEDS_BRIGHTNESS_LEVELS-1;
+    }
+    if (level != badge_conf.brightness) {
+        badge_conf.brightness = level;
+        badge_conf_changed();
+    }
+    leds_brightness_update();
+}
+
+/// Pick the brightness level for the current context, and apply it.
+/**
+ ** This starts from the user's setting, and dims for the night. It only
+ ** talks to the LED controller if the level changes, so
+ ** it's cheap to call once per second, which main does. The brightness is
+ ** all done in the controller, so there's no per-frame scaling of the colors.
+ */
+void leds_brightness_update() {
+    // rtc_seconds starts at noon, so this is seconds after midnight.
+    uint32_t time_of_day = (rtc_seconds + 43200) % 86400;
+    int8_t level = badge_conf.brightness;
+
+    if (time_of_day >= LEDS_NIGHT_START_SECS || time_of_day < LEDS_NIGHT_END_SECS) {
+        level -= LEDS_NIGHT_DIM_LEVELS;
+    }
+
+    if (level < 0) {
+        level = 0;
+    }
+
+    if (level == leds_brightness_level) {
+        return;
+    }
+
+    if (leds_brightness_table[level][0] != leds_brightness_table[leds_brightness_level][0]) {
+        ht16d_set_global_brightness(leds_brightness_table[level][0]);
+    }
+    if (leds_brightness_table[level][1] != leds_brightness_table[leds_brightness_level][1]) {
+        ht16d_set_current_ratio(leds_brightness_table[level][1]);
+    }
+    leds_brightness_level = level;
+}
+
+/// Initialize the LED animation module, with nothing playing.
+void leds_init() {
+    leds_stop();
+    leds_brightness_update();
+}
@@ -0,0 +1,121 @@
+/// Header for the high-level LED animation module.
+/**
+ ** \file leds.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef LEDS_H_
+#define LEDS_H_
+
+#include <stdint.h>
+
+#include <QmathLib.h>
+
+#include "ht16d35a.h"
+
+/// Palette index that means an LED keeps its color from the last keyframe.
+#define LEDS_KEEP 31
+/// The most colors an animation's palette can have.
+#define LEDS_PALETTE_MAX 31
+/// The most LEDs a single run byte can cover.
+#define LEDS_RUN_MAX 8
+/// Run byte: the next `len` (1 to `LEDS_RUN_MAX`) LEDs fade to `palette[index]`.
+#define LEDS_RUN(len, index) ((uint8_t) ((((len)-1) << 5) | (index)))
+/// Run byte: the next `len` (1 to `LEDS_RUN_MAX`) LEDs keep their colors.
+#define LEDS_SKIP(len) LEDS_RUN(len, LEDS_KEEP)
+/// Keyframe list expansion: a keyframe's bytes, for `frames`.
+/**
+ ** An animation lists its keyframes once, as `FRAME(duration, runs...)`,
+ ** in a macro that takes `FRAME`. Expanded with this, that's the packed
+ ** `frames`; with `LEDS_FRAME_COUNT()`, after a 0, it's `frame_count`, so
+ ** the two can't disagree. The duration's reciprocal goes in after it,
+ ** worked out here by the compiler, so a duration of 0 doesn't compile.
+ */
+#define LEDS_FRAME_BYTES(duration, ...) duration, \
+        LEDS_FRAME_RECIP(duration) & 0xff, LEDS_FRAME_RECIP(duration) >> 8, \
+        __VA_ARGS__,
+/// Q15 reciprocal of a keyframe's `duration`, as packed after it.
+#define LEDS_FRAME_RECIP(duration) (0x7fff / (duration))
+/// Keyframe list expansion: one more keyframe; see `LEDS_FRAME_BYTES()`.
+#define LEDS_FRAME_COUNT(duration, ...) + 1
+
+/// System ticks that the LEDs must be dark before we turn the display off.
+/**
+ ** This is long enough that an animation passing through black doesn't
+ ** turn the display off and right back on again.
+ */
+#define LEDS_DARK_OFF_TICKS 25
+/// System ticks that the LEDs must be dark before the controller sleeps.
+#define LEDS_DARK_STANDBY_TICKS 200
+
+/// The LED controller is on and displaying.
+#define LEDS_POWER_ON 0
+/// The LED controller's display is off, but its oscillator is running.
+#define LEDS_POWER_DISPLAY_OFF 1
+/// The LED controller is in standby.
+#define LEDS_POWER_STANDBY 2
+
+/// The number of user-selectable brightness levels.
+#define LEDS_BRIGHTNESS_LEVELS 6
+/// The default brightness level, matching the LED controller's defaults.
+#define LEDS_BRIGHTNESS_DEFAULT 3
+/// Seconds after midnight at which we start dimming for the night.
+#define LEDS_NIGHT_START_SECS (22UL*3600)
+/// Seconds after midnight at which we stop dimming for the night.
+#define LEDS_NIGHT_END_SECS (7UL*3600)
+/// Brightness levels to drop by at night, when the LEDs look brighter.
+#define LEDS_NIGHT_DIM_LEVELS 1
+
+/// A const (FRAM-resident), packed sequence of keyframes.
+/**
+ ** Each keyframe in `frames` is a byte of duration, in system ticks (10 ms
+ ** each, 1 to 255) to fade from the previous keyframe to this one, and that
+ ** duration's Q15 reciprocal, little endian (see `LEDS_FRAME_RECIP()`), so
+ ** that nothing has to divide to play it. Then come run bytes (see
+ ** `LEDS_RUN()`) that cover every LED in order. A run
+ ** either sets its LEDs to a palette color, or (with `LEDS_KEEP`) leaves
+ ** them as they were in the previous keyframe, so a keyframe only costs
+ ** bytes for the LEDs that change.
+ **
+ ** Palette colors are in `rgbcolor16_t`, but only the low 15 bits are
+ ** significant, so that each channel is a non-negative Q15 brightness
+ ** fraction. LEDs an animation's first keyframe keeps start out black.
+ */
+typedef struct {
+    /// The colors the run bytes index, at most `LEDS_PALETTE_MAX`.
+    const rgbcolor16_t *palette;
+    /// The packed keyframes, `frame_count` of them, back to back.
+    const uint8_t *frames;
+    /// The number of keyframes in `frames`.
+    uint8_t frame_count;
+    /// Nonzero to restart from the first keyframe after the last one.
+    uint8_t loop;
+} leds_animation_t;
+
+/// Where a suspended animation left off, so that it can pick back up.
+typedef struct {
+    /// The animation, or 0 if nothing was playing.
+    const leds_animation_t *animation;
+    /// The packed keyframe it was fading towards.
+    const uint8_t *frame;
+    /// The index of that keyframe.
+    uint8_t frame_index;
+} leds_resume_t;
+
+void leds_init();
+void leds_start(const leds_animation_t *animation);
+void leds_stop();
+void leds_suspend(leds_resume_t *resume);
+void leds_resume(const leds_resume_t *resume);
+void leds_breathe(const rgbcolor16_t *colors, uint8_t cycle, uint8_t stagger, uint16_t ticks);
+uint8_t leds_is_breathing();
+uint8_t leds_is_animating();
+void leds_commit();
+void leds_set_brightness_level(uint8_t level);
+void leds_brightness_update();
+uint8_t leds_ticks_needed();
+void leds_timestep(uint8_t ticks);
+
+#endif /* LEDS_H_ */
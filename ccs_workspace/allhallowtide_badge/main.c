@@ -7,10 +7,11 @@
  ** (primarily) the badge.c module.
  **
  ** The basic split in responsibility between the badge.c and main.c modules
- ** is that main.c detects, prioritizes, and clears flags set from
- ** interrupts; it then calls the appropriate function in badge.c so that
- ** badge.c can behave in a more event-driven way, with the underlying MSP430
- ** hardware and registers abstracted away by main.c for the most part.
+ ** is that main.c detects, prioritizes, and clears events posted from
+ ** interrupts (the `EV_*` bits of `badge_events`); it then calls the
+ ** appropriate function in badge.c so that badge.c can behave in a more
+ ** event-driven way, with the underlying MSP430 hardware and registers
+ ** abstracted away by main.c for the most part.
  **
  ** \file main.c
  ** \author George Louthan
@@ -32,26 +33,59 @@
 #include "CAPT_App.h"
 
 // Local
+#include "clock.h"
+#include "console.h"
+#include "deadline.h"
 #include "ht16d35a.h"
-//#include "leds.h" // TODO:
+#include "input.h"
+#include "ir.h"
+#include "power.h"
+#include "prof.h"
+#include "leds.h"
 #include "rtc.h"
-//#include "serial.h"
+#include "sched.h"
+#include "selftest.h"
+#include "temp.h"
+#include "trace.h"
+#include "wdt.h"
 #include "badge.h"
 //#include "animations.h"
 
-/// Current button state (1 for pressed, 2 long-pressed, 0 not pressed).
-uint8_t button_state;
+/// Bitmask of `EV_*` events posted by interrupts, and not yet handled.
+volatile uint16_t badge_events;
 
-/// Interrupt flag for the system clock tick.
-volatile uint8_t f_time_loop;
-/// Interrupt flag for the button being held for over 1 second.
-volatile uint8_t f_long_press;
-/// Interrupt flag that ticks every second.
-volatile uint8_t f_second;
-/// Interrupt flag from the ADC indicating the badge is hot.
-volatile uint8_t f_hot;
-/// Interrupt flag from the ADC indicating the badge is cold.
-volatile uint8_t f_cold;
+/// Boot stage: the DCO still needs its software trim.
+#define BOOT_STAGE_TRIM 0
+/// Boot stage: CapTIvate still needs to be calibrated and started.
+#define BOOT_STAGE_CAPT 1
+/// Boot stage: the factory self-test, if it's armed, still needs to run.
+#define BOOT_STAGE_SELFTEST 2
+/// Boot stage: everything is up.
+#define BOOT_STAGE_DONE 3
+
+/// Which `BOOT_STAGE_*` the background part of startup has reached.
+/**
+ ** Only what it takes to get a frame on the display is done before the main
+ ** loop starts. The rest is done one stage per system tick, by
+ ** `boot_step()`, while the first animation is already running.
+ */
+uint8_t boot_stage = BOOT_STAGE_TRIM;
+
+/// Number of steps in `capt_scan_periods`.
+#define CAPT_SCAN_STEPS 3
+/// Scans in a row without proximity that it takes to slow down by one step.
+#define CAPT_IDLE_SCANS_PER_STEP 8
+
+/// CapTIvate active mode scan periods in ms, fastest first.
+/**
+ ** The first must match `g_uiApp.ui16ActiveModeScanPeriod`, since that's
+ ** what `CAPT_appHandler()` goes back to after wake-on-prox.
+ */
+const uint16_t capt_scan_periods[CAPT_SCAN_STEPS] = {33, 66, 100};
+/// Which of `capt_scan_periods` the CapTIvate timer is set to.
+uint8_t capt_scan_step = 0;
+/// Scans in a row without proximity on any sensor.
+uint8_t capt_idle_scans = 0;
 
 /// Perform the TI-recommended software trim of the DCO per TI demo code.
 void dco_software_trim()
@@ -116,6 +150,7 @@ void dco_software_trim()
             bestDcoDelta = newDcoDelta;
         }
 
+        wdt_op_yield();
     }while(endLoop == 0);                      // Poll until endLoop == 1
 
     CSCTL0 = csCtl0Copy;                       // Reload locked DCOTAP
@@ -144,6 +179,17 @@ void dco_software_trim()
  **
  ** So the only change we need to make is to the DCO and MCLK.
  **
+ ** The FLL locks the DCO by itself, so this doesn't wait for the software
+ ** trim, which takes several FLL lock times. `boot_step()` does that once
+ ** the display is already lit.
+ **
+ ** Everything that runs while we sleep (the RTC, the CapTIvate timer, and
+ ** the watchdog) is on ACLK, so that we can sleep in LPM3, with the DCO off.
+ ** SMCLK is only needed while a SPI or UART transfer is in flight, and
+ ** `power_sleep()` works out which mode is safe each time we sleep.
+ **
+ ** This is the burst clock profile. While nothing is animating, clock.c
+ ** divides MCLK (and so SMCLK) down to 1 MHz, without touching the DCO.
  */
 void init_clocks() {
 
@@ -153,7 +199,6 @@ void init_clocks() {
     CSCTL2 = FLLD_0 + 243;                  // DCODIV = 8MHz
     __delay_cycles(3);
     __bic_SR_register(SCG0);                // enable FLL
-    dco_software_trim();                        // Software Trim to get the best DCOFTRIM value
 
     CSCTL4 = SELMS__DCOCLKDIV | SELA__REFOCLK; // set default REFO(~32768Hz) as ACLK source, ACLK = 32768Hz
 
@@ -172,13 +217,14 @@ void init_io() {
     // P1.0     CSN GPIO    (SEL 00; DIR 1)
     // P1.1     UCB0 SCLK   (SEL 01; DIR 1)
     // P1.2     UCB0SIMO    (SEL 01; DIR 1)
-    // P1.3     unused      (SEL 00; DIR 1)
+    // P1.3     UCB0SOMI    (SEL 00; DIR 1) (awake trace pin, see trace.h;
+    //                                   only SOMI while ht16d35a.c reads)
     // P1.4     UCA0 TXD    (SEL 01; DIR 1)
     // P1.5     UCA0 RXD    (SEL 01; DIR 0)
     // P1.6     IR SD GPIO  (SEL 00; DIR 1)
-    // P1.7     unused      (SEL 00; DIR 1)
+    // P1.7     unused      (SEL 00; DIR 1) (ISR trace pin)
 
-    // P2 Unused
+    // P2 Unused (P2.0 and P2.1 are SPI and UART trace pins)
     // P3 Unused
 
     // CAP0.1, 2.0, and 3.1 are dedicated to CapTIvate
@@ -209,188 +255,294 @@ void init_io() {
     PM5CTL0 &= ~LOCKLPM5;
 }
 
-/// Initialize the ADC for trigger based sampling of onboard temperature.
-void init_adc() {
-    ADCCTL0 |= ADCSHT_8 | ADCON;                                  // ADC ON,temperature sample period>30us
-    ADCCTL1 |= ADCSHP;                                            // s/w trig, single ch/conv, MODOSC
-    ADCCTL2 |= ADCRES;                                            // 10-bit conversion results
-    ADCMCTL0 |= ADCSREF_1 | ADCINCH_12;                           // ADC input ch A12 => temp sense
-    ADCIE |=ADCIE0;                                               // Enable the Interrupt request for a completed ADC_B conversion
+/// Returns true if CapTIvate has flagged something for `CAPT_appHandler()`.
+/**
+ ** This is the CapTIvate task's run condition. CapTIvate's ISR is library
+ ** code that only sets its own flags, which `CAPT_appHandler()` clears
+ ** once it's dealt with them.
+ **
+ ** While scanning actively, that's the scan timer. In wake-on-prox, the
+ ** hardware scans the nose by itself, and only a detection, the periodic
+ ** wakeup (conversion counter), or a max count error wakes the CPU.
+ */
+static uint8_t capt_pending() {
+    if (boot_stage < BOOT_STAGE_DONE) {
+        return 0;
+    }
+    if (g_uiApp.state == eUIWakeOnProx) {
+        return g_bDetectionFlag || g_bConvCounterFlag || g_bMaxCountErrorFlag;
+    }
+    return g_bConvTimerFlag;
+}
 
-    // Configure reference
-    PMMCTL0_H = PMMPW_H;                                          // Unlock the PMM registers
-    PMMCTL2 |= INTREFEN | TSENSOREN;                              // Enable internal reference and temperature sensor
-    __delay_cycles(400);                                          // Delay for reference settling
+/// Slow the scan rate down in steps while nobody's touching the badge.
+/**
+ ** Any proximity puts it right back to the fastest rate, so the buttons
+ ** stay responsive while they're in use. Scanning current goes down with the
+ ** rate while they aren't. Once `CAPT_appHandler()` has gone to
+ ** wake-on-prox, the timer is its business, until it comes back at the
+ ** fastest rate.
+ */
+static void capt_scan_update(bool activity) {
+    uint8_t step;
 
-}
+    if (g_uiApp.state != eUIActive) {
+        capt_scan_step = 0;
+        capt_idle_scans = 0;
+        return;
+    }
 
-/// Callback from CapTIvate for a change in the button state.
-void button_cb(tSensor *pSensor) {
+    if (activity) {
+        capt_idle_scans = 0;
+    } else if (capt_idle_scans < 0xff) {
+        capt_idle_scans++;
+    }
 
-    if((pSensor->bSensorTouch == true) && (pSensor->bSensorPrevTouch == false))
-    {
-        // Button press
-        button_state = 1;
-        rtc_button_csecs = rtc_centiseconds; // TODO
+    step = capt_idle_scans / CAPT_IDLE_SCANS_PER_STEP;
+    if (step >= CAPT_SCAN_STEPS) {
+        step = CAPT_SCAN_STEPS-1;
     }
 
-    if((pSensor->bSensorTouch == false) && (pSensor->bSensorPrevTouch == true))
-    {
-        // Button release
-        if (button_state == 1) {
-            badge_button_press_short();
+    if (step == capt_scan_step) {
+        return;
+    }
+
+    capt_scan_step = step;
+    MAP_CAPT_stopTimer();
+    MAP_CAPT_clearTimer();
+    MAP_CAPT_writeTimerCompRegister(CAPT_MS_TO_CYCLES(capt_scan_periods[step]));
+    MAP_CAPT_startTimer();
+}
+
+/// Do the next stage of startup that's been left for after the first frame.
+/**
+ ** The software trim moves the DCO around while it searches, so it waits for
+ ** a tick when nothing is clocking bits out of SMCLK. The LED controller
+ ** usually is, while the boot animation runs, but a full frame out of it
+ ** takes well under a tick.
+ */
+static void boot_step(uint16_t events) {
+    switch (boot_stage) {
+    case BOOT_STAGE_TRIM:
+        // Only the main loop starts anything on SMCLK, so once it's clear,
+        //  it stays clear until we're done.
+        ht16d_wait_idle();
+        if (power_lpm_bits() == LPM0_bits) {
+            return; // Try again next tick.
         }
-        button_state = 0;
+        wdt_op_begin(WDT_OP_DCO_TRIM);
+        dco_software_trim();
+        wdt_op_end();
+        break;
+    case BOOT_STAGE_CAPT:
+        // Bring up, calibrate, and start scanning the buttons.
+        CAPT_appStart();
+        input_init();
+        break;
+    case BOOT_STAGE_SELFTEST:
+        // This takes a step every tick, and is done right away if it's not
+        //  armed.
+        if (!selftest_step()) {
+            return;
+        }
+        break;
+    default:
+        return;
     }
+    boot_stage++;
 }
 
-/// Make snafucated.
-int main(void) {
-    WDTCTL = WDTPW | WDTHOLD; // Hold WDT.
+/// Returns the number of system ticks until anything needs the next one.
+/**
+ ** The RTC is scheduled with this whenever the main loop goes to sleep, so
+ ** the 100 Hz tick only runs while something is animating or listening.
+ ** Otherwise the RTC only wakes us as often as the next deadline needs it,
+ ** and at least once a second (to count seconds).
+ */
+static uint8_t badge_ticks_needed() {
+    uint8_t ticks = 100;
+    uint8_t needed;
 
-    // Configure board basics:
-    init_clocks();
-    init_io();
-    init_adc();
+    if (boot_stage < BOOT_STAGE_DONE) {
+        return 1;
+    }
 
-    // Enable interrupts.
-    __bis_SR_register(GIE);
+    needed = deadline_ticks_needed();
+    if (needed < ticks) {
+        ticks = needed;
+    }
 
-    // Configure mid-level drivers.
-    rtc_init(); // TODO
-    ht16d_init();
-//    serial_init(); // TODO
+    needed = leds_ticks_needed();
+    if (needed < ticks) {
+        ticks = needed;
+    }
 
-    // Initialize badge data and game.
-    badge_init();
+    needed = ir_ticks_needed();
+    if (needed < ticks) {
+        ticks = needed;
+    }
 
-    MAP_CAPT_initUI(&g_uiApp);
-    MAP_CAPT_calibrateUI(&g_uiApp);
-    MAP_CAPT_registerCallback(&BTN00_NOSE, &button_cb);
-    // TODO: Also BTN01_EYE
-    // TODO: Also BTN02_LOCK
+    return ticks;
+}
 
-    MAP_CAPT_stopTimer();
-    MAP_CAPT_clearTimer();
-    MAP_CAPT_selectTimerSource(CAPT_TIMER_SRC_ACLK);
-    MAP_CAPT_selectTimerSourceDivider(CAPT_TIMER_CLKDIV__1);
-    MAP_CAPT_writeTimerCompRegister(CAPT_MS_TO_CYCLES(g_uiApp.ui16ActiveModeScanPeriod));
-    MAP_CAPT_startTimer();
-    MAP_CAPT_enableISR(CAPT_TIMER_INTERRUPT);
+/// Task: drain the frames the IR driver has received.
+/**
+ ** The handler drains every frame that's in, and any that lands meanwhile
+ ** will post `EV_IR_RX` again.
+ */
+static void task_ir_rx(uint16_t events) {
+    ir_handle_rx();
+}
 
-    WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__32K | WDTCNTCL; // 1 second WDT
+/// Task: service CapTIvate.
+/**
+ ** It sleeps while it waits on each conversion, so tell it how deeply it
+ ** can. After enough scans without a touch, this drops it into
+ ** wake-on-prox, and a detection there brings it back.
+ */
+static void task_capt(uint16_t events) {
+    g_uiApp.ui8AppLPM = power_lpm_bits();
+    capt_scan_update(CAPT_appHandler());
+}
 
-    while(1)
+/// Task: the main animation and debouncing loop.
+/**
+ ** This may stand for several system ticks, if nothing needed each one.
+ */
+static void task_tick(uint16_t events) {
+    uint8_t ticks;
+
+    // First off, pat the dog. It has to outlast the longest tickless
+    //  sleep, which is a second.
+    wdt_pet();
+
+    // Service the LED animation timestep.
+    ticks = rtc_take_ticks();
+    deadline_timestep();
     {
-        // Check whether the time loop flag has been set; this is our
-        //  main animation and debouncing loop.
-        if (f_time_loop) {
-            // First off, pat the dog.
-            WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__32K | WDTCNTCL; // 1 second WDT
+        PROF_BEGIN(PROF_LEDS_TIMESTEP);
+        leds_timestep(ticks);
+        PROF_END(PROF_LEDS_TIMESTEP);
+    }
+    badge_timestep();
+    ir_tick(ticks);
 
-            // Service the LED animation timestep.
-//            leds_timestep(); // TODO
-//            serial_tick(); // TODO
+    if (boot_stage < BOOT_STAGE_DONE) {
+        badge_events |= EV_BOOT;
+    }
+}
 
-            f_time_loop = 0;
-        }
+/// Task: once-a-second bookkeeping.
+static void task_second(uint16_t events) {
+    if (!(rtc_seconds % BADGE_CLOCK_WRITE_INTERVAL)) {
+        // Every BADGE_CLOCK_WRITE_INTERVAL seconds, write our time
+        //  to the config, along with anything else that's changed.
+        badge_save_time();
+        badge_conf_commit();
+    }
 
-        if (f_second) {
-            rtc_seconds++; // TODO
+    if (!(rtc_seconds % BADGE_BLING_SECS)) {
+        badge_bling();
+    }
 
-//            if (!(rtc_seconds % BADGE_CLOCK_WRITE_INTERVAL)) {
-                // Every BADGE_CLOCK_WRITE_INTERVAL seconds, write our time to the config.
-//                badge_set_time(rtc_seconds, badge_clock_authority); // TODO
-//            }
+    if (!(rtc_seconds % HT16D_HEALTH_SECS)) {
+        ht16d_health_check();
+    }
 
-//            if (!(rtc_seconds % BADGE_BLING_SECS)) {
-//                badge_bling(); // TODO
-//            }
+    leds_brightness_update();
+    temp_second();
 
-            f_second = 0;
-        }
+#if PROF_ENABLE
+    if (!(rtc_seconds % PROF_DUMP_SECS)) {
+        prof_dump();
+    }
+#endif
+}
 
-//        if (f_serial_phy) {
-//            serial_phy_handle_rx();
-//            f_serial_phy = 0;
-//        }
-//
-//        if (f_long_press) {
-//            f_long_press = 0;
-//            button_state = 2;
-//            badge_button_press_long();
-//        }
-//
-//        if (f_hot) {
-//            badge_temp_unlock(1);
-//            f_hot = 0;
-//        }
-//
-//        if (f_cold) {
-//            badge_temp_unlock(0);
-//            f_cold = 0;
-//        }
-
-        // Check whether CapTIvate needs to be serviced.
-        if (g_bConvTimerFlag)
-        {
-            CAPT_updateUI(&g_uiApp);
-            g_bConvTimerFlag = false;
-        }
+/// Task: a temperature reading crossed one of the unlock thresholds.
+static void task_temp(uint16_t events) {
+    if (events & EV_HOT) {
+        badge_temp_unlock(1);
+    }
+    if (events & EV_COLD) {
+        badge_temp_unlock(0);
+    }
+}
 
-        __bis_SR_register(LPM0_bits);
-    } // End background loop
+/// Task: parse and answer serial console requests.
+static void task_console(uint16_t events) {
+    console_handle_rx();
+}
+
+/// Task: the LED controller's SPI bus is free again, and CS is high.
+/**
+ ** Nothing is chained to this yet.
+ */
+static void task_ht16d_done(uint16_t events) {
 }
 
-/// Pointer to 30 degC temperature sensor calibration, per datasheet.
-#define CALADC_15V_30C  *((unsigned int *)0x1A1A)
-/// Pointer to 85 degC temperature sensor calibration, per datasheet.
-#define CALADC_15V_85C  *((unsigned int *)0x1A1C)
+/// The main loop's tasks, most urgent first.
+/**
+ ** Touch handling comes ahead of everything but draining the IR receive
+ ** buffer, which is quick, and can overflow. Budgets are in CPU cycles,
+ ** which are the same whatever the clock profile. The startup task's
+ ** calibration can take far longer than anything else, but it only runs
+ ** before the buttons are up.
+ */
+const sched_task_t badge_tasks[] = {
+    {.events = EV_IR_RX, .run = task_ir_rx, .prof_region = PROF_TASK_IR_RX, .budget = 4000},
+    {.events = EV_CAPT, .ready = capt_pending, .run = task_capt, .prof_region = PROF_TASK_CAPT, .budget = 12000},
+    {.events = EV_TIME_LOOP, .run = task_tick, .prof_region = PROF_TASK_TICK, .budget = 16000},
+    {.events = EV_SECOND, .run = task_second, .prof_region = PROF_TASK_SECOND, .budget = 8000},
+    {.events = EV_HOT | EV_COLD, .run = task_temp, .prof_region = PROF_TASK_TEMP, .budget = 1000},
+    {.events = EV_HT16D_TX_DONE, .run = task_ht16d_done, .prof_region = PROF_TASK_HT16D_DONE, .budget = 1000},
+    {.events = EV_CONSOLE, .ready = console_pending, .run = task_console, .prof_region = PROF_TASK_CONSOLE, .budget = 8000},
+    {.events = EV_BOOT, .run = boot_step, .prof_region = PROF_TASK_BOOT, .budget = 0xffff},
+};
 
-/// ADC interrupt service routine.
-#pragma vector=ADC_VECTOR
-__interrupt void ADC_ISR(void)
-{
-    volatile int32_t temp;
-    volatile int32_t degF;
-    volatile int32_t degC;
+/// Make snafucated.
+int main(void) {
+    WDTCTL = WDTPW | WDTHOLD; // Hold WDT.
+    wdt_init(); // See if it just bit us, and start it again.
 
-    switch(__even_in_range(ADCIV,ADCIV_ADCIFG))
+    // Configure board basics:
+    init_clocks();
+    init_io();
+    TRACE_WAKE();
+
+    // Enable interrupts.
+    __bis_SR_register(GIE);
+
+    // Load the persistent config, which the clock starts from, and which
+    //  says whether this board still needs its factory self-test.
+    badge_conf_load();
+    selftest_init();
+
+    // Configure mid-level drivers.
+    rtc_init();
+    ht16d_init();
+    leds_init();
+    ir_init();
+    console_init();
+    temp_init();
+    prof_init();
+
+    // Initialize badge data and game. This starts the boot animation, and
+    //  the trim and the buttons are brought up under it, by boot_step().
+    badge_init();
+
+    while(1)
     {
-        case ADCIV_NONE:
-            break;
-        case ADCIV_ADCOVIFG:
-            break;
-        case ADCIV_ADCTOVIFG:
-            break;
-        case ADCIV_ADCHIIFG:
-            break;
-        case ADCIV_ADCLOIFG:
-            break;
-        case ADCIV_ADCINIFG:
-            break;
-        case ADCIV_ADCIFG:
-            temp = ADCMEM0;
-            // Temperature in Celsius
-            // The temperature (Temp, C)=
-            degC = (temp-CALADC_15V_30C)*(85-30)/(CALADC_15V_85C-CALADC_15V_30C)+30;
-
-            // Temperature in Fahrenheit
-            // Tf = (9/5)*Tc | 32
-            degF = 9*degC/5+32;
-
-            if (degF <= BADGE_UNLOCK_TEMP_UNDER_S01) {
-                f_cold = 1;
-            } else if (degF >= BADGE_UNLOCK_TEMP_OVER_S00) {
-                f_hot = 1;
-            } else {
-                break;
+        // Run the single most urgent runnable task. Checking for work and
+        //  going to sleep happen with interrupts disabled, so that an
+        //  event posted in between can't be missed until the next wakeup.
+        __bic_SR_register(GIE);
+
+        if (!sched_run(badge_tasks, sizeof(badge_tasks) / sizeof(sched_task_t))) {
+            clock_update();
+            if (!rtc_schedule(badge_ticks_needed())) {
+                power_sleep();
             }
-
-            LPM0_EXIT;
-            break;
-        default:
-            break;
-    }
+        }
+    } // End background loop
 }
-
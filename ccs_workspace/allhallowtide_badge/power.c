@@ -0,0 +1,85 @@
+/// Low power mode arbiter.
+/**
+ ** Every driver that needs a clock to keep running while the CPU sleeps
+ ** says so here, with `power_need()`, and says so again (with
+ ** `POWER_CLOCK_NONE`) when it's done. Every sleep anywhere in the badge
+ ** goes through `power_sleep()`, which picks the deepest low power mode
+ ** that leaves every clock that's needed running:
+ **
+ ** Needed   | Sleep in
+ ** :-----   | :-------
+ ** SMCLK    | LPM0
+ ** ACLK     | LPM3
+ ** Nothing  | LPM4
+ **
+ ** The RTC needs ACLK all the time, so in practice the floor is LPM3.
+ ** Drivers can call `power_need()` from their ISRs, since that's where a
+ ** transfer usually finishes.
+ **
+ ** \file power.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "power.h"
+#include "trace.h"
+
+/// Bitmask of `POWER_CLIENT_*` that currently need SMCLK.
+volatile uint8_t power_smclk_clients = 0;
+/// Bitmask of `POWER_CLIENT_*` that currently need ACLK.
+volatile uint8_t power_aclk_clients = 0;
+
+/// Record that `client` needs `clock` (one of `POWER_CLOCK_*`) from now on.
+/**
+ ** Each client has exactly one requirement at a time, so this replaces
+ ** whatever `client` needed before.
+ */
+void power_need(uint8_t client, uint8_t clock) {
+    uint16_t gie = __get_SR_register() & GIE;
+
+    __bic_SR_register(GIE);
+    power_smclk_clients &= ~client;
+    power_aclk_clients &= ~client;
+
+    if (clock == POWER_CLOCK_SMCLK) {
+        power_smclk_clients |= client;
+    } else if (clock == POWER_CLOCK_ACLK) {
+        power_aclk_clients |= client;
+    }
+    __bis_SR_register(gie);
+}
+
+/// Returns the status register bits for the deepest low power mode allowed.
+/**
+ ** This is also what CapTIvate should sleep in while it waits on a
+ ** conversion, in `g_uiApp.ui8AppLPM`.
+ */
+uint16_t power_lpm_bits() {
+    if (power_smclk_clients) {
+        return LPM0_bits;
+    }
+    if (power_aclk_clients) {
+        return LPM3_bits;
+    }
+    return LPM4_bits;
+}
+
+/// Sleep in the deepest low power mode allowed, until an interrupt wakes us.
+/**
+ ** This must be called with interrupts disabled, right after checking
+ ** whatever it is we're waiting for. It enables them in the same
+ ** instruction that goes to sleep, so that an interrupt in between can't
+ ** be missed. Interrupts are enabled when it returns.
+ **
+ ** ISRs should wake the CPU with `LPM4_EXIT`, which covers every mode.
+ */
+void power_sleep() {
+    TRACE_SLEEP();
+    __bis_SR_register(power_lpm_bits() | GIE);
+    TRACE_WAKE();
+}
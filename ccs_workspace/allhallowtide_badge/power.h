@@ -0,0 +1,38 @@
+/// Header for the low power mode arbiter.
+/**
+ ** \file power.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef POWER_H_
+#define POWER_H_
+
+#include <stdint.h>
+
+/// Power client ID for the RTC, which needs ACLK for the system tick.
+#define POWER_CLIENT_RTC    0x01
+/// Power client ID for the HT16D35A driver's SPI transfers.
+#define POWER_CLIENT_HT16D  0x02
+/// Power client ID for the IR link's UART.
+#define POWER_CLIENT_IR     0x04
+/// Power client ID for the CapTIvate timer and conversions.
+#define POWER_CLIENT_CAPT   0x08
+/// Power client ID for ADC conversions.
+#define POWER_CLIENT_ADC    0x10
+/// Power client ID for the serial console, which has to hear requests.
+#define POWER_CLIENT_CONSOLE 0x20
+
+/// The client needs no clocks while the CPU sleeps (LPM4 is fine).
+#define POWER_CLOCK_NONE    0
+/// The client needs ACLK while the CPU sleeps (LPM3 at most).
+#define POWER_CLOCK_ACLK    1
+/// The client needs SMCLK while the CPU sleeps (LPM0 at most).
+#define POWER_CLOCK_SMCLK   2
+
+void power_need(uint8_t client, uint8_t clock);
+uint16_t power_lpm_bits();
+void power_sleep();
+
+#endif /* POWER_H_ */
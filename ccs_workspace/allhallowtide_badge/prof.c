@@ -0,0 +1,139 @@
+/// Cycle profiler for ISRs and main loop handlers.
+/**
+ ** Timer_A1 free-runs from SMCLK, which is MCLK, so each count is one CPU
+ ** cycle. A region is marked with `PROF_BEGIN()` and `PROF_END()` in the
+ ** same block, and every pass through it is accumulated into
+ ** `prof_stats`, which can be read with the debugger, and (with the
+ ** CapTIvate UART interface) is sent to the Design Center as general
+ ** purpose data every `PROF_DUMP_SECS` seconds. Each dump is one page of
+ ** up to `PROF_DUMP_REGIONS` regions, taking turns: the first word is the
+ ** first region's ID, followed by five words per region: min, max, average,
+ ** count, and overruns. The main loop's tasks each have a region, too,
+ ** which sched.c records, and counts overruns of the task's budget in.
+ **
+ ** A few things to keep in mind when reading the numbers:
+ **
+ **  - SMCLK stops when we sleep in LPM3 or LPM4, so a region that sleeps
+ **    (as `CAPT_updateUI()` does during each conversion) counts only the
+ **    cycles that the CPU was actually awake for.
+ **  - An interrupt that lands in the middle of a main loop region is
+ **    counted as part of that region, too.
+ **  - The counter is 16 bits, so a region longer than about 8 ms wraps.
+ **
+ ** None of this is built unless `PROF_ENABLE` is set, and the markers
+ ** compile to nothing without it.
+ **
+ ** \file prof.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "captivate.h"
+
+#include "prof.h"
+
+#if PROF_ENABLE
+
+#if (CAPT_INTERFACE==__CAPT_UART_INTERFACE__) && (1 + PROF_DUMP_REGIONS*5 > CAPT_GENERAL_PURPOSE_WORDS_MAX)
+#error "A dump of PROF_DUMP_REGIONS regions is over CAPT_GENERAL_PURPOSE_WORDS_MAX"
+#endif
+
+/// Statistics for each profiled region, indexed by its ID.
+prof_stats_t prof_stats[PROF_REGION_COUNT];
+/// ID of the first region in the next page `prof_dump()` sends.
+uint8_t prof_dump_next = 0;
+/// Cycles that an empty `PROF_BEGIN()`/`PROF_END()` pair counts.
+uint16_t prof_overhead = 0;
+
+/// Clear the statistics and start the cycle counter.
+void prof_init() {
+    uint16_t start;
+
+    for (uint8_t i=0; i<PROF_REGION_COUNT; i++) {
+        prof_stats[i].min = 0xffff;
+        prof_stats[i].max = 0;
+        prof_stats[i].count = 0;
+        prof_stats[i].total = 0;
+        prof_stats[i].overruns = 0;
+    }
+
+    TA1CTL = TASSEL__SMCLK | ID__1 | MC__CONTINUOUS | TACLR;
+
+    // Time the markers themselves, so they can be left out of the results.
+    start = TA1R;
+    prof_overhead = TA1R - start;
+}
+
+/// Record one pass of `cycles` cycles through `region`.
+/**
+ ** This is called from ISRs as well as the main loop, but each region is
+ ** only ever recorded from one or the other, so this needn't lock.
+ **
+ ** \return The cycles recorded, less the markers' own overhead.
+ */
+uint16_t prof_record(uint8_t region, uint16_t cycles) {
+    prof_stats_t *stats = &prof_stats[region];
+
+    cycles = cycles > prof_overhead ? cycles - prof_overhead : 0;
+
+    if (cycles < stats->min) {
+        stats->min = cycles;
+    }
+    if (cycles > stats->max) {
+        stats->max = cycles;
+    }
+    if (stats->count < 0xffff) {
+        stats->count++;
+        stats->total += cycles;
+    }
+
+    return cycles;
+}
+
+/// Record one pass through `region`, and whether it fit in `budget` cycles.
+void prof_record_budget(uint8_t region, uint16_t cycles, uint16_t budget) {
+    prof_stats_t *stats = &prof_stats[region];
+
+    if (prof_record(region, cycles) > budget && stats->overruns < 0xffff) {
+        stats->overruns++;
+    }
+}
+
+/// Send the next page of statistics to the CapTIvate Design Center.
+/**
+ ** It's dropped if the interface is still busy with telemetry, and the
+ ** same page goes next time.
+ */
+void prof_dump() {
+#if (CAPT_INTERFACE==__CAPT_UART_INTERFACE__)
+    uint16_t data[1 + PROF_DUMP_REGIONS * 5];
+    uint8_t len = 1;
+    prof_stats_t *stats;
+
+    if (CAPT_isInterfaceBusy()) {
+        return;
+    }
+
+    data[0] = prof_dump_next;
+    for (uint8_t i=0; i<PROF_DUMP_REGIONS && prof_dump_next<PROF_REGION_COUNT; i++) {
+        stats = &prof_stats[prof_dump_next++];
+        data[len++] = stats->count ? stats->min : 0;
+        data[len++] = stats->max;
+        data[len++] = stats->count ? stats->total / stats->count : 0;
+        data[len++] = stats->count;
+        data[len++] = stats->overruns;
+    }
+    if (prof_dump_next >= PROF_REGION_COUNT) {
+        prof_dump_next = 0;
+    }
+
+    CAPT_writeGeneralPurposeData(data, len);
+#endif
+}
+
+#endif
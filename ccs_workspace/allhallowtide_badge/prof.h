@@ -0,0 +1,95 @@
+/// Header for the cycle profiler.
+/**
+ ** \file prof.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef PROF_H_
+#define PROF_H_
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+/// Nonzero to build in the cycle profiler. Set it from the build's defines.
+#ifndef PROF_ENABLE
+#define PROF_ENABLE 0
+#endif
+
+/// Region ID for `RTC_ISR`.
+#define PROF_RTC_ISR            0
+/// Region ID for `CAPT_updateUI()`, via `CAPT_appHandler()`.
+#define PROF_CAPT_UPDATE        1
+/// Region ID for `leds_timestep()`, including any frame it commits.
+#define PROF_LEDS_TIMESTEP      2
+/// Region ID for `ht16d_send_gray()`.
+#define PROF_HT16D_SEND_GRAY    3
+/// Region ID for the main loop's IR receive task.
+#define PROF_TASK_IR_RX         4
+/// Region ID for the main loop's CapTIvate task.
+#define PROF_TASK_CAPT          5
+/// Region ID for the main loop's system tick task.
+#define PROF_TASK_TICK          6
+/// Region ID for the main loop's once-a-second task.
+#define PROF_TASK_SECOND        7
+/// Region ID for the main loop's temperature task.
+#define PROF_TASK_TEMP          8
+/// Region ID for the main loop's LED transfer done task.
+#define PROF_TASK_HT16D_DONE    9
+/// Region ID for the main loop's background startup task.
+#define PROF_TASK_BOOT          10
+/// Region ID for the main loop's serial console task.
+#define PROF_TASK_CONSOLE       11
+/// The number of profiled regions.
+#define PROF_REGION_COUNT       12
+
+/// Seconds between dumps of the statistics to the CapTIvate interface.
+#define PROF_DUMP_SECS 4
+/// Regions per dump.
+/**
+ ** Each is five words, after the first region's ID, and a dump has to fit in
+ ** the `CAPT_GENERAL_PURPOSE_WORDS_MAX` that the interface's transmit
+ ** buffers are sized for.
+ */
+#define PROF_DUMP_REGIONS 2
+
+/// Accumulated cycle counts for one profiled region.
+typedef struct {
+    /// Fewest cycles one pass has taken.
+    uint16_t min;
+    /// Most cycles one pass has taken.
+    uint16_t max;
+    /// Passes counted in `total`. This stops at 0xffff, and so does `total`.
+    uint16_t count;
+    /// Sum of every counted pass's cycles; `total/count` is the average.
+    uint32_t total;
+    /// Passes that went over their budget, for regions that have one.
+    uint16_t overruns;
+} prof_stats_t;
+
+#if PROF_ENABLE
+
+extern prof_stats_t prof_stats[PROF_REGION_COUNT];
+
+/// Mark the start of profiled region `region` in the current block.
+#define PROF_BEGIN(region) uint16_t prof_start_##region = TA1R
+/// Mark the end of profiled region `region`, and record its cycles.
+#define PROF_END(region) prof_record(region, TA1R - prof_start_##region)
+
+void prof_init();
+uint16_t prof_record(uint8_t region, uint16_t cycles);
+void prof_record_budget(uint8_t region, uint16_t cycles, uint16_t budget);
+void prof_dump();
+
+#else
+
+#define PROF_BEGIN(region)
+#define PROF_END(region)
+#define prof_init()
+#define prof_dump()
+
+#endif
+
+#endif /* PROF_H_ */
@@ -1,12 +1,42 @@
 /// Real-time clock configuration and events module.
 /**
- ** This module operates a real-time clock, sourced from the 8-MHz MCLK.
- ** It works about medium well, precision-wise. But that's fine, because it
- ** only has to last a weekend! (unofficial #badgelife motto).
+ ** This module operates a real-time clock, sourced from the 32.768 kHz REFO
+ ** through ACLK, so that it keeps running while the MCU is in LPM3. It works
+ ** about medium well, precision-wise. But that's fine, because it only has
+ ** to last a weekend! (unofficial #badgelife motto).
  **
  ** Basically, the RTC generates the main system tick, which is every 10 ms,
  ** or 100 times per second. That centisecond (csec) system tick is then
  ** used to create another, once per second tick, used to keep track of time.
+ ** 10 ms isn't a whole number of ACLK cycles, so ticks are 327 or 328 cycles
+ ** long, spread out so that every second is exactly 32768.
+ **
+ ** When nothing needs every system tick, the RTC is asked (with
+ ** `rtc_schedule()`) to interrupt less often, as rarely as once a second, and
+ ** each interrupt then stands for several system ticks at once. The main loop
+ ** gets the number of ticks it's owed from `rtc_take_ticks()`, and both the
+ ** seconds and the centiseconds stay exactly where they would have been.
+ **
+ ** The counter runs free from one period to the next. `RTCMOD` is buffered,
+ ** and only loaded when the counter wraps, so each interrupt writes the
+ ** length of the period after the one that's just started; however late the
+ ** ISR runs, no ACLK edges are lost to it. The counter is only restarted
+ ** when `rtc_schedule()` changes a period partway through, and then it's
+ ** restarted short by whatever it counted while that was being worked out.
+ **
+ ** To bring the clock into line with another badge's without a jump,
+ ** `rtc_slew()` spreads a correction out over enough seconds that no one
+ ** second is more than `RTC_SLEW_MAX_CYCLES` long or short. The correction
+ ** all comes off (or on) the last tick of each second.
+ **
+ ** The REFO itself is only good to a fraction of a percent, and there's no
+ ** crystal on the board to check it against. What we do have, once our
+ ** clock has been synced to a more trusted badge's a few times, is an
+ ** estimate of how fast the REFO runs (see sync.c). `rtc_set_trim()` takes
+ ** that out, a fraction of a cycle per second at a time: each second adds
+ ** the trim to an accumulator, Bresenham style, and the whole cycles that
+ ** builds up go onto that second along with the slew.
+ **
  ** The system seconds timer is calibrated to measure the seconds since noon
  ** on Wednesday, Las Vegas time. Therefore, here are some real example times:
  **
@@ -32,52 +62,419 @@
 #include <msp430fr2633.h>
 
 #include "badge.h"
+#include "power.h"
+#include "prof.h"
+#include "rtc.h"
+
+/// Fewest ACLK cycles that must be left in a period to rewrite `RTCMOD` in it.
+/**
+ ** The RTC takes `RTCMOD` when the counter wraps, so the next period has to
+ ** be written before that, and a restart has to be done before it, too. Even
+ ** in the idle clock profile, at 1 MHz, this is about a thousand CPU cycles.
+ */
+#define RTC_MARGIN_CYCLES 32
+#include "trace.h"
 
-/// The number of system ticks the button has been held down so far.
-uint8_t rtc_button_csecs = 0;
-/// System ticks this second, which wraps from 100 to 1.
+/// System ticks since boot, wrapping; for timestamps.
+volatile uint16_t rtc_ticks = 0;
+/// System ticks this second, which wraps from 100 to 0.
 volatile uint8_t rtc_centiseconds = 0;
 /// Number of seconds so far; persisted in `badge_conf.clock`.
 volatile uint32_t rtc_seconds = 0;
+/// System ticks per RTC interrupt, right now.
+volatile uint8_t rtc_period = 1;
+/// `RTCMOD` for the period the counter is in now.
+volatile uint16_t rtc_period_mod = 0;
+/// System ticks in the period after this one, already loaded in `RTCMOD`.
+volatile uint8_t rtc_next_period = 1;
+/// `RTCMOD` for the period after this one.
+volatile uint16_t rtc_next_mod = 0;
+/// System ticks per RTC interrupt that were last asked for; see `rtc_schedule()`.
+volatile uint8_t rtc_ticks_wanted = 1;
+/// ACLK cycles from the last system tick to when the counter was last at 0.
+/**
+ ** This is only nonzero after a restart partway through a period. It's
+ ** negative if the tick before that restart was credited a little early.
+ */
+volatile int16_t rtc_count_offset = 0;
+/// System ticks that have passed that the main loop hasn't taken yet.
+volatile uint8_t rtc_ticks_pending = 0;
+/// ACLK cycles of correction still to slew in; positive to catch up.
+volatile int32_t rtc_slew_left = 0;
+/// ACLK cycles the current second is shortened by, for the slew and trim.
+volatile int16_t rtc_second_adjust = 0;
+/// ACLK cycles the next second is shortened by, once it's been worked out.
+volatile int16_t rtc_next_adjust = 0;
+/// How much of `rtc_next_adjust` is slew, rather than trim.
+volatile int16_t rtc_next_slew = 0;
+/// Whether `rtc_next_adjust` has been worked out yet, this second.
+volatile uint8_t rtc_next_adjust_ready = 0;
+/// ACLK cycles to shorten each second by, in Q16, to trim out REFO error.
+volatile int32_t rtc_trim_q16 = 0;
+/// Fraction of a cycle of trim carried over between seconds, in Q16.
+volatile int32_t rtc_trim_acc = 0;
+
+/// ACLK cycles from the start of each second to each of its system ticks.
+/**
+ ** This is `csecs * 32768 / 100`, rounded down, for 0 to 100 centiseconds.
+ ** The number of cycles from tick `a` to tick `b` is just `b`'s entry minus
+ ** `a`'s, which the ISR can afford where it couldn't afford the division.
+ */
+const uint16_t rtc_tick_counts[101] = {
+    0, 327, 655, 983, 1310, 1638, 1966, 2293, 2621, 2949,
+    3276, 3604, 3932, 4259, 4587, 4915, 5242, 5570, 5898, 6225,
+    6553, 6881, 7208, 7536, 7864, 8192, 8519, 8847, 9175, 9502,
+    9830, 10158, 10485, 10813, 11141, 11468, 11796, 12124, 12451, 12779,
+    13107, 13434, 13762, 14090, 14417, 14745, 15073, 15400, 15728, 16056,
+    16384, 16711, 17039, 17367, 17694, 18022, 18350, 18677, 19005, 19333,
+    19660, 19988, 20316, 20643, 20971, 21299, 21626, 21954, 22282, 22609,
+    22937, 23265, 23592, 23920, 24248, 24576, 24903, 25231, 25559, 25886,
+    26214, 26542, 26869, 27197, 27525, 27852, 28180, 28508, 28835, 29163,
+    29491, 29818, 30146, 30474, 30801, 31129, 31457, 31784, 32112, 32440,
+    32768,
+};
+
+/// Read the RTC's counter, which counts on ACLK, not MCLK.
+/**
+ ** A read can catch the counter changing, so this reads it until two reads
+ ** in a row agree.
+ */
+static uint16_t rtc_count() {
+    uint16_t count;
+
+    do {
+        count = RTCCNT;
+    } while (count != RTCCNT);
+
+    return count;
+}
+
+/// ACLK cycles in a period of `ticks` system ticks, `csecs` into a second.
+/**
+ ** If the period ends the second, it's shortened by `adjust`.
+ */
+static uint16_t rtc_counts(uint8_t csecs, uint8_t ticks, int16_t adjust) {
+    uint16_t counts;
+
+    counts = rtc_tick_counts[csecs + ticks] - rtc_tick_counts[csecs];
+    if (csecs + ticks == 100) {
+        counts -= adjust;
+    }
+    return counts;
+}
+
+/// Work out `rtc_next_adjust`, from the slew and the trim.
+static void rtc_take_adjust() {
+    int16_t trim;
+
+    // Take the next second's share of the slew.
+    if (rtc_slew_left > RTC_SLEW_MAX_CYCLES) {
+        rtc_next_adjust = RTC_SLEW_MAX_CYCLES;
+    } else if (rtc_slew_left < -RTC_SLEW_MAX_CYCLES) {
+        rtc_next_adjust = -RTC_SLEW_MAX_CYCLES;
+    } else {
+        rtc_next_adjust = rtc_slew_left;
+    }
+    rtc_slew_left -= rtc_next_adjust;
+    rtc_next_slew = rtc_next_adjust;
+
+    // And the next second's whole cycles of trim.
+    rtc_trim_acc += rtc_trim_q16;
+    trim = rtc_trim_acc / 65536;
+    rtc_trim_acc -= (int32_t) trim * 65536;
+    rtc_next_adjust += trim;
+    rtc_next_adjust_ready = 1;
+}
+
+/// Load `RTCMOD` with the period after this one, for the RTC to take when it wraps.
+/**
+ ** That period is `rtc_ticks_wanted` long, or as much of it as fits before
+ ** the end of its second. This must be called with interrupts disabled, and
+ ** with at least `RTC_MARGIN_CYCLES` left in the current period.
+ */
+static void rtc_plan_next() {
+    uint8_t csecs = rtc_centiseconds + rtc_period;
+    int16_t adjust = rtc_second_adjust;
+
+    if (csecs == 100) {
+        // The next period starts a new second, with its own adjustment.
+        csecs = 0;
+        if (!rtc_next_adjust_ready) {
+            rtc_take_adjust();
+        }
+        adjust = rtc_next_adjust;
+    }
+
+    rtc_next_period = rtc_ticks_wanted < 100 - csecs ? rtc_ticks_wanted : 100 - csecs;
+    rtc_next_mod = rtc_counts(csecs, rtc_next_period, adjust) - 1; // It wraps after RTCMOD+1.
+    RTCMOD = rtc_next_mod;
+}
 
 /// Initialize the on-board real-time clock to tick 100 times per second.
 /**
- ** This sources the RTC from SMCLK (8 MHz) divided by 1000 (8 kHz),
- ** setting the modulo to 80, so that the RTC will tick 100x
- ** per second.
+ ** This sources the RTC from ACLK, which is the 32.768 kHz REFO, with no
+ ** divider. With `RTCCKSEL` set, the RTC's "SMCLK" source selects ACLK
+ ** instead. Each period is loaded from `rtc_tick_counts`.
  */
 void rtc_init() {
-//    rtc_seconds = badge_conf.clock;
-
-    RTCMOD = 80; // Count the clock to 80 before resetting.
+    rtc_seconds = badge_conf.clock;
+    rtc_set_trim(badge_conf.rtc_trim_ppm);
 
     // Read and then throw away RTCIV to clear the interrupt.
     volatile uint16_t vector_read;
     vector_read = RTCIV;
 
-    RTCCTL = RTCSS__SMCLK |     // SMCLK (8MHz) source
-             RTCPS__1000 |      // divided by 1000 to get 8kHz
-             RTCSR |            // Reset counter.
+    SYSCFG2 |= RTCCKSEL;        // ACLK, not SMCLK, as the RTC clock.
+    RTCCTL = RTCSS__SMCLK |     // ACLK (32.768 kHz) source, per RTCCKSEL
+             RTCPS__1 |         // undivided
              RTCIE;             // Enable interrupt.
+
+    // Start the first tick, and queue up the one after it.
+    rtc_period_mod = rtc_counts(0, 1, 0) - 1;
+    RTCMOD = rtc_period_mod;
+    RTCCTL |= RTCSR;
+    rtc_plan_next();
+    power_need(POWER_CLIENT_RTC, POWER_CLOCK_ACLK);
 }
 
-/// RTC overflow interrupt service routine.
-#pragma vector=RTC_VECTOR
-__interrupt void RTC_ISR(void) {
-    // Called when the RTC overflows (100 times per second)
-    if (RTCIV == RTCIV_RTCIF) {
-        rtc_centiseconds++;
-        f_time_loop = 1;
+/// Set the clock to `seconds`.
+void rtc_set_seconds(uint32_t seconds) {
+    uint16_t gie = __get_SR_register() & GIE;
+
+    __bic_SR_register(GIE);
+    rtc_seconds = seconds;
+    __bis_SR_register(gie);
+}
+
+/// Step the clock by `seconds`: positive to jump ahead, negative back.
+/**
+ ** This is done here, with interrupts off, rather than by the caller
+ ** setting the time it read plus the step, so that a second that ticks in
+ ** between isn't lost. Returns the new time.
+ */
+uint32_t rtc_step(int32_t seconds) {
+    uint16_t gie = __get_SR_register() & GIE;
+    uint32_t now;
+
+    __bic_SR_register(GIE);
+    rtc_seconds += seconds;
+    now = rtc_seconds;
+    __bis_SR_register(gie);
+
+    return now;
+}
+
+/// Slew the clock by `cycles` ACLK cycles: positive to run ahead, negative back.
+/**
+ ** This replaces any slew still in progress, since a new measurement of
+ ** how far off we are already takes whatever of it has been done into
+ ** account. The next second's share may already be loaded into the RTC,
+ ** though, so that comes out of the new slew, instead. Returns the slew
+ ** that was still pending, which is now replaced.
+ */
+int32_t rtc_slew(int32_t cycles) {
+    uint16_t gie = __get_SR_register() & GIE;
+    int32_t left;
+
+    __bic_SR_register(GIE);
+    left = rtc_slew_left;
+    if (rtc_next_adjust_ready) {
+        left += rtc_next_slew;
+        cycles -= rtc_next_slew;
+    }
+    rtc_slew_left = cycles;
+    __bis_SR_register(gie);
+
+    return left;
+}
+
+/// Trim the clock for a REFO that runs `ppm` parts per million fast.
+/**
+ ** Negative for one that runs slow. This is limited to `RTC_TRIM_MAX_PPM`
+ ** either way.
+ */
+void rtc_set_trim(int16_t ppm) {
+    uint16_t gie = __get_SR_register() & GIE;
+
+    if (ppm > RTC_TRIM_MAX_PPM) {
+        ppm = RTC_TRIM_MAX_PPM;
+    } else if (ppm < -RTC_TRIM_MAX_PPM) {
+        ppm = -RTC_TRIM_MAX_PPM;
+    }
+
+    __bic_SR_register(GIE);
+    // A fast REFO needs longer seconds. 32768 * 65536 / 1000000 is 2147.5.
+    rtc_trim_q16 = -(int32_t) ppm * 2147;
+    __bis_SR_register(gie);
+}
+
+/// Returns the ACLK cycles of slew that haven't been applied yet.
+int32_t rtc_slew_pending() {
+    uint16_t gie = __get_SR_register() & GIE;
+    int32_t left;
+
+    __bic_SR_register(GIE);
+    left = rtc_slew_left;
+    if (rtc_next_adjust_ready) {
+        left += rtc_next_slew; // Worked out, but its second hasn't started.
+    }
+    __bis_SR_register(gie);
+
+    return left;
+}
+
+/// Take the number of system ticks that have passed since this was last called.
+uint8_t rtc_take_ticks() {
+    uint16_t gie = __get_SR_register() & GIE;
+    uint8_t ticks;
+
+    __bic_SR_register(GIE);
+    ticks = rtc_ticks_pending;
+    rtc_ticks_pending = 0;
+    __bis_SR_register(gie);
+
+    return ticks;
+}
+
+/// Credit the period that just ended, and plan the one after the next.
+/**
+ ** This is the RTC interrupt's work, for when its flag is set. It must be
+ ** called with interrupts disabled, and only after reading `RTCIV` has
+ ** cleared the flag, so that the same period is never credited twice.
+ */
+static void rtc_overflow() {
+    rtc_centiseconds += rtc_period;
+    rtc_ticks_pending += rtc_period;
+    rtc_ticks += rtc_period;
+    badge_events |= EV_TIME_LOOP;
+
+    if (rtc_centiseconds >= 100) {
+        badge_events |= EV_SECOND;
+        rtc_centiseconds = 0;
+        rtc_seconds++;
+
+        // This second's adjustment was worked out when its first period
+        //  was planned, a period ago.
+        rtc_second_adjust = rtc_next_adjust;
+        rtc_next_adjust_ready = 0;
+    }
 
-        if (button_state && rtc_centiseconds == rtc_button_csecs) {
-            f_long_press = 1;
+    // The RTC has already taken the next period from RTCMOD, and started
+    //  counting it from 0, so all that's left is to plan the one after it.
+    rtc_period = rtc_next_period;
+    rtc_period_mod = rtc_next_mod;
+    rtc_count_offset = 0;
+    rtc_plan_next();
+}
+
+/// Have the next RTC interrupt come `ticks` system ticks after the last one.
+/**
+ ** This is how the system goes tickless: pass 1 to get every system tick,
+ ** or more to skip ahead. It never schedules past the next second boundary,
+ ** so `EV_SECOND` is always on time, and if `ticks` has already passed, the
+ ** next tick is scheduled instead. Every period after that is `ticks` long,
+ ** too, up to the end of its second, until this is called again.
+ **
+ ** If this changes the period partway through one, the RTC is restarted
+ ** from where it is, with any whole ticks so far credited immediately, and
+ ** the partial tick carried over in `rtc_count_offset`. The counter is read
+ ** again just before the restart, and the new period is shortened by what
+ ** it counted in between, so only the cycle or so the restart itself takes
+ ** is lost. That's only on a change of period, which is rare.
+ **
+ ** Returns true if that, or a period that ended while interrupts were off,
+ ** left system ticks for the main loop, with `EV_TIME_LOOP` posted. Then
+ ** the caller mustn't go to sleep, since no interrupt is coming for them.
+ */
+uint8_t rtc_schedule(uint8_t ticks) {
+    uint16_t gie = __get_SR_register() & GIE;
+    uint16_t count;
+    uint16_t late;
+    uint16_t mod;
+    uint16_t len;
+    int32_t elapsed;
+    uint8_t wanted;
+    uint8_t whole = 0;
+
+    __bic_SR_register(GIE);
+
+    // If a period ended since interrupts went off, its interrupt is still
+    //  pending, and it's for the period the RTC was counting. Credit it
+    //  before anything here changes that. And if this period is about to
+    //  end, wait for it, so the RTC can't take RTCMOD while it's rewritten.
+    do {
+        if (RTCIV == RTCIV_RTCIF) {
+            rtc_overflow();
         }
+        count = rtc_count();
+    } while ((RTCCTL & RTCIF) || rtc_period_mod - count < RTC_MARGIN_CYCLES);
+
+    if (!ticks) {
+        ticks = 1;
+    }
+    wanted = ticks;
+    if (ticks > 100 - rtc_centiseconds) {
+        ticks = 100 - rtc_centiseconds;
+    }
+
+    if (ticks == rtc_period && wanted == rtc_ticks_wanted) {
+        __bis_SR_register(gie);
+        return rtc_ticks_pending != 0;
+    }
+    rtc_ticks_wanted = wanted;
+
+    if (ticks != rtc_period) {
+        elapsed = (int32_t) count + rtc_count_offset;
 
-        if (rtc_centiseconds == 100) {
-            f_second = 1;
-            rtc_centiseconds = 1;
+        // This can't cross a second; the current period ends at or before
+        //  one. A tick that's due to end before the restart could be done
+        //  is credited now, a little early, and the restart goes that much
+        //  late.
+        while (whole+1 < rtc_period) {
+            len = rtc_tick_counts[rtc_centiseconds+1] - rtc_tick_counts[rtc_centiseconds];
+            if (elapsed + RTC_MARGIN_CYCLES < len) {
+                break;
+            }
+            elapsed -= len;
+            rtc_centiseconds++;
+            whole++;
         }
+        if (whole) {
+            rtc_ticks_pending += whole;
+            rtc_ticks += whole;
+            badge_events |= EV_TIME_LOOP;
+        }
+
+        ticks = ticks > whole ? ticks - whole : 1;
+        mod = rtc_counts(rtc_centiseconds, ticks, rtc_second_adjust) - elapsed - 1;
 
-        LPM0_EXIT;
+        // Restart the counter, short by what it's counted since it was read.
+        late = rtc_count() - count;
+        RTCMOD = mod - late;
+        RTCCTL |= RTCSR;
+        rtc_period_mod = mod - late;
+        rtc_count_offset = elapsed + late;
+        rtc_period = ticks;
     }
+
+    rtc_plan_next();
+
+    __bis_SR_register(gie);
+    return rtc_ticks_pending != 0;
+}
+
+/// RTC overflow interrupt service routine.
+#pragma vector=RTC_VECTOR
+__interrupt void RTC_ISR(void) {
+    TRACE_ISR_ENTER();
+    PROF_BEGIN(PROF_RTC_ISR);
+
+    // Called when the RTC overflows (100 times per second, unless tickless)
+    if (RTCIV == RTCIV_RTCIF) {
+        rtc_overflow();
+        LPM4_EXIT;
+    }
+
+    PROF_END(PROF_RTC_ISR);
+    TRACE_ISR_EXIT();
 }
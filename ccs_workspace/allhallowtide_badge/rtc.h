@@ -11,8 +11,27 @@
 
 extern volatile uint32_t rtc_seconds;
 extern volatile uint8_t rtc_centiseconds;
-extern uint8_t rtc_button_csecs;
+extern volatile uint16_t rtc_ticks;
+
+/// Most ACLK cycles `rtc_slew()` shortens or lengthens any one second by.
+/**
+ ** That's half a tick, or 0.5%, so a slew of a whole second takes 200.
+ */
+#define RTC_SLEW_MAX_CYCLES 163
+/// Most REFO error `rtc_set_trim()` can take out, in parts per million.
+/**
+ ** At 0.4%, the trim is at most 131 cycles a second. Along with the slew,
+ ** that never takes the last tick of a second down to nothing.
+ */
+#define RTC_TRIM_MAX_PPM 4000
 
 void rtc_init();
+uint8_t rtc_take_ticks();
+uint8_t rtc_schedule(uint8_t ticks);
+void rtc_set_seconds(uint32_t seconds);
+uint32_t rtc_step(int32_t seconds);
+int32_t rtc_slew(int32_t cycles);
+int32_t rtc_slew_pending();
+void rtc_set_trim(int16_t ppm);
 
 #endif /* RTC_H_ */
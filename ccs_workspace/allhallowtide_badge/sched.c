@@ -0,0 +1,72 @@
+/// Cooperative task scheduler for the main loop.
+/**
+ ** The main loop's work is split into tasks (see `sched_task_t`), which
+ ** become runnable when an ISR posts one of their `EV_*` bits, or when their
+ ** own run condition says so. Each call to `sched_run()` runs exactly one
+ ** task: the most urgent runnable one. Then the main loop calls it again.
+ ** That way, a slow task holds up the others for no more than its own run,
+ ** and once it's done, anything more urgent that came in goes first.
+ **
+ ** Tasks can't be preempted, so each one is given a budget of CPU cycles
+ ** for a single run. With `PROF_ENABLE`, every run is timed into the task's
+ ** profiler region, and runs over budget are counted in its `overruns`.
+ ** Without it, nothing is timed. A task that keeps overrunning should
+ ** split its work up over several runs.
+ **
+ ** The task that's running is the watchdog's owner (see wdt.c), by its
+ ** `prof_region`, so that a watchdog reset can say which one hung.
+ **
+ ** \file sched.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "prof.h"
+#include "sched.h"
+#include "wdt.h"
+
+/// Run the most urgent runnable task of `count` in `tasks`.
+/**
+ ** This must be called with interrupts disabled. If a task ran, it returns
+ ** true, with interrupts enabled. If nothing was runnable, it returns false,
+ ** with interrupts still disabled, so that the caller can go straight to
+ ** `power_sleep()` without missing an event posted in between.
+ */
+uint8_t sched_run(const sched_task_t *tasks, uint8_t count) {
+    const sched_task_t *task;
+    uint16_t events;
+#if PROF_ENABLE
+    uint16_t start;
+#endif
+
+    for (uint8_t i=0; i<count; i++) {
+        task = &tasks[i];
+        events = badge_events & task->events;
+
+        if (!events && !(task->ready && task->ready())) {
+            continue;
+        }
+
+        badge_events &= ~events;
+        wdt_owner = task->prof_region;
+        __bis_SR_register(GIE);
+
+#if PROF_ENABLE
+        start = TA1R;
+#endif
+        task->run(events);
+#if PROF_ENABLE
+        prof_record_budget(task->prof_region, TA1R - start, task->budget);
+#endif
+        wdt_owner = WDT_OWNER_NONE;
+        return 1;
+    }
+
+    return 0;
+}
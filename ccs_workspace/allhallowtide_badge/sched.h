@@ -0,0 +1,43 @@
+/// Header for the main loop's cooperative task scheduler.
+/**
+ ** \file sched.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdint.h>
+
+/// Function that does a task's work, given the `EV_*` bits it was run for.
+typedef void (*sched_run_t)(uint16_t events);
+/// Function that returns true if a task has work, apart from its events.
+typedef uint8_t (*sched_ready_t)();
+
+/// One task of the main loop.
+/**
+ ** Tables of these are const (FRAM-resident), in priority order, most
+ ** urgent first.
+ */
+typedef struct {
+    /// `EV_*` bits that make this task runnable. They're cleared as it runs.
+    uint16_t events;
+    /// Also makes this task runnable, if it returns true; may be 0.
+    /**
+     ** This is called with interrupts disabled, just before sleeping, so it
+     ** must be quick.
+     */
+    sched_ready_t ready;
+    /// Does the work.
+    sched_run_t run;
+    /// `PROF_*` region this task's runs are recorded in, and its ID.
+    uint8_t prof_region;
+    /// CPU cycles a single run should fit in, or it counts as an overrun.
+    uint16_t budget;
+} sched_task_t;
+
+uint8_t sched_run(const sched_task_t *tasks, uint8_t count);
+
+#endif /* SCHED_H_ */
@@ -0,0 +1,306 @@
+/// Factory self-test, run at boot until a board has passed it.
+/**
+ ** A board fresh off the line has never committed a config, so its config
+ ** slots are as they were programmed, and it boots with the defaults, where
+ ** `badge_conf.selftest_pending` is set. (A config that's lost to a bad CRC
+ ** later gets the defaults too, but not that.) Until it's cleared, every
+ ** boot runs the self-test, as one more stage of the background part of
+ ** startup, after the trim and the calibration. Each `SELFTEST_STAGE_*`
+ ** runs in turn, a step per system tick:
+ **
+ ** Stage | Passes if
+ ** :---  | :--------
+ ** HT16D | the LED controller's status register reads back what we set
+ ** CAPT  | every element's calibration converts to within range
+ ** ADC   | a temperature reading comes back, between the `SELFTEST_TEMP_*`
+ ** RTC   | the RTC counts ACLK at 32768 Hz against MCLK, give or take
+ ** LEDS  | always; the fixture (or whoever's watching) sees all 27 light
+ **
+ ** Each stage is timed in system ticks, and fails if it goes over its own
+ ** `SELFTEST_*_TICKS`. The stage budgets are checked against the whole
+ ** self-test's `SELFTEST_BUDGET_TICKS` at compile time, so that it can't
+ ** grow into a bottleneck on the fixture without somebody noticing. The
+ ** CPU time of each step is accounted to the boot task, like the rest of
+ ** startup, so with `PROF_ENABLE` its cycles show up there.
+ **
+ ** The LED stage lights one channel at a time, so the fixture's supply
+ ** only ever sees a single channel's current from the display.
+ **
+ ** The self-test owns the display while it runs. A board that passes
+ ** remembers it in its config, and goes on to the boot animation. A board
+ ** that fails shows red until it's reset, and runs the self-test again next
+ ** boot. Either way, `selftest_report` has the details, which the test
+ ** station can read back over the console, and which the console can also
+ ** re-arm the test with.
+ **
+ ** \file selftest.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "captivate.h"
+
+#include "badge.h"
+#include "capt_cal.h"
+#include "clock.h"
+#include "ht16d35a.h"
+#include "leds.h"
+#include "power.h"
+#include "rtc.h"
+#include "temp.h"
+
+#include "selftest.h"
+
+#if SELFTEST_HT16D_TICKS + SELFTEST_CAPT_TICKS + SELFTEST_ADC_TICKS \
+        + SELFTEST_RTC_TICKS + SELFTEST_LEDS_TICKS > SELFTEST_BUDGET_TICKS
+#error "The self-test's stage budgets are over SELFTEST_BUDGET_TICKS"
+#endif
+
+/// Stage step result: the stage isn't done yet; step it again next tick.
+#define SELFTEST_STEP_AGAIN 0
+/// Stage step result: the stage passed.
+#define SELFTEST_STEP_PASS  1
+/// Stage step result: the stage failed.
+#define SELFTEST_STEP_FAIL  2
+/// Stage step result: no result this time; start it over next tick.
+/**
+ ** The attempt doesn't count against the stage's budget, but only
+ ** `SELFTEST_RETRIES` of them are allowed before the stage fails.
+ */
+#define SELFTEST_STEP_RETRY 3
+
+/// The 32768 Hz ACLK, in cycles per `SELFTEST_RTC_CYCLES` MCLK cycles at 1 MHz.
+#define SELFTEST_RTC_COUNTS_1MHZ ((uint32_t) SELFTEST_RTC_CYCLES * 32768 / 1000000)
+
+/// Most system ticks each stage may take, by `SELFTEST_STAGE_*`.
+const uint8_t selftest_budgets[SELFTEST_STAGE_COUNT] = {
+    SELFTEST_HT16D_TICKS,
+    SELFTEST_CAPT_TICKS,
+    SELFTEST_ADC_TICKS,
+    SELFTEST_RTC_TICKS,
+    SELFTEST_LEDS_TICKS,
+};
+
+selftest_report_t selftest_report = {SELFTEST_STATE_IDLE, 0, {0,}};
+/// The `SELFTEST_STAGE_*` that's running.
+uint8_t selftest_stage = 0;
+/// True once the running stage has had its first step.
+uint8_t selftest_stage_started = 0;
+/// `rtc_ticks` when the running stage had its first step.
+uint16_t selftest_stage_start;
+/// Times the running stage has been started over.
+uint8_t selftest_stage_retries = 0;
+
+/// Show the color `r`, `g`, `b` on every LED.
+static void selftest_show(uint16_t r, uint16_t g, uint16_t b) {
+    rgbcolor16_t colors[HT16D_LED_COUNT];
+
+    for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
+        colors[i].r = r;
+        colors[i].g = g;
+        colors[i].b = b;
+    }
+    ht16d_put_colors(0, HT16D_LED_COUNT, colors);
+    leds_commit();
+}
+
+/// Stage step: check that the LED controller is there.
+static uint8_t selftest_ht16d() {
+    return ht16d_responding() ? SELFTEST_STEP_PASS : SELFTEST_STEP_FAIL;
+}
+
+/// Stage step: check the calibration that startup just did, or restored.
+static uint8_t selftest_capt() {
+    g_uiApp.ui8AppLPM = power_lpm_bits();
+    return capt_cal_verify(&g_uiApp) ? SELFTEST_STEP_PASS : SELFTEST_STEP_FAIL;
+}
+
+/// Stage step: take a temperature reading, and check it once it's in.
+static uint8_t selftest_adc(uint8_t first) {
+    int16_t degf;
+
+    if (first) {
+        temp_sample();
+    }
+    if (temp_sampling()) {
+        return SELFTEST_STEP_AGAIN;
+    }
+
+    degf = temp_degf();
+    if (degf < SELFTEST_TEMP_MIN_F || degf > SELFTEST_TEMP_MAX_F) {
+        return SELFTEST_STEP_FAIL;
+    }
+    return SELFTEST_STEP_PASS;
+}
+
+/// Read the RTC's counter, which runs from ACLK, and not the CPU's clock.
+/**
+ ** It's read until two reads agree, so that it isn't caught mid-count.
+ */
+static uint16_t selftest_rtc_count() {
+    uint16_t count;
+
+    do {
+        count = RTCCNT;
+    } while (count != RTCCNT);
+
+    return count;
+}
+
+/// Stage step: count ACLK cycles on the RTC across a fixed number of MCLK's.
+/**
+ ** If the RTC's period ends partway through, the count is no good. But that
+ ** leaves the counter at the start of a fresh period, so it's counted again
+ ** right away, which fits unless the slew or the trim has cut this period
+ ** short. If even that's no good, the stage starts over next tick.
+ */
+static uint8_t selftest_rtc() {
+    uint16_t gie = __get_SR_register() & GIE;
+    uint16_t start;
+    uint16_t end;
+    uint16_t expected = SELFTEST_RTC_COUNTS_1MHZ / clock_mhz();
+    uint16_t tolerance = (expected >> SELFTEST_RTC_TOLERANCE_SHIFT) + 1;
+
+    __bic_SR_register(GIE);
+    for (uint8_t i=0; i<2; i++) {
+        start = selftest_rtc_count();
+        __delay_cycles(SELFTEST_RTC_CYCLES);
+        end = selftest_rtc_count();
+        if (end >= start) {
+            break;
+        }
+    }
+    __bis_SR_register(gie);
+
+    if (end < start) {
+        return SELFTEST_STEP_RETRY;
+    }
+    if (end - start < expected - tolerance || end - start > expected + tolerance) {
+        return SELFTEST_STEP_FAIL;
+    }
+    return SELFTEST_STEP_PASS;
+}
+
+/// Stage step: light the next LED channel, if it's time, one at a time.
+static uint8_t selftest_leds(uint16_t elapsed) {
+    rgbcolor16_t colors[HT16D_LED_COUNT] = {0,};
+    uint8_t channel = elapsed / SELFTEST_LED_TICKS;
+
+    if (channel < HT16D_LED_COUNT * 3) {
+        // rgbcolor16_t is three channels in the LED controller's order.
+        ((uint16_t *) &colors[channel / 3])[channel % 3] = 0x7fff;
+    }
+    ht16d_put_colors(0, HT16D_LED_COUNT, colors);
+    leds_commit();
+
+    return channel < HT16D_LED_COUNT * 3 ? SELFTEST_STEP_AGAIN : SELFTEST_STEP_PASS;
+}
+
+/// Wrap up: record the outcome, and show it on the LEDs.
+static void selftest_finish() {
+    if (selftest_report.failed) {
+        selftest_report.state = SELFTEST_STATE_FAILED;
+        selftest_show(0x7fff, 0, 0);
+        return;
+    }
+
+    selftest_report.state = SELFTEST_STATE_PASSED;
+    badge_conf.selftest_pending = 0;
+    badge_conf_changed();
+    badge_conf_commit();
+    badge_anim_play(BADGE_ANIM_PUMPKIN_PULSE);
+}
+
+/// Arm the self-test for this boot, if this board hasn't passed it yet.
+/**
+ ** This must be called after `badge_conf_load()`, and before anything
+ ** wants the display.
+ */
+void selftest_init() {
+    if (!badge_conf.selftest_pending) {
+        return;
+    }
+
+    selftest_report.state = SELFTEST_STATE_RUNNING;
+    selftest_stage = 0;
+    selftest_stage_started = 0;
+    selftest_stage_retries = 0;
+}
+
+/// Returns true if the self-test has the display, now or for good.
+uint8_t selftest_active() {
+    return selftest_report.state == SELFTEST_STATE_RUNNING
+            || selftest_report.state == SELFTEST_STATE_FAILED;
+}
+
+/// Take the next step of the self-test, returning true once it's done.
+/**
+ ** Call this once per system tick, from the main loop, after the buttons
+ ** are up. It's done right away on a boot that doesn't run it.
+ */
+uint8_t selftest_step() {
+    uint8_t first;
+    uint16_t elapsed;
+    uint8_t result;
+
+    if (selftest_report.state != SELFTEST_STATE_RUNNING) {
+        return 1;
+    }
+
+    first = !selftest_stage_started;
+    if (first) {
+        selftest_stage_started = 1;
+        selftest_stage_start = rtc_ticks;
+    }
+    elapsed = rtc_ticks - selftest_stage_start;
+
+    switch (selftest_stage) {
+    case SELFTEST_STAGE_HT16D:
+        result = selftest_ht16d();
+        break;
+    case SELFTEST_STAGE_CAPT:
+        result = selftest_capt();
+        break;
+    case SELFTEST_STAGE_ADC:
+        result = selftest_adc(first);
+        break;
+    case SELFTEST_STAGE_RTC:
+        result = selftest_rtc();
+        break;
+    case SELFTEST_STAGE_LEDS:
+        result = selftest_leds(elapsed);
+        break;
+    default:
+        result = SELFTEST_STEP_PASS;
+        break;
+    }
+
+    if (result == SELFTEST_STEP_AGAIN && elapsed <= selftest_budgets[selftest_stage]) {
+        return 0;
+    }
+    if (result == SELFTEST_STEP_RETRY && selftest_stage_retries < SELFTEST_RETRIES) {
+        selftest_stage_retries++;
+        selftest_stage_started = 0;
+        return 0;
+    }
+
+    // A stage that's still going past its budget has failed, too.
+    selftest_report.ticks[selftest_stage] = elapsed;
+    if (result != SELFTEST_STEP_PASS || elapsed > selftest_budgets[selftest_stage]) {
+        selftest_report.failed |= 1 << selftest_stage;
+    }
+
+    selftest_stage_started = 0;
+    selftest_stage_retries = 0;
+    if (++selftest_stage < SELFTEST_STAGE_COUNT) {
+        return 0;
+    }
+
+    selftest_finish();
+    return 1;
+}
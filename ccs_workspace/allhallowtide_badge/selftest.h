@@ -0,0 +1,85 @@
+/// Header for the factory self-test.
+/**
+ ** \file selftest.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef SELFTEST_H_
+#define SELFTEST_H_
+
+#include <stdint.h>
+
+#include "ht16d35a.h"
+
+/// Stage: the LED controller answers a status read.
+#define SELFTEST_STAGE_HT16D    0
+/// Stage: every CapTIvate element's calibration is within range.
+#define SELFTEST_STAGE_CAPT     1
+/// Stage: the ADC takes a temperature reading, and it's a sane one.
+#define SELFTEST_STAGE_ADC      2
+/// Stage: the RTC counts ACLK at the right rate against MCLK.
+#define SELFTEST_STAGE_RTC      3
+/// Stage: each LED channel is lit in turn, for the fixture to check.
+#define SELFTEST_STAGE_LEDS     4
+/// The number of stages.
+#define SELFTEST_STAGE_COUNT    5
+
+/// System ticks each LED channel stays lit for in `SELFTEST_STAGE_LEDS`.
+#define SELFTEST_LED_TICKS 3
+
+/// Most system ticks `SELFTEST_STAGE_HT16D` may take.
+#define SELFTEST_HT16D_TICKS    1
+/// Most system ticks `SELFTEST_STAGE_CAPT` may take.
+#define SELFTEST_CAPT_TICKS     3
+/// Most system ticks `SELFTEST_STAGE_ADC` may take.
+#define SELFTEST_ADC_TICKS      3
+/// Most system ticks `SELFTEST_STAGE_RTC` may take.
+#define SELFTEST_RTC_TICKS      2
+/// Most system ticks `SELFTEST_STAGE_LEDS` may take.
+#define SELFTEST_LEDS_TICKS     (SELFTEST_LED_TICKS * HT16D_LED_COUNT * 3 + 1)
+/// Most system ticks the whole self-test may take, so the fixture keeps up.
+/**
+ ** This is on top of the trim and calibration that every boot does first.
+ */
+#define SELFTEST_BUDGET_TICKS   150
+
+/// Coolest temperature, in degrees F, that the test floor could be.
+#define SELFTEST_TEMP_MIN_F 40
+/// Warmest temperature, in degrees F, that the test floor could be.
+#define SELFTEST_TEMP_MAX_F 110
+
+/// MCLK cycles that `SELFTEST_STAGE_RTC` counts ACLK cycles across.
+#define SELFTEST_RTC_CYCLES 8000
+/// The RTC passes if it's within 1/2^this, and a count, of the expected.
+#define SELFTEST_RTC_TOLERANCE_SHIFT 3
+/// Times a stage can start over, without counting against its budget.
+#define SELFTEST_RETRIES 4
+
+/// Report state: this boot didn't run the self-test.
+#define SELFTEST_STATE_IDLE     0
+/// Report state: the self-test is running.
+#define SELFTEST_STATE_RUNNING  1
+/// Report state: every stage passed, in time.
+#define SELFTEST_STATE_PASSED   2
+/// Report state: at least one stage failed, or went over its budget.
+#define SELFTEST_STATE_FAILED   3
+
+/// What the self-test found, for the fixture to read back.
+typedef struct {
+    /// One of `SELFTEST_STATE_*`.
+    uint8_t state;
+    /// Bitmask, by `SELFTEST_STAGE_*`, of the stages that failed.
+    uint8_t failed;
+    /// System ticks each stage took, by `SELFTEST_STAGE_*`.
+    uint8_t ticks[SELFTEST_STAGE_COUNT];
+} selftest_report_t;
+
+extern selftest_report_t selftest_report;
+
+void selftest_init();
+uint8_t selftest_active();
+uint8_t selftest_step();
+
+#endif /* SELFTEST_H_ */
@@ -0,0 +1,360 @@
+/// Badge-to-badge state sync over IR.
+/**
+ ** Badges trade four things: the set of badge IDs each has seen (by
+ ** contact, or by hearing about them from a badge that has), which
+ ** animations are unlocked, the time, and how much their clocks can be
+ ** trusted. Unlocks and seen IDs spread: whatever a badge hears about, it
+ ** takes on. The time goes the other way: see `sync_rx_clock()`.
+ **
+ ** Our beacon is a digest of all of it, short enough to send every window:
+ **
+ ** Byte | Digest frame
+ ** :--- | :-----------
+ ** 0    | `SYNC_TYPE(SYNC_KIND_DIGEST)`
+ ** 1    | our ID
+ ** 2    | `badge_conf.clock_authority`
+ ** 3-4  | `badge_conf.unlocked`, little endian
+ ** 5-6  | CRC-16 of our seen bitmap, little endian
+ ** 7-10 | `rtc_seconds`, little endian, as the window opened
+ ** 11   | `rtc_centiseconds`, likewise
+ **
+ ** The unlocks are small enough to go in the digest as they are. The seen
+ ** bitmap isn't, so only its hash does. When a peer's hash differs from
+ ** ours, we follow up with the bitmap, leaving out words that are all zero:
+ **
+ ** Byte | Seen frame
+ ** :--- | :---------
+ ** 0    | `SYNC_TYPE(SYNC_KIND_SEEN)`
+ ** 1    | our ID
+ ** 2    | bitmask of which of the `SYNC_SEEN_WORDS` words follow
+ ** 3-   | those words, little endian, lowest first
+ **
+ ** Once two badges have traded, their digests match, and from then on
+ ** neither sends anything but its beacon. That matters most in a crowd,
+ ** where airtime is what runs out first.
+ **
+ ** \file sync.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "ir.h"
+#include "rtc.h"
+
+#include "sync.h"
+
+/// The address of this chip's TLV die record: lot, wafer, and position.
+#define SYNC_TLV_DIE_RECORD ((const uint16_t *) 0x1A0A)
+
+/// This badge's ID, from 0 to `BADGE_ID_COUNT`-1.
+uint8_t sync_id;
+/// Our digest frame, which the IR driver sends as our beacon.
+uint8_t sync_digest[SYNC_DIGEST_LEN];
+/// `rtc_ticks` when we last sent our seen bitmap.
+uint16_t sync_seen_sent_at = 0;
+/// True if we've sent our seen bitmap since boot.
+uint8_t sync_seen_sent = 0;
+/// `rtc_seconds` when our drift baseline was taken, at a sync.
+/**
+ ** That's the last sync that measured our drift, or stepped our clock, or
+ ** the first since boot. Syncs in between only slew, so they leave it be.
+ */
+uint32_t sync_clock_at = 0;
+/// ACLK cycles slewed in since `sync_clock_at`, not counting any still pending.
+/**
+ ** That's every slew asked for since then, after the one the baseline's own
+ ** sync asked for, less whatever of each was replaced before it went in.
+ */
+int32_t sync_clock_slewed = 0;
+/// True if we've synced our clock since boot.
+uint8_t sync_clock_synced = 0;
+/// How fast our clock ran between the last two syncs, in ppm, trim and all.
+int16_t sync_drift_ppm = 0;
+/// True once `sync_drift_ppm` holds an actual measurement.
+uint8_t sync_drift_valid = 0;
+
+/// Compute the CRC-16 of our seen bitmap. Main loop only.
+static uint16_t sync_seen_hash() {
+    CRCINIRES = 0xFFFF;
+    for (uint8_t i=0; i<sizeof(badge_conf.seen); i++) {
+        CRCDI_L = badge_conf.seen[i];
+    }
+    return CRCINIRES;
+}
+
+/// Mark badge `id` as seen.
+static void sync_mark_seen(uint8_t id) {
+    uint8_t bit = 1 << (id & 7);
+
+    if (id >= BADGE_ID_COUNT || (badge_conf.seen[id >> 3] & bit)) {
+        return;
+    }
+    badge_conf.seen[id >> 3] |= bit;
+    badge_conf_changed();
+}
+
+/// Rebuild our digest from `badge_conf`.
+/**
+ ** Anything that changes the unlocks, the seen bitmap, or the clock
+ ** authority should call this afterwards, so our beacon says so.
+ */
+void sync_refresh() {
+    uint16_t hash = sync_seen_hash();
+
+    sync_digest[0] = SYNC_TYPE(SYNC_KIND_DIGEST);
+    sync_digest[1] = sync_id;
+    sync_digest[2] = badge_conf.clock_authority;
+    sync_digest[3] = badge_conf.unlocked & 0xff;
+    sync_digest[4] = badge_conf.unlocked >> 8;
+    sync_digest[5] = hash & 0xff;
+    sync_digest[6] = hash >> 8;
+    sync_stamp();
+
+    ir_set_shared_schedule(badge_conf.clock_authority > 0);
+}
+
+/// Put the current time into our digest.
+/**
+ ** The IR driver calls this (through `badge_ir_beacon()`) just before it
+ ** copies the digest to send it, at the start of each window.
+ */
+void sync_stamp() {
+    uint16_t gie = __get_SR_register() & GIE;
+    uint32_t seconds;
+    uint8_t centiseconds;
+
+    __bic_SR_register(GIE);
+    seconds = rtc_seconds;
+    centiseconds = rtc_centiseconds;
+    __bis_SR_register(gie);
+
+    sync_digest[7] = seconds & 0xff;
+    sync_digest[8] = (seconds >> 8) & 0xff;
+    sync_digest[9] = (seconds >> 16) & 0xff;
+    sync_digest[10] = seconds >> 24;
+    sync_digest[11] = centiseconds;
+}
+
+/// Estimate our drift from a sync `cycles` ACLK cycles behind our peer.
+/**
+ ** Whatever the baseline's sync left for the RTC to slew is still in
+ ** there, so it comes off first, and whatever the syncs since have slewed
+ ** in goes back on. What's left is how far we drifted since the baseline,
+ ** with the RTC's trim already in effect, so half of it goes onto the trim.
+ ** Taking only half keeps one sync with a bad latency from throwing the
+ ** trim too far, and over a few syncs it settles on the REFO's error.
+ **
+ ** Returns true if this took a measurement, even one too far out to use,
+ ** so that the next one is measured from here.
+ */
+static uint8_t sync_estimate_drift(int32_t cycles) {
+    uint32_t elapsed = rtc_seconds - sync_clock_at;
+    int32_t ppm;
+
+    if (!sync_clock_synced || elapsed < SYNC_DRIFT_MIN_SECS) {
+        return 0;
+    }
+
+    cycles += sync_clock_slewed - rtc_slew_pending();
+    // cycles/32768 seconds over `elapsed` seconds, in ppm, is
+    //  cycles * 1000000 / 32768 / elapsed, and 1000000/32768 is 15625/512.
+    ppm = -(cycles * 15625 / 512) / (int32_t) elapsed;
+    if (ppm > INT16_MAX || ppm < INT16_MIN) {
+        return 1;
+    }
+
+    sync_drift_ppm = ppm;
+    sync_drift_valid = 1;
+
+    ppm = badge_conf.rtc_trim_ppm + ppm / 2;
+    if (ppm > RTC_TRIM_MAX_PPM) {
+        ppm = RTC_TRIM_MAX_PPM;
+    } else if (ppm < -RTC_TRIM_MAX_PPM) {
+        ppm = -RTC_TRIM_MAX_PPM;
+    }
+    badge_conf.rtc_trim_ppm = ppm;
+    badge_conf_changed();
+    rtc_set_trim(ppm);
+    return 1;
+}
+
+/// Set our clock by a peer's digest, if the peer's clock is more trusted.
+/**
+ ** Authority counts down one hop at a time from a badge whose clock was
+ ** set by hand, at `BADGE_CLOCK_AUTHORITY_MAX`, so that the time always
+ ** flows from a badge closer to it. An error of up to a second is slewed
+ ** in gradually by the RTC; anything bigger is stepped out in whole
+ ** seconds, along with slewing the rest.
+ **
+ ** Badges in contact sync every cycle, far more often than drift can be
+ ** measured, so the drift baseline is only moved on by a measurement or a
+ ** step (or the first sync). Every other sync's slew is added up, instead.
+ */
+static void sync_rx_clock(const uint8_t *payload) {
+    uint16_t gie = __get_SR_register() & GIE;
+    int32_t offset;
+    int32_t step;
+    int32_t cycles;
+    uint8_t rebase;
+    uint32_t peer;
+    uint32_t seconds;
+    uint8_t centiseconds;
+
+    if (payload[2] <= badge_conf.clock_authority) {
+        return;
+    }
+
+    peer = payload[7] | ((uint32_t) payload[8] << 8) |
+            ((uint32_t) payload[9] << 16) | ((uint32_t) payload[10] << 24);
+
+    __bic_SR_register(GIE);
+    seconds = rtc_seconds;
+    centiseconds = rtc_centiseconds;
+    __bis_SR_register(gie);
+
+    // How far our clock is behind the peer's, in seconds and ticks. The
+    //  seconds are only scaled to ticks when they're few enough to fit,
+    //  since a peer can be any number of days off.
+    step = (int32_t) (peer - seconds);
+    offset = payload[11] + SYNC_LATENCY_TICKS - centiseconds;
+    if (step >= -1 && step <= 1) {
+        offset += step * 100;
+        step = 0;
+    }
+    if (step || offset >= SYNC_STEP_TICKS || offset <= -SYNC_STEP_TICKS) {
+        step += offset / 100;
+        offset %= 100;
+        rebase = 1;
+    } else {
+        rebase = sync_estimate_drift(offset * 32768 / 100) || !sync_clock_synced;
+    }
+    cycles = offset * 32768 / 100;
+
+    if (rebase) {
+        rtc_slew(cycles);
+        sync_clock_at = seconds + step;
+        sync_clock_slewed = 0;
+        sync_clock_synced = 1;
+    } else {
+        sync_clock_slewed += cycles - rtc_slew(cycles);
+    }
+    if (step) {
+        badge_step_time(step);
+    }
+    badge_set_authority(payload[2] - 1);
+}
+
+/// Send the set words of our seen bitmap, unless we just did.
+/**
+ ** Every peer we're out of step with asks for it, and they're all listening
+ ** at once, so it's sent at most once per IR cycle.
+ */
+static void sync_send_seen() {
+    uint8_t frame[3 + 2*SYNC_SEEN_WORDS];
+    uint8_t len = 3;
+
+    if (sync_seen_sent && (uint16_t) (rtc_ticks - sync_seen_sent_at) < IR_CYCLE_TICKS) {
+        return;
+    }
+
+    frame[0] = SYNC_TYPE(SYNC_KIND_SEEN);
+    frame[1] = sync_id;
+    frame[2] = 0;
+    for (uint8_t i=0; i<SYNC_SEEN_WORDS; i++) {
+        if (badge_conf.seen[2*i] || badge_conf.seen[2*i+1]) {
+            frame[2] |= 1 << i;
+            frame[len++] = badge_conf.seen[2*i];
+            frame[len++] = badge_conf.seen[2*i+1];
+        }
+    }
+
+    if (ir_send(frame, len)) {
+        sync_seen_sent = 1;
+        sync_seen_sent_at = rtc_ticks;
+    }
+}
+
+/// Take on everything in peer's seen frame that we didn't have.
+static void sync_rx_seen(const uint8_t *payload, uint8_t len) {
+    uint8_t mask = payload[2];
+    uint8_t at = 3;
+
+    for (uint8_t i=0; i<SYNC_SEEN_WORDS; i++) {
+        if (!(mask & (1 << i))) {
+            continue;
+        }
+        if (at+2 > len) {
+            return;
+        }
+        if ((payload[at] & ~badge_conf.seen[2*i]) || (payload[at+1] & ~badge_conf.seen[2*i+1])) {
+            badge_conf.seen[2*i] |= payload[at];
+            badge_conf.seen[2*i+1] |= payload[at+1];
+            badge_conf_changed();
+        }
+        at += 2;
+    }
+}
+
+/// Handle a sync frame from another badge.
+void sync_rx(const uint8_t *payload, uint8_t len) {
+    uint16_t unlocked;
+
+    if (len < 2 || (payload[0] >> 4) != SYNC_VERSION || payload[1] == sync_id) {
+        return;
+    }
+
+    sync_mark_seen(payload[1]);
+
+    switch (payload[0] & 0x0f) {
+    case SYNC_KIND_DIGEST:
+        if (len < SYNC_DIGEST_LEN) {
+            return;
+        }
+
+        sync_rx_clock(payload);
+
+        unlocked = payload[3] | ((uint16_t) payload[4] << 8);
+        if (unlocked & ~badge_conf.unlocked) {
+            badge_conf.unlocked |= unlocked;
+            badge_conf_changed();
+        }
+
+        // Refresh first, so a peer we've only just marked seen counts.
+        sync_refresh();
+        if (payload[5] != sync_digest[5] || payload[6] != sync_digest[6]) {
+            sync_send_seen();
+        }
+        return;
+    case SYNC_KIND_SEEN:
+        if (len < 3) {
+            return;
+        }
+        sync_rx_seen(payload, len);
+        break;
+    default:
+        return;
+    }
+
+    sync_refresh();
+}
+
+/// Work out our ID, and start beaconing our digest.
+/**
+ ** The ID is a hash of the chip's die record, so it's the same from boot
+ ** to boot with no setup, but two badges can come out with the same one.
+ ** That just means they count as each other.
+ */
+void sync_init() {
+    uint16_t hash = SYNC_TLV_DIE_RECORD[0] ^ SYNC_TLV_DIE_RECORD[1] ^
+                    SYNC_TLV_DIE_RECORD[2] ^ SYNC_TLV_DIE_RECORD[3];
+
+    sync_id = (hash ^ (hash >> 7) ^ (hash >> 14)) % BADGE_ID_COUNT;
+    sync_refresh();
+    ir_set_beacon(sync_digest, SYNC_DIGEST_LEN);
+}
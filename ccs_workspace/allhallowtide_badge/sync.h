@@ -0,0 +1,49 @@
+/// Header for badge-to-badge state sync over IR.
+/**
+ ** \file sync.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef SYNC_H_
+#define SYNC_H_
+
+#include <stdint.h>
+
+#include "badge.h"
+
+/// Version of the sync protocol; frames from any other are ignored.
+#define SYNC_VERSION        1
+/// Frame kind: our digest, which is also our beacon.
+#define SYNC_KIND_DIGEST    0
+/// Frame kind: the set words of our seen bitmap.
+#define SYNC_KIND_SEEN      1
+/// First byte of a sync frame of kind `kind`.
+#define SYNC_TYPE(kind)     ((SYNC_VERSION << 4) | (kind))
+
+/// Length of a digest frame.
+#define SYNC_DIGEST_LEN     12
+/// System ticks from stamping our beacon to a peer finishing receiving it.
+/**
+ ** That's the wait for the window to let us transmit, and the frame's
+ ** airtime. Any MAC backoff comes on top, and shows up as clock error.
+ */
+#define SYNC_LATENCY_TICKS  3
+/// Ticks of error that are stepped out at once, rather than slewed.
+#define SYNC_STEP_TICKS     100
+/// Fewest seconds between syncs for them to say anything about drift.
+#define SYNC_DRIFT_MIN_SECS 600
+/// Words in the seen bitmap.
+#define SYNC_SEEN_WORDS     (BADGE_ID_COUNT / 16)
+
+extern uint8_t sync_id;
+extern int16_t sync_drift_ppm;
+extern uint8_t sync_drift_valid;
+
+void sync_init();
+void sync_refresh();
+void sync_stamp();
+void sync_rx(const uint8_t *payload, uint8_t len);
+
+#endif /* SYNC_H_ */
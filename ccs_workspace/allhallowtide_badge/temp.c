@@ -0,0 +1,264 @@
+/// Duty-cycled temperature sampler, on the ADC and internal sensor.
+/**
+ ** The internal reference and temperature sensor together draw far more
+ ** than the rest of the badge does asleep, and we only need a reading a
+ ** few times a minute. So they're off except for a short burst every
+ ** `TEMP_SAMPLE_SECS` seconds: we turn them on, let them settle, take
+ ** 2^`TEMP_OVERSAMPLE_SHIFT` conversions back to back from the ISR, and
+ ** turn everything off again as soon as the last one is in. The average of
+ ** the burst is the reading.
+ **
+ ** The hot and cold unlock thresholds are converted to raw ADC codes once,
+ ** at init, so judging a reading is just a shift and two compares. (The
+ ** ADC's window comparator would only see each conversion on its own, not
+ ** the average, so it isn't used.) Showing a reading in degrees F goes
+ ** through `temp_table`, which is one load, instead of the calibration's
+ ** multiply and two divides.
+ **
+ ** \file temp.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "badge.h"
+#include "fram.h"
+#include "power.h"
+#include "rtc.h"
+#include "trace.h"
+
+#include "temp.h"
+
+/// Pointer to 30 degC temperature sensor calibration, per datasheet.
+#define CALADC_15V_30C  *((unsigned int *)0x1A1A)
+/// Pointer to 85 degC temperature sensor calibration, per datasheet.
+#define CALADC_15V_85C  *((unsigned int *)0x1A1C)
+
+/// Entries of `temp_table` built per FRAM write.
+#define TEMP_TABLE_CHUNK 16
+
+#if TEMP_TABLE_LEN % TEMP_TABLE_CHUNK
+#error "TEMP_TABLE_LEN must be a multiple of TEMP_TABLE_CHUNK"
+#endif
+
+volatile uint16_t temp_code = 0;
+/// Readings at or above this ADC code are hot.
+uint16_t temp_hot_code;
+/// Readings at or below this ADC code are cold.
+uint16_t temp_cold_code;
+/// Sum of the conversions so far in this burst.
+volatile uint16_t temp_sum = 0;
+/// Conversions so far in this burst.
+volatile uint8_t temp_count = 0;
+/// True while a burst is running.
+volatile uint8_t temp_busy = 0;
+
+/// Degrees F of every ADC code the sensor can give, for this chip.
+/**
+ ** The calibration is this chip's own, so this can't be a const table; it's
+ ** built the first time we boot with a given calibration, which after a
+ ** flash is the first boot, and kept in FRAM.
+ */
+#pragma PERSISTENT(temp_table)
+temp_table_t temp_table = {0};
+
+/// Get the temperature sensor's ADC code for `degf` degrees Fahrenheit.
+/**
+ ** This is the inverse of the datasheet's conversion, from this chip's
+ ** calibration:
+ **
+ **     degC = (code - CAL30) * (85-30) / (CAL85 - CAL30) + 30
+ **     degF = degC * 9/5 + 32
+ **
+ ** which, solved for the code, comes out to
+ **
+ **     code = CAL30 + (5*degF - 430) * (CAL85 - CAL30) / 495
+ */
+static uint16_t temp_code_for_degf(int16_t degf) {
+    int32_t span = (int32_t) CALADC_15V_85C - CALADC_15V_30C;
+
+    return CALADC_15V_30C + ((int32_t) (5*degf - 430) * span) / 495;
+}
+
+/// Convert the ADC code `code` to degrees Fahrenheit.
+/**
+ ** This is the datasheet's conversion, from this chip's calibration, the
+ ** other way around from `temp_code_for_degf()`:
+ **
+ **     degF = ((code - CAL30) * 495 / (CAL85 - CAL30) + 430) / 5
+ **
+ ** It's only used to build `temp_table`, and clamps to the table's range.
+ */
+static uint8_t temp_table_entry(uint16_t code) {
+    int32_t span = (int32_t) CALADC_15V_85C - CALADC_15V_30C;
+    int16_t degf = (((int32_t) code - CALADC_15V_30C) * 495 / span + 430) / 5;
+
+    if (degf < TEMP_TABLE_MIN_F) {
+        degf = TEMP_TABLE_MIN_F;
+    } else if (degf > TEMP_TABLE_MAX_F) {
+        degf = TEMP_TABLE_MAX_F;
+    }
+    return degf - TEMP_TABLE_MIN_F;
+}
+
+/// Build `temp_table` from this chip's calibration, unless it already is.
+/**
+ ** This is a division per entry, which is tens of milliseconds at boot, but
+ ** only ever once per chip and firmware image. It's written a chunk at a
+ ** time, through a buffer on the stack.
+ */
+static void temp_table_build() {
+    uint16_t base = temp_code_for_degf(TEMP_TABLE_MIN_F);
+    uint16_t cal;
+    uint8_t chunk[TEMP_TABLE_CHUNK];
+
+    if (temp_table.cal30 == CALADC_15V_30C && temp_table.cal85 == CALADC_15V_85C) {
+        return;
+    }
+
+    for (uint16_t i=0; i<TEMP_TABLE_LEN; i+=sizeof(chunk)) {
+        for (uint8_t j=0; j<sizeof(chunk); j++) {
+            chunk[j] = temp_table_entry(base + i + j);
+        }
+        fram_write(&temp_table.degf[i], chunk, sizeof(chunk));
+    }
+    fram_write(&temp_table.base, &base, sizeof(base));
+
+    // The calibration goes in last, so that an interrupted build is redone.
+    cal = CALADC_15V_85C;
+    fram_write(&temp_table.cal85, &cal, sizeof(cal));
+    cal = CALADC_15V_30C;
+    fram_write(&temp_table.cal30, &cal, sizeof(cal));
+}
+
+/// Convert the latest reading to degrees Fahrenheit.
+/**
+ ** Readings off either end of `temp_table` are clamped to it. Nothing on
+ ** the badge needs this but the console and the self-test; the unlocks only
+ ** compare codes.
+ */
+int16_t temp_degf() {
+    uint16_t code = temp_code;
+
+    if (code < temp_table.base) {
+        code = temp_table.base;
+    } else if (code - temp_table.base >= TEMP_TABLE_LEN) {
+        code = temp_table.base + TEMP_TABLE_LEN - 1;
+    }
+    return TEMP_TABLE_MIN_F + temp_table.degf[code - temp_table.base];
+}
+
+/// Turn the internal reference and temperature sensor on or off.
+static void temp_ref_enable(uint8_t enable) {
+    PMMCTL0_H = PMMPW_H;                        // Unlock the PMM registers
+    if (enable) {
+        PMMCTL2 |= INTREFEN | TSENSOREN;
+    } else {
+        PMMCTL2 &= ~(INTREFEN | TSENSOREN);
+    }
+    PMMCTL0_H = 0;                              // and lock them again.
+}
+
+/// Set up the ADC for single, software-triggered temperature conversions.
+/**
+ ** The ADC, the reference, and the sensor are all left off until the
+ ** first burst.
+ */
+void temp_init() {
+    ADCCTL0 |= ADCSHT_8;                        // temperature sample period>30us
+    ADCCTL1 |= ADCSHP;                          // s/w trig, single ch/conv, MODOSC
+    ADCCTL2 |= ADCRES;                          // 10-bit conversion results
+    ADCMCTL0 |= ADCSREF_1 | ADCINCH_12;         // ADC input ch A12 => temp sense
+    ADCIE |= ADCIE0;                            // Interrupt on each completed conversion
+
+    temp_hot_code = temp_code_for_degf(BADGE_UNLOCK_TEMP_OVER_S00);
+    temp_cold_code = temp_code_for_degf(BADGE_UNLOCK_TEMP_UNDER_S01);
+    temp_table_build();
+
+    temp_ref_enable(0);
+}
+
+/// Start a burst of conversions now, unless one is already running.
+/**
+ ** `temp_code` has the reading once `temp_sampling()` goes false.
+ */
+void temp_sample() {
+    if (temp_busy) {
+        return;
+    }
+
+    temp_busy = 1;
+    temp_sum = 0;
+    temp_count = 0;
+
+    temp_ref_enable(1);
+    __delay_cycles(TEMP_SETTLE_CYCLES);
+
+    // Hold SMCLK for the conversions, like TI's examples, which sleep in
+    //  LPM0 while the ADC runs. The ISR lets it go after the last one.
+    power_need(POWER_CLIENT_ADC, POWER_CLOCK_SMCLK);
+    ADCCTL0 |= ADCON;
+    ADCCTL0 |= ADCENC | ADCSC;
+}
+
+/// Returns true while a burst of conversions is running.
+uint8_t temp_sampling() {
+    return temp_busy;
+}
+
+/// Take a reading, if it's time. Call this from the main loop every second.
+void temp_second() {
+    if (!(rtc_seconds % TEMP_SAMPLE_SECS)) {
+        temp_sample();
+    }
+}
+
+/// ADC interrupt service routine.
+/**
+ ** Each conversion is added to the burst's sum, and the next one started,
+ ** until there are enough. Then everything is turned off, and the average
+ ** is compared against the thresholds.
+ */
+#pragma vector=ADC_VECTOR
+__interrupt void ADC_ISR(void)
+{
+    TRACE_ISR_ENTER();
+
+    switch(__even_in_range(ADCIV,ADCIV_ADCIFG))
+    {
+        case ADCIV_ADCIFG:
+            temp_sum += ADCMEM0; // Reading the result clears the flag.
+
+            if (++temp_count < (1 << TEMP_OVERSAMPLE_SHIFT)) {
+                ADCCTL0 |= ADCSC;
+                break;
+            }
+
+            ADCCTL0 &= ~ADCENC;
+            ADCCTL0 &= ~ADCON;
+            temp_ref_enable(0);
+            power_need(POWER_CLIENT_ADC, POWER_CLOCK_NONE);
+
+            temp_code = temp_sum >> TEMP_OVERSAMPLE_SHIFT;
+            temp_busy = 0;
+
+            if (temp_code >= temp_hot_code) {
+                badge_events |= EV_HOT;
+            } else if (temp_code <= temp_cold_code) {
+                badge_events |= EV_COLD;
+            } else {
+                break;
+            }
+
+            LPM4_EXIT;
+            break;
+        default:
+            break;
+    }
+
+    TRACE_ISR_EXIT();
+}
@@ -0,0 +1,62 @@
+/// Header for the temperature sampler.
+/**
+ ** \file temp.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef TEMP_H_
+#define TEMP_H_
+
+#include <stdint.h>
+
+/// Seconds between temperature readings.
+#define TEMP_SAMPLE_SECS 16
+/// Each reading averages 2^this conversions.
+#define TEMP_OVERSAMPLE_SHIFT 3
+/// MCLK cycles to wait for the reference and sensor to settle once enabled.
+#define TEMP_SETTLE_CYCLES 400
+/// Coolest temperature, in degrees F, that `temp_degf()` reports.
+#define TEMP_TABLE_MIN_F -40
+/// Warmest temperature, in degrees F, that `temp_degf()` reports.
+/**
+ ** With `TEMP_TABLE_MIN_F`, this is the MSP430's whole operating range.
+ ** Every degree in between is a byte of `temp_table_t`, so it must be at
+ ** most 255 degrees wider.
+ */
+#define TEMP_TABLE_MAX_F 185
+/// ADC codes that `temp_table_t` converts.
+/**
+ ** The sensor moves a little over 2 codes per degree C, against the 1.5 V
+ ** reference, so this covers the range from `TEMP_TABLE_MIN_F` to
+ ** `TEMP_TABLE_MAX_F` with room to spare for a chip's own slope.
+ */
+#define TEMP_TABLE_LEN 384
+
+#if TEMP_TABLE_MAX_F - TEMP_TABLE_MIN_F > 255
+#error "TEMP_TABLE_MIN_F to TEMP_TABLE_MAX_F must fit in a byte"
+#endif
+
+/// The ADC code to degrees F table, as it sits in FRAM.
+typedef struct {
+    /// This chip's 30 degC calibration that the table was built from.
+    uint16_t cal30;
+    /// This chip's 85 degC calibration that the table was built from.
+    uint16_t cal85;
+    /// The ADC code of `degf[0]`.
+    uint16_t base;
+    /// Degrees F, less `TEMP_TABLE_MIN_F`, of each code from `base` up.
+    uint8_t degf[TEMP_TABLE_LEN];
+} temp_table_t;
+
+/// The averaged ADC code of the last reading, or 0 before the first.
+extern volatile uint16_t temp_code;
+
+void temp_init();
+void temp_second();
+void temp_sample();
+uint8_t temp_sampling();
+int16_t temp_degf();
+
+#endif /* TEMP_H_ */
@@ -0,0 +1,71 @@
+/// GPIO trace pins, for timing on a logic analyzer or scope.
+/**
+ ** With `TRACE_ENABLE` set, spare pins that `init_io()` already drives low
+ ** are raised and lowered around the things we care about for the power
+ ** budget, so they can be lined up against a current probe:
+ **
+ ** Pin  | High while
+ ** :--  | :---------
+ ** P1.3 | the CPU is awake (everywhere but inside `power_sleep()`)
+ ** P1.7 | an ISR of ours (or CapTIvate's) is running
+ ** P2.0 | an SPI transfer to the LED controller is in flight
+ ** P2.1 | an IR UART transmission is in flight
+ **
+ ** The time from a P1.7 edge to the following P1.3 edge is our wakeup
+ ** latency, and the P1.3 duty cycle is our active time per tick. The
+ ** CapTIvate library's own waits for conversions don't go through
+ ** `power_sleep()`, so they show as awake, with the CapTIvate ISR on P1.7.
+ **
+ ** Each of these is a single read-modify-write instruction, so they're
+ ** safe from both ISRs and the main loop, and they compile to nothing
+ ** without `TRACE_ENABLE`.
+ **
+ ** \file trace.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <msp430.h>
+
+/// Nonzero to drive the trace pins. Set it from the build's defines.
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE 0
+#endif
+
+#if TRACE_ENABLE
+
+/// The CPU is about to go to sleep.
+#define TRACE_SLEEP()       (P1OUT &= ~BIT3)
+/// The CPU is awake again.
+#define TRACE_WAKE()        (P1OUT |= BIT3)
+/// An ISR has started.
+#define TRACE_ISR_ENTER()   (P1OUT |= BIT7)
+/// An ISR is returning.
+#define TRACE_ISR_EXIT()    (P1OUT &= ~BIT7)
+/// An SPI transfer has started.
+#define TRACE_SPI_START()   (P2OUT |= BIT0)
+/// An SPI transfer has finished.
+#define TRACE_SPI_DONE()    (P2OUT &= ~BIT0)
+/// A UART transmission has started.
+#define TRACE_UART_START()  (P2OUT |= BIT1)
+/// A UART transmission has finished.
+#define TRACE_UART_DONE()   (P2OUT &= ~BIT1)
+
+#else
+
+#define TRACE_SLEEP()
+#define TRACE_WAKE()
+#define TRACE_ISR_ENTER()
+#define TRACE_ISR_EXIT()
+#define TRACE_SPI_START()
+#define TRACE_SPI_DONE()
+#define TRACE_UART_START()
+#define TRACE_UART_DONE()
+
+#endif
+
+#endif /* TRACE_H_ */
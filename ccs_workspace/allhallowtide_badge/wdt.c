@@ -0,0 +1,106 @@
+/// Watchdog supervisor.
+/**
+ ** The watchdog runs from ACLK with a 4 second period, and the main loop's
+ ** tick task pats it. In normal running, the tick task comes around at
+ ** least once a second, so if we go 4 seconds without one, something is
+ ** stuck, and the reset gets us going again.
+ **
+ ** Some jobs legitimately take longer than any one task should, like a full
+ ** CapTIvate calibration. Those run as supervised operations: they call
+ ** `wdt_op_begin()`, then `wdt_op_yield()` after each chunk of work, which
+ ** starts a new watchdog period, up to `WDT_OP_MAX_CHUNKS` times, and then
+ ** `wdt_op_end()`. A job that's truly hung still gets reset, just later.
+ **
+ ** Whoever holds the watchdog (a task, by its ID, or a supervised
+ ** operation) is tracked in `wdt_owner`, in RAM that isn't initialized at
+ ** startup. A watchdog reset leaves RAM alone, so `wdt_init()`, on the way
+ ** back up, can still see who it was, and records them in FRAM, in
+ ** `wdt_record`, for reading out of a badge that's been acting up.
+ **
+ ** \file wdt.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "fram.h"
+#include "wdt.h"
+
+/// Who holds the watchdog: a task's `PROF_TASK_*`, or a `WDT_OP_*`.
+#pragma NOINIT(wdt_owner)
+volatile uint8_t wdt_owner;
+/// Extensions the current supervised operation has taken.
+#pragma NOINIT(wdt_op_chunks)
+volatile uint8_t wdt_op_chunks;
+/// Owner to return to at `wdt_op_end()`.
+uint8_t wdt_op_prev_owner = WDT_OWNER_NONE;
+
+/// What the last watchdog reset caught.
+#pragma PERSISTENT(wdt_record)
+wdt_record_t wdt_record = {0, WDT_OWNER_NONE, 0};
+
+/// Record who held the watchdog if it just reset us, and start it.
+/**
+ ** This should be called first thing in `main()`, before anything else can
+ ** change `wdt_owner`.
+ */
+void wdt_init() {
+    uint16_t reason;
+    wdt_record_t record;
+
+    // Reading SYSRSTIV takes the highest priority reason off, so go through
+    //  all of them.
+    while ((reason = SYSRSTIV)) {
+        if (reason == SYSRSTIV_WDTTO) {
+            record.resets = wdt_record.resets < 0xffff ? wdt_record.resets + 1 : 0xffff;
+            record.owner = wdt_owner;
+            record.chunks = wdt_op_chunks;
+            fram_write(&wdt_record, &record, sizeof(record));
+        }
+    }
+
+    wdt_owner = WDT_OWNER_NONE;
+    wdt_op_chunks = 0;
+    wdt_pet();
+}
+
+/// Start a new 4-second watchdog period.
+void wdt_pet() {
+    WDTCTL = WDTPW | WDTSSEL__ACLK | WDTIS__128K | WDTCNTCL; // 4 second WDT
+}
+
+/// Start a supervised operation `op`, which may run past the watchdog.
+void wdt_op_begin(uint8_t op) {
+    wdt_op_prev_owner = wdt_owner;
+    wdt_op_chunks = 0;
+    wdt_owner = op;
+    wdt_pet();
+}
+
+/// Mark the end of a chunk of the current supervised operation.
+/**
+ ** This starts another watchdog period, unless the operation has already
+ ** had `WDT_OP_MAX_CHUNKS` of them, in which case the watchdog is left to
+ ** go off.
+ */
+void wdt_op_yield() {
+    if (wdt_op_chunks < WDT_OP_MAX_CHUNKS) {
+        wdt_op_chunks++;
+        wdt_pet();
+    }
+}
+
+/// Finish the current supervised operation.
+/**
+ ** The watchdog gets a fresh period, so that whoever started the operation
+ ** has the time it expected left.
+ */
+void wdt_op_end() {
+    wdt_owner = wdt_op_prev_owner;
+    wdt_op_chunks = 0;
+    wdt_pet();
+}
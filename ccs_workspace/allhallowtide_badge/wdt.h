@@ -0,0 +1,47 @@
+/// Header for the watchdog supervisor.
+/**
+ ** \file wdt.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef WDT_H_
+#define WDT_H_
+
+#include <stdint.h>
+
+/// `wdt_owner` while the main loop is between tasks, or asleep.
+#define WDT_OWNER_NONE      0xff
+/// Owner ID for the DCO software trim. Task IDs are their `PROF_TASK_*`.
+#define WDT_OP_DCO_TRIM     0x80
+/// Owner ID for a full CapTIvate calibration.
+#define WDT_OP_CAPT_CAL     0x81
+
+/// Most times one supervised operation may extend the watchdog.
+/**
+ ** Each extension is a fresh watchdog period, so this bounds a supervised
+ ** operation to about a minute, after which it's assumed to be stuck.
+ */
+#define WDT_OP_MAX_CHUNKS   16
+
+/// What the last watchdog reset caught, kept in FRAM across resets.
+typedef struct {
+    /// Watchdog resets since this was first written. Stops at 0xffff.
+    uint16_t resets;
+    /// `wdt_owner` when the watchdog went off.
+    uint8_t owner;
+    /// Chunks the owner had taken, if it was a supervised operation.
+    uint8_t chunks;
+} wdt_record_t;
+
+extern volatile uint8_t wdt_owner;
+extern wdt_record_t wdt_record;
+
+void wdt_init();
+void wdt_pet();
+void wdt_op_begin(uint8_t op);
+void wdt_op_yield();
+void wdt_op_end();
+
+#endif /* WDT_H_ */
@@ -0,0 +1,183 @@
+/// Host benchmarks for the badge's hot paths.
+/**
+ ** Each benchmark runs an operation many times over the real badge source,
+ ** built natively against the HAL shim in hal.c, and reports nanoseconds
+ ** per operation. This is for comparing versions of an algorithm while
+ ** iterating on it, and catching regressions, without flashing a badge.
+ **
+ ** The host is nothing like an MSP430, so nanoseconds don't convert to
+ ** cycles by any fixed rate. To get a rough projection, profile one
+ ** reference operation on the badge (build with `PROF_ENABLE` and read the
+ ** `PROF_LEDS_TIMESTEP` average), and pass its cycles on the command line:
+ **
+ **     ./bench 4200
+ **
+ ** Every other operation is then projected by its time relative to that
+ ** one. That holds up as long as the operations are similar kinds of work,
+ ** so take it as a guide, not a measurement. In particular, the CRC16
+ ** module is done in software by the HAL, so the IR numbers overstate what
+ ** the CRC costs on the badge.
+ **
+ ** \file bench.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "hal.h"
+
+#include "animations.h"
+#include "badge.h"
+#include "deadline.h"
+#include "ht16d35a.h"
+#include "ir.h"
+#include "leds.h"
+#include "rtc.h"
+
+/// Default number of times to run each operation.
+#define BENCH_ITERATIONS 200000
+
+/// One benchmark: a name, and a function that runs its operation once.
+typedef struct {
+    const char *name;
+    void (*run)(uint32_t i);
+} bench_t;
+
+/// Written by the benchmarks, so nothing they compute is optimized away.
+volatile uint32_t bench_sink;
+
+/// Deadlines for `bench_deadlines()`.
+static deadline_t bench_deadline[8];
+
+// From badge.c, for the brightness level in leds.c.
+badge_conf_t badge_conf;
+
+void badge_conf_changed() {
+}
+
+static void bench_deadline_cb(uint8_t arg) {
+    bench_sink += arg;
+}
+
+/// One animated tick: interpolate, gamma correct, and send the frame.
+static void bench_leds_tick(uint32_t i) {
+    if (!leds_is_animating()) {
+        leds_start(&anim_pumpkin_pulse);
+    }
+    leds_timestep(1);
+}
+
+/// Put a new color on every LED, through the gamma LUT.
+static void bench_put_colors(uint32_t i) {
+    rgbcolor16_t colors[HT16D_LED_COUNT];
+
+    for (uint8_t j=0; j<HT16D_LED_COUNT; j++) {
+        colors[j].r = ((i + j) * 0x1357) & 0x7fff;
+        colors[j].g = ((i + j) * 0x2b6d) & 0x7fff;
+        colors[j].b = ((i + j) * 0x4e9b) & 0x7fff;
+    }
+    ht16d_put_colors(0, HT16D_LED_COUNT, colors);
+}
+
+/// Build and send a frame after every LED has changed.
+static void bench_send_gray(uint32_t i) {
+    bench_put_colors(i);
+    ht16d_send_gray();
+    hal_spi_run();
+}
+
+/// Frame a full size IR packet, send it, receive it, and check it.
+static void bench_ir_loopback(uint32_t i) {
+    uint8_t wire[IR_PAYLOAD_MAX + IR_FRAME_OVERHEAD];
+    uint8_t payload[IR_PAYLOAD_MAX];
+    uint8_t len;
+
+    for (uint8_t j=0; j<IR_PAYLOAD_MAX; j++) {
+        payload[j] = i + j;
+    }
+    if (!ir_send(payload, IR_PAYLOAD_MAX)) {
+        return;
+    }
+    len = hal_uart_tx_drain(wire, sizeof(wire));
+    hal_uart_rx(wire, len);
+    ir_handle_rx();
+    bench_sink += ir_stats.rx_frames;
+}
+
+/// Start eight deadlines, and let a tick's worth of them pass.
+static void bench_deadlines(uint32_t i) {
+    for (uint8_t j=0; j<8; j++) {
+        bench_deadline[j].cb = bench_deadline_cb;
+        bench_deadline[j].arg = j;
+        deadline_start(&bench_deadline[j], (j * 7 + i) & 15);
+    }
+    rtc_ticks += 8;
+    deadline_timestep();
+}
+
+/// Every benchmark. The first is the reference for cycle projections.
+static const bench_t bench_list[] = {
+    {"leds_timestep (animated tick)", bench_leds_tick},
+    {"ht16d_put_colors (all LEDs)", bench_put_colors},
+    {"ht16d_send_gray (full frame)", bench_send_gray},
+    {"ir frame loopback (32 bytes)", bench_ir_loopback},
+    {"deadline start x8 + timestep", bench_deadlines},
+};
+
+/// Returns the monotonic clock, in nanoseconds.
+static uint64_t bench_now() {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t ref_cycles = argc > 1 ? strtoul(argv[1], 0, 0) : 0;
+    uint32_t iterations = argc > 2 ? strtoul(argv[2], 0, 0) : BENCH_ITERATIONS;
+    double ref_ns = 0;
+    double ns;
+    uint64_t start;
+    uint32_t spi_bytes;
+
+    ht16d_init();
+    leds_init();
+
+    printf("%-32s %10s %10s %10s\n", "operation", "ns/op", "SPI B/op", "cycles");
+    for (uint8_t b=0; b<sizeof(bench_list)/sizeof(bench_list[0]); b++) {
+        spi_bytes = hal_spi_bytes;
+        start = bench_now();
+        for (uint32_t i=0; i<iterations; i++) {
+            bench_list[b].run(i);
+        }
+        ns = (double) (bench_now() - start) / iterations;
+        spi_bytes = hal_spi_bytes - spi_bytes;
+
+        if (!b) {
+            ref_ns = ns;
+        }
+
+        printf("%-32s %10.1f %10.1f ", bench_list[b].name, ns,
+               (double) spi_bytes / iterations);
+        if (ref_cycles) {
+            printf("%10.0f\n", ns * ref_cycles / ref_ns);
+        } else {
+            printf("%10s\n", "-");
+        }
+    }
+
+    // The loopback should never lose a frame; if it does, the numbers
+    //  above are for the wrong code path.
+    if (ir_stats.rx_bad_crc || ir_stats.rx_overflows) {
+        printf("\nir loopback FAILED: %u bad CRC, %u overflows\n",
+               ir_stats.rx_bad_crc, ir_stats.rx_overflows);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+/// Host HAL shim, standing in for the MSP430's peripherals and drivers.
+/**
+ ** The hosted badge modules talk to "registers" that are just variables
+ ** here, and this plays the part of the hardware behind them: it runs the
+ ** SPI and UART ISRs by hand, byte by byte, and does the CRC16 module's
+ ** arithmetic. It also stands in for the modules that are all hardware
+ ** (the RTC and the low power mode arbiter) and for the application-level
+ ** callbacks in badge.c.
+ **
+ ** \file hal.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdint.h>
+
+#include <msp430fr2633.h>
+
+#include "hal.h"
+
+volatile uint8_t P1OUT, P1REN, P1SEL0, P2OUT;
+volatile uint16_t UCA0CTLW0, UCA0BRW, UCA0MCTLW, UCA0STATW, UCA0RXBUF,
+    UCA0TXBUF, UCA0IRCTL, UCA0IE, UCA0IFG, UCA0IV;
+volatile uint16_t UCB0CTLW0, UCB0BRW, UCB0TXBUF, UCB0RXBUF, UCB0IE, UCB0IFG, UCB0IV;
+
+uint32_t hal_spi_bytes = 0;
+
+// From rtc.c:
+volatile uint16_t rtc_ticks = 0;
+volatile uint8_t rtc_centiseconds = 0;
+volatile uint32_t rtc_seconds = 0;
+
+// From main.c:
+volatile uint16_t badge_events = 0;
+
+/// CRC16 module result register.
+static volatile uint16_t hal_crc_result = 0;
+/// CRC16 module data input register.
+static volatile uint16_t hal_crc_input = 0;
+/// True if `hal_crc_input` has been handed out, and may have been written.
+static uint8_t hal_crc_pending = 0;
+
+/// Fold a byte written to `CRCDI_L` into the result, as the module does.
+/**
+ ** The CRC16 module computes CRC-CCITT (0x1021), taking the bits of each
+ ** byte written to `CRCDI` least significant first.
+ */
+static void hal_crc_flush() {
+    uint8_t data = hal_crc_input;
+
+    if (!hal_crc_pending) {
+        return;
+    }
+    hal_crc_pending = 0;
+
+    for (uint8_t i=0; i<8; i++) {
+        uint8_t feedback = ((hal_crc_result >> 15) ^ (data >> i)) & 1;
+        hal_crc_result <<= 1;
+        if (feedback) {
+            hal_crc_result ^= 0x1021;
+        }
+    }
+}
+
+/// Access `CRCDI_L`. The byte written is folded in on the next access.
+volatile uint16_t *hal_crc_di(void) {
+    hal_crc_flush();
+    hal_crc_pending = 1;
+    return &hal_crc_input;
+}
+
+/// Access `CRCINIRES`, with every byte written so far folded in.
+volatile uint16_t *hal_crc_res(void) {
+    hal_crc_flush();
+    return &hal_crc_result;
+}
+
+/// Run the SPI transfer in flight, if any, until it's finished.
+void hal_spi_run() {
+    while (UCB0IE & UCRXIE) {
+        hal_spi_bytes++;
+        UCB0IV = USCI_SPI_UCRXIFG;
+        EUSCI_B0_ISR();
+    }
+}
+
+/// Run the IR UART transmitter until it's idle, capturing up to `max` bytes.
+/**
+ ** \return The number of bytes it sent.
+ */
+uint8_t hal_uart_tx_drain(uint8_t *buf, uint8_t max) {
+    uint8_t len = 0;
+
+    UCA0IE |= UCTXIE;
+    while (1) {
+        UCA0IV = USCI_UART_UCTXIFG;
+        EUSCI_A0_ISR();
+        if (!(UCA0IE & UCTXIE)) {
+            break;
+        }
+        if (len < max) {
+            buf[len++] = UCA0TXBUF;
+        }
+    }
+
+    UCA0IV = USCI_UART_UCTXCPTIFG;
+    EUSCI_A0_ISR();
+
+    return len;
+}
+
+/// Feed `len` bytes to the IR UART receiver, as though they'd been heard.
+void hal_uart_rx(const uint8_t *buf, uint8_t len) {
+    UCA0STATW = 0;
+    for (uint8_t i=0; i<len; i++) {
+        UCA0RXBUF = buf[i];
+        UCA0IV = USCI_UART_UCRXIFG;
+        EUSCI_A0_ISR();
+    }
+}
+
+// From power.c. Nothing sleeps on the host: the only thing anything ever
+//  waits on is the LED controller's SPI bus, so waiting just runs it.
+
+void power_need(uint8_t client, uint8_t clock) {
+}
+
+uint16_t power_lpm_bits() {
+    return LPM4_bits;
+}
+
+void power_sleep() {
+    hal_spi_run();
+}
+
+// From badge.c.
+
+void badge_ir_beacon() {
+}
+
+void badge_ir_rx(uint8_t *payload, uint8_t len) {
+}
@@ -0,0 +1,25 @@
+/// Header for the host HAL shim.
+/**
+ ** \file hal.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HAL_H_
+#define HAL_H_
+
+#include <stdint.h>
+
+/// Bytes that have gone out on the LED controller's SPI bus.
+extern uint32_t hal_spi_bytes;
+
+// The target's ISRs, which the HAL calls in place of the hardware.
+void EUSCI_A0_ISR(void);
+void EUSCI_B0_ISR(void);
+
+void hal_spi_run();
+uint8_t hal_uart_tx_drain(uint8_t *buf, uint8_t max);
+void hal_uart_rx(const uint8_t *buf, uint8_t len);
+
+#endif /* HAL_H_ */
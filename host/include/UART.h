@@ -0,0 +1,15 @@
+/// Host stand-in for the CapTIvate COMM layer's UART driver.
+/**
+ ** Only the transmit queue calls the console makes are here. The tests
+ ** provide them, and take whatever the console queues as sent.
+ */
+#ifndef HOST_UART_H_
+#define HOST_UART_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+extern bool UART_transmitBuffer(const uint8_t *pBuffer, uint16_t ui16Length);
+extern bool UART_isBufferQueued(const uint8_t *pBuffer);
+
+#endif /* HOST_UART_H_ */
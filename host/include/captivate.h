@@ -0,0 +1,17 @@
+/// Host stand-in for the CapTIvate library's top level header.
+/**
+ ** The only thing the hosted modules take from CapTIvate is which COMM
+ ** interface is configured, and on the host it's none, so that the IR
+ ** link is built. The console is built with `-DCAPT_INTERFACE=1`, the
+ ** UART interface, for the tests.
+ */
+#ifndef HOST_CAPTIVATE_H_
+#define HOST_CAPTIVATE_H_
+
+#define __CAPT_NO_INTERFACE__       0
+#define __CAPT_UART_INTERFACE__     1
+#ifndef CAPT_INTERFACE
+#define CAPT_INTERFACE              __CAPT_NO_INTERFACE__
+#endif
+
+#endif /* HOST_CAPTIVATE_H_ */
@@ -0,0 +1,2 @@
+/// Host stand-in for MSP430 DriverLib, which nothing on the host calls.
+#include "msp430fr2633.h"
@@ -0,0 +1,2 @@
+/// Host stand-in for the generic MSP430 device header.
+#include "msp430fr2633.h"
@@ -0,0 +1,100 @@
+/// Host stand-in for the MSP430FR2633 device header.
+/**
+ ** Just enough of the device header for the hardware-independent badge
+ ** modules (and the drivers they lean on) to compile natively. Peripheral
+ ** registers are plain variables, defined in hal.c, that the HAL reads and
+ ** writes to play the part of the hardware. Intrinsics that only matter on
+ ** the target (interrupt enables, low power modes) do nothing.
+ **
+ ** \file msp430fr2633.h
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#ifndef HOST_MSP430FR2633_H_
+#define HOST_MSP430FR2633_H_
+
+#include <stdint.h>
+
+// Intrinsics. There's only one thread of control on the host, and the HAL
+//  calls ISRs itself, so interrupts are never "enabled" or "disabled."
+#define __interrupt
+#define __even_in_range(x, y) (x)
+#define __bis_SR_register(x) ((void) (x))
+#define __bic_SR_register(x) ((void) (x))
+#define __bis_SR_register_on_exit(x) ((void) (x))
+#define __bic_SR_register_on_exit(x) ((void) (x))
+#define __get_SR_register() (0u)
+#define __delay_cycles(x) ((void) (x))
+#define __no_operation() ((void) 0)
+
+// Status register bits.
+#define GIE         0x0008
+#define CPUOFF      0x0010
+#define OSCOFF      0x0020
+#define SCG0        0x0040
+#define SCG1        0x0080
+#define LPM0_bits   (CPUOFF)
+#define LPM3_bits   (SCG1 | SCG0 | CPUOFF)
+#define LPM4_bits   (SCG1 | SCG0 | OSCOFF | CPUOFF)
+#define LPM4_EXIT   ((void) 0)
+
+#define BIT0 0x01
+#define BIT1 0x02
+#define BIT2 0x04
+#define BIT3 0x08
+#define BIT4 0x10
+#define BIT5 0x20
+#define BIT6 0x40
+#define BIT7 0x80
+
+// Digital I/O.
+extern volatile uint8_t P1OUT, P1REN, P1SEL0, P2OUT;
+
+// eUSCI_A0 (the IR UART) and eUSCI_B0 (the LED controller's SPI).
+extern volatile uint16_t UCA0CTLW0, UCA0BRW, UCA0MCTLW, UCA0STATW, UCA0RXBUF,
+    UCA0TXBUF, UCA0IRCTL, UCA0IE, UCA0IFG, UCA0IV;
+extern volatile uint16_t UCB0CTLW0, UCB0BRW, UCB0TXBUF, UCB0RXBUF, UCB0IE, UCB0IFG,
+    UCB0IV;
+
+#define UCSWRST         0x0001
+#define UCSYNC          0x0100
+#define UCMST           0x0800
+#define UCMSB           0x2000
+#define UCCKPL          0x4000
+#define UCCKPH          0x8000
+#define UCSSEL_2        0x0080
+#define UCSSEL__SMCLK   0x0080
+#define UCOS16          0x0001
+#define UCBRF_1         0x0010
+#define UCBRF_8         0x0080
+#define UCIREN          0x0001
+#define UCIRTXCLK       0x0002
+#define UCIRTXPL0       0x0004
+#define UCIRTXPL2       0x0010
+#define UCIRRXPL        0x0200
+#define UCPE            0x0010
+#define UCOE            0x0020
+#define UCFE            0x0040
+#define UCRXIE          0x0001
+#define UCTXIE          0x0002
+#define UCTXCPTIE       0x0008
+#define UCRXIFG         0x0001
+#define UCTXIFG         0x0002
+#define UCTXCPTIFG      0x0008
+
+#define USCI_UART_UCRXIFG       0x0002
+#define USCI_UART_UCTXIFG       0x0004
+#define USCI_UART_UCTXCPTIFG    0x0008
+#define USCI_SPI_UCRXIFG        0x0002
+#define USCI_SPI_UCTXIFG        0x0004
+
+// The CRC16 module. Every access goes through the HAL, which does the
+//  CRC-CCITT arithmetic that the hardware would as each byte is written.
+extern volatile uint16_t *hal_crc_di(void);
+extern volatile uint16_t *hal_crc_res(void);
+#define CRCDI_L     (*hal_crc_di())
+#define CRCINIRES   (*hal_crc_res())
+
+#endif /* HOST_MSP430FR2633_H_ */
@@ -0,0 +1,230 @@
+/// Host tests for the badge's hardware-independent modules.
+/**
+ ** These run the real badge source, built natively against the HAL shim in
+ ** hal.c, and check what it does against what it should: that the console
+ ** never writes past its response frame, however a batch overfills it, and
+ ** that the pumpkin pulse still lights the LEDs exactly as it did before
+ ** animations were packed into palettes and runs. Each test prints what
+ ** failed, and the program returns nonzero if anything did.
+ **
+ ** The console is built with the CapTIvate UART interface, which the rest
+ ** of the host build doesn't have, and the modules it calls that aren't
+ ** hosted are stubbed out below.
+ **
+ ** \file test.c
+ ** \author George Louthan
+ ** \date   2022
+ ** \copyright (c) 2022 George Louthan @duplico. MIT License.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <msp430fr2633.h>
+
+#include "hal.h"
+
+#include "animations.h"
+#include "badge.h"
+#include "console.h"
+#include "ht16d35a.h"
+#include "leds.h"
+#include "selftest.h"
+
+/// FNV-1a hash of every LED's gray levels, every tick, of the pumpkin pulse.
+/**
+ ** This is from the animation as it was before it was packed, one whole
+ ** frame of colors per keyframe, and it should only change along with what
+ ** the animation looks like.
+ */
+#define TEST_PUMPKIN_PULSE_HASH 0x5ad198b5
+/// System ticks the pumpkin pulse runs for.
+#define TEST_PUMPKIN_PULSE_TICKS 280
+
+extern uint8_t ht16d_gs_values[HT16D_LED_COUNT][3];
+extern uint8_t console_tx_frame[CONSOLE_PAYLOAD_MAX + CONSOLE_FRAME_OVERHEAD];
+
+/// The number of checks that have failed.
+static uint16_t test_failures = 0;
+
+/// The response the console last queued, and its length.
+static const uint8_t *test_tx_buf;
+static uint16_t test_tx_len;
+
+/// Count a failure, and say what it was, unless `ok`.
+static void test_check(bool ok, const char *what) {
+    if (!ok) {
+        printf("FAILED: %s\n", what);
+        test_failures++;
+    }
+}
+
+// From UART.c. Anything queued is as good as sent, for the next request.
+
+bool UART_transmitBuffer(const uint8_t *pBuffer, uint16_t ui16Length) {
+    test_tx_buf = pBuffer;
+    test_tx_len = ui16Length;
+    return true;
+}
+
+bool UART_isBufferQueued(const uint8_t *pBuffer) {
+    return false;
+}
+
+// From badge.c, selftest.c, sync.c, and temp.c.
+
+badge_conf_t badge_conf;
+selftest_report_t selftest_report;
+uint8_t sync_id = 0;
+volatile uint16_t temp_code = 0;
+
+void badge_conf_changed() {
+}
+
+void badge_conf_commit() {
+}
+
+void badge_set_time(uint32_t clock) {
+}
+
+void badge_set_authority(uint8_t authority) {
+}
+
+void badge_anim_play(uint8_t id) {
+}
+
+void sync_refresh() {
+}
+
+int16_t temp_degf() {
+    return 70;
+}
+
+void rtc_set_trim(int16_t ppm) {
+}
+
+/// Compute a console frame's CRC-16, as the console does.
+static uint16_t test_crc16(uint8_t len, const uint8_t *payload) {
+    CRCINIRES = 0xFFFF;
+    CRCDI_L = len;
+    for (uint8_t i=0; i<len; i++) {
+        CRCDI_L = payload[i];
+    }
+    return CRCINIRES;
+}
+
+/// Send request `req` to the console, and return its response's length.
+/**
+ ** The response's payload is left in `console_tx_frame`. Returns -1, after
+ ** counting a failure, if there's no response, or it isn't framed right.
+ */
+static int test_console_request(const uint8_t *req, uint8_t len) {
+    uint16_t crc = test_crc16(len, req);
+
+    test_tx_len = 0;
+    console_rx_byte(CONSOLE_SYNC_BYTE);
+    console_rx_byte(len);
+    for (uint8_t i=0; i<len; i++) {
+        console_rx_byte(req[i]);
+    }
+    console_rx_byte(crc >> 8);
+    console_rx_byte(crc & 0xff);
+    console_handle_rx();
+
+    if (!test_tx_len || test_tx_buf != console_tx_frame) {
+        test_check(false, "console: no response");
+        return -1;
+    }
+    len = console_tx_frame[1];
+    crc = test_crc16(len, &console_tx_frame[2]);
+    if (len > CONSOLE_PAYLOAD_MAX || test_tx_len != len + CONSOLE_FRAME_OVERHEAD
+            || console_tx_frame[0] != CONSOLE_SYNC_BYTE
+            || console_tx_frame[2 + len] != (crc >> 8)
+            || console_tx_frame[3 + len] != (crc & 0xff)) {
+        test_check(false, "console: response frame is malformed");
+        return -1;
+    }
+    return len;
+}
+
+/// Overfill a batch by every amount, and end it every way there is.
+/**
+ ** `n` version commands fill the response 4 bytes at a time, and then
+ ** another command fails to decode, fails its argument, or may not fit.
+ ** Whatever stops the batch has to be able to say so, in the frame, and
+ ** the frame is never over `CONSOLE_PAYLOAD_MAX`.
+ */
+static void test_console_overfill() {
+    static const uint8_t tails[][3] = {
+        // The last command, and what it gets when there's room for it.
+        {0xFF, 0, CONSOLE_ERR_CMD},
+        {CONSOLE_CMD_CONF_GET, CONSOLE_CONF_COUNT, CONSOLE_ERR_ARG},
+        {CONSOLE_CMD_CONF_GET, CONSOLE_CONF_SEEN, CONSOLE_OK},
+    };
+    uint8_t req[CONSOLE_PAYLOAD_MAX];
+    uint8_t ran;    // Version commands that should fit.
+    uint8_t at;     // Where the result that stops the batch should be.
+    uint8_t result;
+    int len;
+
+    for (uint8_t t=0; t<sizeof(tails)/sizeof(tails[0]); t++) {
+        for (uint8_t n=0; n<=CONSOLE_PAYLOAD_MAX / 4 + 1; n++) {
+            memset(req, CONSOLE_CMD_VERSION, n);
+            memcpy(&req[n], tails[t], 2);
+            len = test_console_request(req, n + 2);
+            if (len < 0) {
+                continue;
+            }
+
+            // Every command's result, and what it returns, leaves room
+            //  for one more result byte after it.
+            ran = n < (CONSOLE_PAYLOAD_MAX - 1) / 4 ? n : (CONSOLE_PAYLOAD_MAX - 1) / 4;
+            at = ran * 4;
+            result = tails[t][2];
+            if (ran < n || (result == CONSOLE_OK && at + 1 + 16 > CONSOLE_PAYLOAD_MAX - 1)) {
+                result = CONSOLE_ERR_FULL;
+            }
+
+            test_check(len == at + 1 + (result == CONSOLE_OK ? 16 : 0),
+                       "console: overfilled batch has the wrong length");
+            test_check(len > at && console_tx_frame[2 + at] == result,
+                       "console: overfilled batch has the wrong result");
+        }
+    }
+}
+
+/// Play the pumpkin pulse, and check it against `TEST_PUMPKIN_PULSE_HASH`.
+static void test_pumpkin_pulse() {
+    uint32_t hash = 2166136261u;
+    uint16_t ticks;
+
+    ht16d_init();
+    leds_init();
+    leds_start(&anim_pumpkin_pulse);
+    for (ticks=0; ticks<2000 && leds_is_animating(); ticks++) {
+        leds_timestep(1);
+        hal_spi_run();
+        for (uint8_t i=0; i<HT16D_LED_COUNT; i++) {
+            for (uint8_t c=0; c<3; c++) {
+                hash = (hash ^ ht16d_gs_values[i][c]) * 16777619u;
+            }
+        }
+    }
+
+    test_check(ticks == TEST_PUMPKIN_PULSE_TICKS, "pumpkin pulse: wrong length");
+    test_check(hash == TEST_PUMPKIN_PULSE_HASH, "pumpkin pulse: frames changed");
+}
+
+int main(int argc, char *argv[]) {
+    test_console_overfill();
+    test_pumpkin_pulse();
+
+    if (test_failures) {
+        printf("%u checks FAILED\n", test_failures);
+        return 1;
+    }
+    printf("all tests passed\n");
+    return 0;
+}
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+"""Static memory budget report, from the TI linker's map file.
+
+Every input section in the map's SECTION ALLOCATION MAP is charged to the
+module (object file, or library) it came from, and to the memory region
+(RAM, FRAM, or INFO) its address falls in, per the map's own MEMORY
+CONFIGURATION. The result is a table of what each module costs, sorted by
+RAM, since that's the scarce one, followed by each region's total against
+its size.
+
+Uninitialized globals are allocated by the linker as `.common:<name>`, with
+nothing in the map to say whose they are. If the linker's XML link info is
+next to the map (both CCS configurations write `<project>_linkInfo.xml`),
+it's used to charge them to the module that defines them. Otherwise, a
+symbol goes to the module whose name starts with the symbol's first word
+(so `ht16d_dirty` goes to `ht16d35a`), and to `(common)` if there isn't
+exactly one.
+
+This runs as the post-build step of both configurations. With `--ram-limit`
+or `--fram-limit`, it fails the build if a region is over the given number
+of bytes, which can be less than the region, to keep some headroom.
+
+    mem_budget.py [--ram-limit BYTES] [--fram-limit BYTES] [--xml FILE] MAP
+
+(c) 2022 George Louthan @duplico. MIT License.
+"""
+
+import argparse
+import os
+import re
+import sys
+import xml.etree.ElementTree as ET
+
+#: The regions we report on, and which of the map's memory ranges are in them.
+REGIONS = (
+    ('RAM', ('RAM', 'TINYRAM')),
+    ('FRAM', ('FRAM',)),
+    ('INFO', ('INFO',)),
+)
+
+#: An output section header: name, page, origin, length, attributes.
+SECTION_RE = re.compile(r'^(\S+)?\s+(\d+)\s+([0-9a-fA-F]{8})\s+([0-9a-fA-F]{8})\s*(.*)$')
+#: An input section: origin, length, and where it's from.
+INPUT_RE = re.compile(r'^\s+([0-9a-fA-F]{8})\s+([0-9a-fA-F]{8})\s+(.*)$')
+#: Where an input section is from: `[lib : ]obj (section)`, or `(section)`.
+SOURCE_RE = re.compile(r'^(?:(\S+)\s+:\s+)?(\S+)?\s*\(([^)]*)\)')
+#: A memory range in MEMORY CONFIGURATION: name, origin, length.
+MEMORY_RE = re.compile(r'^\s+(\S+)\s+([0-9a-fA-F]{8})\s+([0-9a-fA-F]{8})\s')
+
+
+def module_name(lib, obj):
+    """Name the module an input section is from: its library, or its object."""
+    if lib:
+        return os.path.basename(lib)
+    return re.sub(r'\.(c\.)?(obj|o)$', '', os.path.basename(obj))
+
+
+def parse_map(path):
+    """Read the memory ranges and input sections out of the map at `path`.
+
+    Returns `(ranges, inputs)`: `ranges` is a list of `(name, origin,
+    length)`, and `inputs` a list of `(module, section, origin, length)`,
+    where `module` is None for linker-allocated `.common` symbols, and
+    `(padding)` for holes.
+    """
+    ranges = []
+    inputs = []
+    part = None
+    skip = False
+
+    with open(path) as f:
+        for line in f:
+            line = line.rstrip('\n')
+
+            if line.startswith('MEMORY CONFIGURATION'):
+                part = 'memory'
+                continue
+            if line.startswith('SECTION ALLOCATION MAP'):
+                part = 'sections'
+                continue
+            if line.startswith('LINKER GENERATED') or line.startswith('GLOBAL SYMBOLS'):
+                part = None
+                continue
+
+            if part == 'memory':
+                m = MEMORY_RE.match(line)
+                if m:
+                    ranges.append((m.group(1), int(m.group(2), 16), int(m.group(3), 16)))
+                continue
+
+            if part != 'sections' or not line.strip():
+                continue
+
+            # Long output section names go on a line of their own, and the
+            #  rest of the header on the next, starting with `*`.
+            if not line[0].isspace():
+                m = SECTION_RE.match(line.replace('*', ' ', 1) if line.startswith('*') else line)
+                if m:
+                    # Debug info and the like isn't loaded, and its addresses
+                    #  overlap the real ones.
+                    skip = 'COPY' in m.group(5) or 'DSECT' in m.group(5)
+                continue
+
+            m = INPUT_RE.match(line)
+            if not m or skip:
+                continue
+            origin = int(m.group(1), 16)
+            length = int(m.group(2), 16)
+            source = m.group(3).strip()
+
+            if source.startswith('--HOLE--'):
+                inputs.append(('(padding)', '', origin, length))
+                continue
+
+            s = SOURCE_RE.match(source)
+            if not s:
+                continue
+            lib, obj, section = s.groups()
+            if obj:
+                module = module_name(lib, obj)
+            elif section.startswith('.common:'):
+                module = None
+            else:
+                module = '(linker)'
+            inputs.append((module, section, origin, length))
+
+    return ranges, inputs
+
+
+def parse_link_info(path):
+    """Map each `.common` symbol to its module, from the XML link info."""
+    owners = {}
+    tree = ET.parse(path)
+    files = {}
+
+    for f in tree.iter('input_file'):
+        name = f.findtext('name') or f.findtext('file') or ''
+        lib = None
+        if f.findtext('kind') == 'archive':
+            lib = name
+        files[f.get('id')] = module_name(lib, name)
+
+    for oc in tree.iter('object_component'):
+        name = oc.findtext('name') or ''
+        ref = oc.find('input_file_ref')
+        if name.startswith('.common:') and ref is not None and ref.get('idref') in files:
+            owners[name] = files[ref.get('idref')]
+
+    return owners
+
+
+def guess_owner(section, modules):
+    """Guess a `.common` symbol's module from its name; None if we can't."""
+    symbol = re.sub(r'^g_', '', section.split(':', 1)[1]).lower()
+    word = symbol.split('_')[0]
+
+    # A module whose whole name starts the symbol's is the best match...
+    prefixes = [m for m in modules if symbol.startswith(m.lower())]
+    if prefixes:
+        return max(prefixes, key=len)
+    # ...and otherwise one that starts with the same word, like `ht16d35a`
+    #  for `ht16d`, but not `ht16d_gamma`, which is its own word.
+    matches = [m for m in modules if word and m.lower().startswith(word)
+               and not m[len(word):].startswith('_')]
+    if len(matches) == 1:
+        return matches[0]
+    return None
+
+
+def region_of(address, ranges):
+    """Name the `REGIONS` entry that `address` is in, or None."""
+    for name, origin, length in ranges:
+        if origin <= address < origin + length:
+            for region, members in REGIONS:
+                if name in members:
+                    return region
+            return None
+    return None
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Per-module RAM/FRAM budget from a TI linker map.')
+    parser.add_argument('map', help='the linker map file')
+    parser.add_argument('--xml', help='the XML link info (default: <map>_linkInfo.xml, if it exists)')
+    parser.add_argument('--ram-limit', type=int, help='fail if more than this many bytes of RAM are used')
+    parser.add_argument('--fram-limit', type=int, help='fail if more than this many bytes of FRAM are used')
+    args = parser.parse_args()
+
+    ranges, inputs = parse_map(args.map)
+    if not ranges:
+        sys.exit('%s: no MEMORY CONFIGURATION; is this a TI linker map?' % args.map)
+
+    xml_path = args.xml or re.sub(r'\.map$', '', args.map) + '_linkInfo.xml'
+    owners = {}
+    if os.path.exists(xml_path):
+        owners = parse_link_info(xml_path)
+
+    modules = set(m for m, _, _, _ in inputs if m and not m.startswith('('))
+    regions = [r for r, _ in REGIONS]
+    table = {}
+
+    for module, section, origin, length in inputs:
+        if module is None:
+            module = owners.get(section) or guess_owner(section, modules) or '(common)'
+        region = region_of(origin, ranges)
+        if region is None:
+            continue
+        row = table.setdefault(module, dict.fromkeys(regions, 0))
+        row[region] += length
+
+    used = [r for r in regions if any(row[r] for row in table.values())]
+    width = max([len(m) for m in table] + [len('Total')])
+
+    print('%-*s' % (width, 'Module') + ''.join('%8s' % r for r in used))
+    for module in sorted(table, key=lambda m: [-table[m][r] for r in used] + [m]):
+        row = table[module]
+        if not any(row[r] for r in used):
+            continue
+        print('%-*s' % (width, module) + ''.join('%8d' % row[r] for r in used))
+
+    totals = dict((r, sum(row[r] for row in table.values())) for r in used)
+    print('%-*s' % (width, 'Total') + ''.join('%8d' % totals[r] for r in used))
+    print('')
+
+    limits = {'RAM': args.ram_limit, 'FRAM': args.fram_limit}
+    over = False
+    for region, members in REGIONS:
+        if region not in used:
+            continue
+        size = sum(length for name, _, length in ranges if name in members)
+        limit = limits.get(region)
+        if limit is None:
+            limit = size
+        print('%-4s %6d of %6d bytes (%3d%%), %6d free%s' % (
+            region, totals[region], size, 100 * totals[region] // size if size else 0,
+            size - totals[region], '' if limit == size else ', limit %d' % limit))
+        if totals[region] > limit:
+            print('error: %s is over its budget by %d bytes' % (region, totals[region] - limit),
+                  file=sys.stderr)
+            over = True
+
+    return 1 if over else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())